@@ -0,0 +1,756 @@
+#include "API_Handling.h"
+#include "CandleArchive.h"
+#include "config.h"
+#include "Indicators.h"
+#include "FillSimulator.h"
+#include "MarketData.h"
+#include "MockExchange.h"
+#include "OrderBook.h"
+#include "OrderEntry.h"
+#include "ResponseParsers.h"
+#include "StateStore.h"
+#include "StubServer.h"
+#include "StubWebSocketServer.h"
+#include "TradingBot.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <curl/curl.h>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static const char* const kMarket = "BTC-EUR";
+
+// **Latency distribution of one benchmark, in nanoseconds per call**
+struct BenchmarkResult {
+    string name;
+    size_t iterations = 0;
+    long long p50Ns = 0;
+    long long p99Ns = 0;
+    long long meanNs = 0;
+    long long minNs = 0;
+};
+
+// **Stream buffer that drops everything, so the bot's console output is formatted but not printed**
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize count) override { return count; }
+};
+
+// **Sends the console output to a NullBuffer while it is in scope**
+class QuietConsole {
+public:
+    QuietConsole() : console(cout.rdbuf(&discard)) {}
+    ~QuietConsole() { cout.rdbuf(console); }
+
+private:
+    NullBuffer discard;
+    streambuf* console;
+};
+
+// **Runs the benchmarks that match a filter and collects their results**
+// Every call is timed on its own. A benchmark runs for at least minMillis and 10 calls, at most maxIterations calls.
+class BenchmarkSuite {
+public:
+    string filter;
+    double minMillis = 300.0;
+    size_t maxIterations = 100000;
+    vector<BenchmarkResult> results;
+
+    // **True if a benchmark of this name is selected**
+    bool selected(const string& name) const { return filter.empty() || name.find(filter) != string::npos; }
+
+    // **Time body, running setup untimed before every call**
+    template <typename Setup, typename Body>
+    void run(const string& name, Setup&& setup, Body&& body) {
+        if (!selected(name)) return;
+        vector<long long> samples;
+        {
+            QuietConsole quiet;
+            auto begin = chrono::steady_clock::now();
+            while (samples.size() < maxIterations && (samples.size() < 10
+                || chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count() < minMillis)) {
+                setup();
+                auto start = chrono::steady_clock::now();
+                body();
+                samples.push_back(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+            }
+        }
+
+        sort(samples.begin(), samples.end());
+        BenchmarkResult result;
+        result.name = name;
+        result.iterations = samples.size();
+        result.p50Ns = samples[samples.size() / 2];
+        result.p99Ns = samples[samples.size() * 99 / 100];
+        long long total = 0;
+        for (long long sample : samples) total += sample;
+        result.meanNs = total / static_cast<long long>(samples.size());
+        result.minNs = samples.front();
+        cout << name << ": p50 " << result.p50Ns << " ns | p99 " << result.p99Ns << " ns | mean " << result.meanNs
+            << " ns | " << result.iterations << " calls" << endl;
+        results.push_back(result);
+    }
+
+    template <typename Body>
+    void run(const string& name, Body&& body) {
+        run(name, [] {}, body);
+    }
+};
+
+// **Random walk of 1m candles ending before now**
+static vector<CandleRecord> randomCandles(size_t count, unsigned seed) {
+    mt19937_64 rng(seed);
+    normal_distribution<double> step(0.0, 1.0);
+    const long long millis = intervalMillis(Interval::M1);
+    const long long now = chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    long long timestamp = (now / millis - static_cast<long long>(count) - 1) * millis;
+    vector<CandleRecord> candles(count);
+    double price = 30000.0;
+    for (CandleRecord& candle : candles) {
+        candle.timestamp = timestamp;
+        candle.open = price;
+        price += step(rng) * 10.0;
+        candle.close = price;
+        candle.high = max(candle.open, candle.close) + fabs(step(rng)) * 5.0;
+        candle.low = min(candle.open, candle.close) - fabs(step(rng)) * 5.0;
+        candle.volume = fabs(step(rng)) * 3.0;
+        timestamp += millis;
+    }
+    return candles;
+}
+
+// **Candles response body as the exchange sends it, newest first with the values as strings**
+static string candlesResponse(const vector<CandleRecord>& candles) {
+    json response = json::array();
+    for (auto it = candles.rbegin(); it != candles.rend(); ++it) {
+        response.push_back({ it->timestamp, formatNumber(it->open), formatNumber(it->high), formatNumber(it->low),
+            formatNumber(it->close), formatNumber(it->volume) });
+    }
+    return response.dump();
+}
+
+// **Balance response body with a number of assets**
+static string balanceResponse(size_t assets) {
+    json response = json::array();
+    for (size_t i = 0; i < assets; i++) {
+        response.push_back({ { "symbol", "AS" + to_string(i) }, { "available", formatNumber(1000.0 / (i + 1)) },
+            { "inOrder", "0" } });
+    }
+    return response.dump();
+}
+
+// **Candle records of a candles response through a json DOM, as fetchCandles parsed before the response parsers**
+static void domCandles(const json& response, vector<CandleRecord>& candles) {
+    auto toDouble = [](const json& value) {
+        return value.is_string() ? stod(value.get_ref<const string&>()) : value.get<double>();
+    };
+    auto toTimestamp = [](const json& value) {
+        return value.is_string() ? stoll(value.get_ref<const string&>()) : value.get<long long>();
+    };
+    candles.clear();
+    for (const json& candle : response) {
+        if (!candle.is_array() || candle.size() < 6) continue;
+        candles.push_back({ toTimestamp(candle[0]), toDouble(candle[1]), toDouble(candle[2]), toDouble(candle[3]),
+            toDouble(candle[4]), toDouble(candle[5]) });
+    }
+}
+
+// **Feed candles to every interval of a bot, the coarser intervals get every nth candle**
+static void fillBot(CryptoTradingBot& bot, const vector<CandleRecord>& candles, bool allIntervals) {
+    for (Interval interval : kAllIntervals) {
+        if (!allIntervals && interval != Interval::M1) continue;
+        const size_t every = static_cast<size_t>(intervalMillis(interval) / intervalMillis(Interval::M1));
+        for (size_t i = 0; i < candles.size(); i += every) {
+            const CandleRecord& c = candles[i];
+            bot.addCandle(interval, c.timestamp, c.open, c.high, c.low, c.close, c.volume);
+        }
+    }
+}
+
+// **Port of the stub server if BASE_URL points at the loopback interface, 0 otherwise**
+static int loopbackPort() {
+    const string prefix = "http://127.0.0.1:";
+    if (BASE_URL.compare(0, prefix.size(), prefix) != 0) return 0;
+    return atoi(BASE_URL.c_str() + prefix.size());
+}
+
+// **True if libcurl was built with websocket support, without it the feed cannot connect**
+static bool curlSupportsWebSockets() {
+    const curl_version_info_data* info = curl_version_info(CURLVERSION_NOW);
+    for (const char* const* protocol = info->protocols; protocol && *protocol; protocol++) {
+        if (strcmp(*protocol, "ws") == 0) return true;
+    }
+    return false;
+}
+
+// **Port of the stub websocket server if WS_URL points at the loopback interface, 0 otherwise**
+static int loopbackWebSocketPort() {
+    const string prefix = "ws://127.0.0.1:";
+    if (WS_URL.compare(0, prefix.size(), prefix) != 0) return 0;
+    return atoi(WS_URL.c_str() + prefix.size());
+}
+
+// **Benchmarks that run without the network**
+static void runOfflineBenchmarks(BenchmarkSuite& suite) {
+    const string message = to_string(1700000000000LL) + "GET" + "/v2/balance";
+    suite.run("generateSignature", [&] { generateSignature(API_SECRET, message); });
+
+    // The candle parsing of fetchCandles: the response body into candle records, then into the bot's columns,
+    // against the json DOM the body went through before
+    for (size_t count : { 100, 1440 }) {
+        string body = candlesResponse(randomCandles(count, 1));
+        CryptoTradingBot bot(kMarket, true, "bench_parse_");
+        vector<CandleRecord> received;
+        suite.run("fetchCandles.parse/" + to_string(count), [&] {
+            parseCandlesResponse(body.data(), body.size(), received);
+            bot.storeCandles(Interval::M1, received);
+        });
+        suite.run("fetchCandles.parse.dom/" + to_string(count), [&] {
+            domCandles(json::parse(body), received);
+            bot.storeCandles(Interval::M1, received);
+        });
+    }
+
+    // Balance and ticker responses, against the json DOM
+    {
+        string body = balanceResponse(50);
+        vector<AssetBalance> balances;
+        suite.run("parseBalanceResponse/50", [&] { parseBalanceResponse(body.data(), body.size(), balances); });
+        suite.run("parseBalanceResponse.dom/50", [&] {
+            json response = json::parse(body);
+            balances.clear();
+            for (const json& balance : response) {
+                balances.push_back({ balance["symbol"].get<string>(),
+                    stod(balance["available"].get_ref<const string&>()), stod(balance["inOrder"].get_ref<const string&>()) });
+            }
+        });
+        const string ticker = string("{\"market\":\"") + kMarket + "\",\"price\":\"30000.5\"}";
+        double price = 0.0;
+        suite.run("parseTickerPriceResponse", [&] { parseTickerPriceResponse(ticker.data(), ticker.size(), price); });
+        suite.run("parseTickerPriceResponse.dom", [&] { price = stod(json::parse(ticker)["price"].get<string>()); });
+    }
+
+    // A full recompute over the history, as after a parameter change or a reconnect
+    for (size_t count : { 100, 500, 2000 }) {
+        if (count > CANDLE_RETENTION[intervalIndex(Interval::M1)]) continue;
+        CryptoTradingBot bot(kMarket, true, "bench_indicators_");
+        fillBot(bot, randomCandles(count, 2), false);
+        StrategyParameters parameters;
+        suite.run("calculateIndicators.rebuild/" + to_string(count), [&] { bot.setStrategyParameters(parameters); });
+    }
+
+    // One new candle on a full history, the per-tick path
+    {
+        const size_t retention = CANDLE_RETENTION[intervalIndex(Interval::M1)];
+        vector<CandleRecord> candles = randomCandles(retention + 200000, 3);
+        CryptoTradingBot bot(kMarket, true, "bench_indicators_");
+        fillBot(bot, vector<CandleRecord>(candles.begin(), candles.begin() + retention), false);
+        size_t next = retention;
+        suite.maxIterations = candles.size() - retention;
+        suite.run("calculateIndicators.append", [&] {
+            const CandleRecord& c = candles[next++];
+            bot.addCandle(Interval::M1, c.timestamp, c.open, c.high, c.low, c.close, c.volume);
+        });
+        suite.maxIterations = 100000;
+    }
+
+    // Book changes near the touch of a 1000 level book, as the book channel streams them
+    {
+        OrderBook book;
+        for (int i = 1; i <= 500; i++) {
+            book.setLevel(BookSide::Bid, 30000.0 - i, 1.0);
+            book.setLevel(BookSide::Ask, 30000.0 + i, 1.0);
+        }
+        mt19937 rng(9);
+        uniform_int_distribution<int> offset(1, 50);
+        uniform_int_distribution<int> empty(0, 9);
+        struct Change { BookSide side; double price; double amount; };
+        vector<Change> changes(1 << 16);
+        for (Change& change : changes) {
+            change.side = offset(rng) % 2 ? BookSide::Bid : BookSide::Ask;
+            change.price = change.side == BookSide::Bid ? 30000.0 - offset(rng) : 30000.0 + offset(rng);
+            change.amount = empty(rng) == 0 ? 0.0 : 0.5 + offset(rng) / 50.0;
+        }
+        size_t next = 0;
+        suite.run("OrderBook.setLevel/1000", [&] {
+            const Change& change = changes[next++ & (changes.size() - 1)];
+            book.setLevel(change.side, change.price, change.amount);
+        });
+
+        // A market buy walking about ten levels, filled once its latency has passed
+        FillSimulator simulator(0.0025, 0);
+        suite.run("FillSimulator.fill", [&] {
+            simulator.submit(true, 300000.0, 30000.0, 0);
+            simulator.fill(&book, 30000.0);
+        });
+    }
+
+    // saveCandlesToArchive: the closed candles of a save appended to a new archive file
+    for (size_t count : { 100, 1440 }) {
+        vector<CandleRecord> candles = randomCandles(count, 5);
+        const string filename = "bench_archive.bin";
+        size_t appended = 0;
+        suite.run("saveCandlesToArchive/" + to_string(count), [&] { remove(filename.c_str()); }, [&] {
+            appendToCandleArchive(filename, Interval::M1, candles, appended);
+        });
+        remove(filename.c_str());
+    }
+
+    // StateStore.record: the position after a fill written to the state log and synced to disk
+    {
+        const string filename = "bench_state.bin";
+        {
+            StateStore store(filename, true);
+            PositionState state;
+            store.recover(state);
+            long long timeMs = 0;
+            suite.run("StateStore.record", [&] {
+                state.simFiatBalance += 1.0;
+                store.record(state, ++timeMs);
+            });
+        }
+        remove(filename.c_str());
+        remove((filename + ".wal").c_str());
+    }
+
+    // One step of a backtest: a closed 1m candle and a ticker price, with the signals evaluated
+    {
+        vector<CandleRecord> candles = randomCandles(260000, 6);
+        const size_t warmup = 60000;
+        CryptoTradingBot bot(kMarket, true, "bench_tick_");
+        fillBot(bot, vector<CandleRecord>(candles.begin(), candles.begin() + warmup), true);
+        size_t next = warmup;
+        suite.maxIterations = candles.size() - warmup;
+        suite.run("tick.simulated", [&] {
+            const CandleRecord& c = candles[next++];
+            bot.addCandle(Interval::M1, c.timestamp, c.open, c.high, c.low, c.close, c.volume);
+            bot.setSimulatedClock(c.timestamp + intervalMillis(Interval::M1));
+            bot.onTickerPrice(c.close);
+        });
+        suite.maxIterations = 100000;
+    }
+
+    // One websocket tick of a live bot: a closed 1m candle and a ticker update applied as they arrive, with the
+    // wall clock, the update-to-decision latency and the sampled indicator timing of the metrics
+    {
+        vector<CandleRecord> candles = randomCandles(260000, 8);
+        const size_t warmup = 60000;
+        CryptoTradingBot bot(kMarket, true, "bench_ws_");
+        fillBot(bot, vector<CandleRecord>(candles.begin(), candles.begin() + warmup), true);
+        MarketDataFeed feed({ kMarket });
+        vector<MarketUpdate> updates(2);
+        updates[0].type = MarketUpdate::Type::Candle;
+        updates[0].interval = Interval::M1;
+        updates[1].type = MarketUpdate::Type::Ticker;
+        size_t next = warmup;
+        suite.maxIterations = candles.size() - warmup;
+        suite.run("tick.websocket", [&] {
+            const CandleRecord& c = candles[next++];
+            updates[0].timestamp = c.timestamp;
+            updates[0].open = c.open;
+            updates[0].high = c.high;
+            updates[0].low = c.low;
+            updates[0].close = c.close;
+            updates[0].volume = c.volume;
+            updates[1].price = c.close;
+            updates[0].receivedAt = updates[1].receivedAt = chrono::steady_clock::now();
+            bot.applyUpdates(updates, feed);
+        });
+        suite.maxIterations = 100000;
+    }
+}
+
+// **Full indicator recomputes and the batch kernels on every kernel set the CPU supports**
+// Returns false if a batch recompute differs in any bit from feeding IndicatorEngine::update candle by candle.
+static bool runIndicatorKernelBenchmarks(BenchmarkSuite& suite) {
+    vector<CandleRecord> candles = randomCandles(100000, 4);
+    const size_t count = candles.size();
+    vector<double> high, low, close;
+    for (const CandleRecord& c : candles) {
+        high.push_back(c.high);
+        low.push_back(c.low);
+        close.push_back(c.close);
+    }
+    vector<IndicatorData> streamed(count), batched(count);
+    {
+        IndicatorEngine engine;
+        for (size_t i = 0; i < count; i++) streamed[i] = engine.update(high[i], low[i], close[i]);
+    }
+    suite.run("IndicatorEngine.update/100000", [&] {
+        IndicatorEngine engine;
+        for (size_t i = 0; i < count; i++) batched[i] = engine.update(high[i], low[i], close[i]);
+    });
+    suite.run("IndicatorEngine.updateBatch/100000", [&] {
+        IndicatorEngine engine;
+        engine.updateBatch(high.data(), low.data(), close.data(), count, batched.data());
+    });
+
+    vector<const IndicatorKernels*> kernelSets = { &scalarIndicatorKernels() };
+    if (avx2IndicatorKernels()) kernelSets.push_back(avx2IndicatorKernels());
+    else cout << "AVX2 is not available on this CPU, only the scalar kernels are measured" << endl;
+    IndicatorParameters parameters;
+    vector<double> a(count), b(count), c(count), d(count);
+    bool identical = true;
+    for (const IndicatorKernels* kernels : kernelSets) {
+        const string suffix = string(".") + kernels->name + "/100000";
+        {
+            IndicatorEngine engine;
+            engine.updateBatch(high.data(), low.data(), close.data(), count, batched.data(), *kernels);
+        }
+        if (memcmp(streamed.data(), batched.data(), count * sizeof(IndicatorData)) != 0) {
+            cerr << "Error: The " << kernels->name << " kernels differ from IndicatorEngine::update" << endl;
+            identical = false;
+        }
+        suite.run("IndicatorEngine.updateBatch" + suffix, [&] {
+            IndicatorEngine engine;
+            engine.updateBatch(high.data(), low.data(), close.data(), count, batched.data(), *kernels);
+        });
+        suite.run("IndicatorKernels.bollinger" + suffix, [&] {
+            kernels->bollinger(close.data(), count, parameters.bbPeriod, parameters.bbStdDev, a.data(), b.data(), c.data());
+        });
+        suite.run("IndicatorKernels.trueRange" + suffix, [&] {
+            kernels->trueRange(high.data(), low.data(), close.data(), count, a.data());
+        });
+        suite.run("IndicatorKernels.gainLoss" + suffix, [&] { kernels->gainLoss(close.data(), count, a.data(), b.data()); });
+        suite.run("IndicatorKernels.rsi" + suffix, [&] { kernels->rsi(a.data(), b.data(), count, d.data()); });
+        suite.run("IndicatorKernels.difference" + suffix, [&] {
+            kernels->difference(high.data(), low.data(), count, d.data());
+        });
+    }
+    return identical;
+}
+
+// **Order body of the general request path: a json DOM, dumped and signed like apiRequest does**
+static string generalOrderBody(double amount, const char* clientOrderId, long long timestampMs) {
+    json order;
+    order["market"] = kMarket;
+    order["side"] = "buy";
+    order["orderType"] = "market";
+    order["amountQuote"] = to_string(amount);
+    order["clientOrderId"] = clientOrderId;
+    string body = order.dump();
+    string signature = generateSignature(API_SECRET, to_string(timestampMs) + "POST" + "/v2/order" + body);
+    return body;
+}
+
+// **Building and signing a market order, the signal to send latency without the send**
+// The preallocated buffers of OrderEntry against the json body and signature of the general path (.dom).
+// Returns false if the two paths write different bodies.
+static bool runOrderBenchmarks(BenchmarkSuite& suite) {
+    OrderEntry orderEntry(kMarket);
+    size_t next = 0;
+    auto nowMs = [] {
+        return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    };
+    suite.run("OrderEntry.prepare", [&] { orderEntry.prepare(true, 10.0 + (next++ % 1000) * 0.01, nowMs()); });
+    // The general path sends the clientOrderId the fast path drew
+    suite.run("OrderEntry.prepare.dom", [&] {
+        generalOrderBody(10.0 + (next++ % 1000) * 0.01, orderEntry.clientOrderId(), nowMs());
+    });
+
+    const double amount = 12.34;
+    const long long timestampMs = nowMs();
+    if (!orderEntry.prepare(true, amount, timestampMs)) {
+        cerr << "Error: The order does not fit the buffers of OrderEntry" << endl;
+        return false;
+    }
+    const string body = generalOrderBody(amount, orderEntry.clientOrderId(), timestampMs);
+    if (body != orderEntry.body()) {
+        cerr << "Error: Order bodies differ: " << body << " and " << orderEntry.body() << endl;
+        return false;
+    }
+    return true;
+}
+
+// **Benchmarks of the REST path, against the stub server instead of the exchange**
+static void runNetworkBenchmarks(BenchmarkSuite& suite, int port) {
+    StubServer server;
+    const string candles = candlesResponse(randomCandles(100, 7));
+    server.setResponse("/v2/time", "{\"time\":1700000000000}");
+    server.setResponse(string("/v2/") + kMarket + "/candles", candles);
+    server.setResponse("/v2/ticker/price", string("{\"market\":\"") + kMarket + "\",\"price\":\"30000.5\"}");
+    server.setResponse("/v2/balance", "[{\"symbol\":\"EUR\",\"available\":\"1000\",\"inOrder\":\"0\"},"
+        "{\"symbol\":\"BTC\",\"available\":\"0\",\"inOrder\":\"0\"}]");
+    if (!server.start(port)) {
+        cerr << "Skipping the network benchmarks, the stub server could not start." << endl;
+        return;
+    }
+
+    suite.run("apiRequest.time", [] { apiRequest("time"); });
+    suite.run("apiRequest.candles/100", [] { apiRequest(string(kMarket) + "/candles?interval=1m&limit=100"); });
+
+    // A full REST poll of a simulated bot: candles, ticker and balances, signals and the status report
+    CryptoTradingBot bot(kMarket, true, "bench_poll_");
+    {
+        QuietConsole quiet;
+        bot.fetchAllCandles(100);
+    }
+    MarketDataFeed feed({ kMarket });
+    suite.maxIterations = 20000;
+    suite.run("tick.poll", [&] { bot.pollTick(feed, chrono::seconds(60)); });
+    suite.maxIterations = 100000;
+    server.stop();
+}
+
+// **Check and benchmark the websocket feed against the stub websocket server**
+// Candle and ticker events sent by the server have to come out of a started feed and reach a trading decision in
+// applyUpdates, including an update of the forming candle; returns false if they do not. The benchmark then
+// times one tick from sending the events to the decision.
+static bool runWebSocketBenchmarks(BenchmarkSuite& suite, int port) {
+    StubWebSocketServer server;
+    if (!server.start(port)) {
+        cerr << "Skipping the websocket benchmarks, the stub websocket server could not start." << endl;
+        return true;
+    }
+    const size_t warmup = 60000;
+    vector<CandleRecord> candles = randomCandles(warmup + 20001, 9);
+    CryptoTradingBot bot(kMarket, true, "bench_ws_stub_");
+    fillBot(bot, vector<CandleRecord>(candles.begin(), candles.begin() + warmup), true);
+    MarketDataFeed feed({ kMarket });
+    feed.start();
+    if (!server.waitForSubscriber(chrono::seconds(5))) {
+        cerr << "Error: The websocket feed did not subscribe to the stub websocket server on port " << port << endl;
+        feed.stop();
+        return false;
+    }
+
+    auto candleEvent = [](const CandleRecord& c) {
+        return json{ { "event", "candle" }, { "market", kMarket }, { "interval", "1m" }, { "candle", json::array({
+            json::array({ c.timestamp, formatNumber(c.open), formatNumber(c.high), formatNumber(c.low),
+                formatNumber(c.close), formatNumber(c.volume) }) }) } }.dump();
+    };
+    auto tickerEvent = [](double price) {
+        return json{ { "event", "ticker" }, { "market", kMarket }, { "lastPrice", formatNumber(price) } }.dump();
+    };
+    // One tick: the events sent, the updates collected until the ticker arrives, then applied
+    vector<MarketUpdate> updates;
+    auto tick = [&](const vector<string>& events) {
+        for (const string& event : events) server.broadcast(event);
+        updates.clear();
+        auto hasTicker = [&] {
+            return any_of(updates.begin(), updates.end(), [](const MarketUpdate& u) { return u.type == MarketUpdate::Type::Ticker; });
+        };
+        auto giveUp = chrono::steady_clock::now() + chrono::seconds(1);
+        while (!hasTicker() && chrono::steady_clock::now() < giveUp) feed.waitForUpdates(updates, chrono::milliseconds(100));
+        bot.applyUpdates(updates, feed);
+    };
+
+    // The check: a new candle, an update of it while it forms, and the ticker
+    CandleRecord forming = candles[warmup];
+    forming.close = forming.open;
+    {
+        QuietConsole quiet;
+        tick({ candleEvent(forming), candleEvent(candles[warmup]), tickerEvent(candles[warmup].close) });
+    }
+    size_t candleUpdates = 0, tickerUpdates = 0;
+    for (const MarketUpdate& update : updates) (update.type == MarketUpdate::Type::Candle ? candleUpdates : tickerUpdates)++;
+    double p50Us = 0.0, p99Us = 0.0;
+    feed.decisionLatency(p50Us, p99Us);
+    bool passed = candleUpdates == 2 && tickerUpdates == 1 && p50Us > 0.0;
+    if (!passed) {
+        cerr << "Error: The stub websocket events did not reach a decision (" << candleUpdates << " candle and "
+            << tickerUpdates << " ticker updates, decision latency " << p50Us << " us)" << endl;
+    }
+    else {
+        cout << "Websocket feed check passed: stub events reached a decision in " << p50Us << " us" << endl;
+    }
+
+    size_t next = warmup + 1;
+    suite.maxIterations = candles.size() - next;
+    suite.run("tick.websocket.stub", [&] {
+        const CandleRecord& c = candles[next++];
+        tick({ candleEvent(c), tickerEvent(c.close) });
+    });
+    suite.maxIterations = 100000;
+    feed.stop();
+    server.stop();
+    return passed;
+}
+
+// **One REST poll of a market as one batch: the ticker, the candles of four intervals and every tenth poll the balances**
+// Returns false if a request was not parsed.
+static bool pollMarket(const string& market, size_t round) {
+    static const char* const intervals[] = { "1m", "5m", "15m", "1h" };
+    thread_local vector<CandleRecord> candles[4];
+    thread_local vector<AssetBalance> balances;
+    thread_local double price = 0.0;
+    vector<ApiRequest> batch = { { "ticker/price?market=" + market, "GET", "", RequestPriority::Ticker } };
+    vector<ResponseParser> parsers = { [](const char* data, size_t size) {
+        return parseTickerPriceResponse(data, size, price) != ParseStatus::Malformed;
+    } };
+    for (int i = 0; i < 4; i++) {
+        batch.push_back({ market + "/candles?interval=" + intervals[i] + "&limit=50", "GET", "",
+            RequestPriority::MarketData, CANDLE_DEADLINE_MS });
+        parsers.push_back([i](const char* data, size_t size) {
+            return parseCandlesResponse(data, size, candles[i]) != ParseStatus::Malformed;
+        });
+    }
+    if (round % 10 == 0) {
+        batch.push_back({ "balance" });
+        parsers.push_back([](const char* data, size_t size) {
+            return parseBalanceResponse(data, size, balances) != ParseStatus::Malformed;
+        });
+    }
+    vector<bool> parsed = apiRequestBatchParsed(batch, parsers);
+    return find(parsed.begin(), parsed.end(), false) == parsed.end();
+}
+
+// **Benchmarks of the REST path against the in-process mock exchange, without latency or a socket**
+// The difference with the stub server benchmarks is the cost of the HTTP transfer itself. Returns false if a
+// poll under load was not parsed completely.
+static bool runMockExchangeBenchmarks(BenchmarkSuite& suite) {
+    MockExchangeOptions options;
+    options.rateLimit = 1000000000;
+    MockExchange exchange(options);
+    setApiTransport(&exchange);
+    suite.run("apiRequest.mock.time", [] { apiRequest("time"); });
+    suite.run("apiRequest.mock.candles/100", [] { apiRequest(string(kMarket) + "/candles?interval=1m&limit=100"); });
+
+    CryptoTradingBot bot(kMarket, true, "bench_mock_poll_");
+    {
+        QuietConsole quiet;
+        bot.fetchAllCandles(100);
+    }
+    MarketDataFeed feed({ kMarket });
+    suite.maxIterations = 20000;
+    suite.run("tick.poll.mock", [&] { bot.pollTick(feed, chrono::seconds(60)); });
+    suite.maxIterations = 100000;
+
+    // One market's poll while three threads keep polling other markets, as in a process trading many markets
+    atomic<bool> stopping{ false };
+    atomic<long long> failedPolls{ 0 };
+    vector<thread> pollers;
+    if (suite.selected("apiRequestBatch.mock.poll/4threads")) {
+        for (int t = 0; t < 3; t++) {
+            pollers.emplace_back([&, t] {
+                const string market = "M" + to_string(t) + "-EUR";
+                for (size_t round = 0; !stopping; round++) {
+                    if (!pollMarket(market, round)) failedPolls++;
+                }
+            });
+        }
+    }
+    size_t round = 0;
+    suite.run("apiRequestBatch.mock.poll/4threads", [&] {
+        if (!pollMarket(kMarket, round++)) failedPolls++;
+    });
+    stopping = true;
+    for (thread& poller : pollers) poller.join();
+    setApiTransport(nullptr);
+    if (failedPolls > 0) cerr << "Error: " << failedPolls << " polls against the mock exchange were not parsed" << endl;
+    return failedPolls == 0;
+}
+
+// **Results as JSON, with the machine and build they were measured on**
+static json resultsJson(const vector<BenchmarkResult>& results) {
+    json document;
+    time_t now = time(nullptr);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    document["context"] = {
+        { "timestamp", timestamp },
+        { "threads", thread::hardware_concurrency() },
+        { "indicatorKernels", indicatorKernels().name },
+    };
+    document["benchmarks"] = json::array();
+    for (const BenchmarkResult& result : results) {
+        document["benchmarks"].push_back({
+            { "name", result.name },
+            { "iterations", result.iterations },
+            { "p50_ns", result.p50Ns },
+            { "p99_ns", result.p99Ns },
+            { "mean_ns", result.meanNs },
+            { "min_ns", result.minNs },
+        });
+    }
+    return document;
+}
+
+// **Compare the medians with a baseline results file, returns false if one is slower by more than the tolerance**
+static bool compareWithBaseline(const vector<BenchmarkResult>& results, const string& filename, double tolerancePercent) {
+    ifstream file(filename);
+    json baseline = json::parse(file, nullptr, false);
+    if (baseline.is_discarded() || !baseline.contains("benchmarks")) {
+        cerr << "Error: " << filename << " is not a benchmark results file." << endl;
+        return false;
+    }
+    bool regressed = false;
+    for (const BenchmarkResult& result : results) {
+        for (const json& entry : baseline["benchmarks"]) {
+            if (entry.value("name", "") != result.name) continue;
+            long long before = entry.value("p50_ns", 0LL);
+            if (before <= 0) break;
+            double change = (static_cast<double>(result.p50Ns) / before - 1.0) * 100.0;
+            bool slower = change > tolerancePercent;
+            regressed = regressed || slower;
+            cout << (slower ? "REGRESSION " : "") << result.name << ": p50 " << before << " -> " << result.p50Ns
+                << " ns (" << (change >= 0 ? "+" : "") << change << "%)" << endl;
+            break;
+        }
+    }
+    return !regressed;
+}
+
+// **Main function**
+// cryptobot_bench [--filter text] [--min-time ms] [--json results.json] [--compare baseline.json] [--tolerance percent]
+// Runs from a directory whose .env sets BASE_URL to http://127.0.0.1:<port>/v2/ and WS_URL to ws://127.0.0.1:<port>/v2/,
+// where it starts the stub servers; the REST and websocket benchmarks are skipped for any other URL. Exits with 1
+// if a median regressed past the tolerance, the stub websocket events did not reach a decision, the batch
+// indicator kernels or the fast order path disagreed with the general path, or a poll under load failed.
+int main(int argc, char* argv[]) {
+    BenchmarkSuite suite;
+    string jsonFile, baselineFile;
+    double tolerancePercent = 10.0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--filter") suite.filter = argv[i + 1];
+        else if (option == "--min-time") suite.minMillis = atof(argv[i + 1]);
+        else if (option == "--json") jsonFile = argv[i + 1];
+        else if (option == "--compare") baselineFile = argv[i + 1];
+        else if (option == "--tolerance") tolerancePercent = atof(argv[i + 1]);
+        else {
+            cerr << "Error: Unknown option " << option << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    runOfflineBenchmarks(suite);
+    bool checksPassed = runIndicatorKernelBenchmarks(suite);
+    checksPassed = runOrderBenchmarks(suite) && checksPassed;
+    checksPassed = runMockExchangeBenchmarks(suite) && checksPassed;
+    int port = loopbackPort();
+    if (port > 0) runNetworkBenchmarks(suite, port);
+    else cout << "Skipping the network benchmarks, BASE_URL is not http://127.0.0.1:<port>/v2/" << endl;
+    bool feedChecked = true;
+    int webSocketPort = loopbackWebSocketPort();
+    if (webSocketPort <= 0) cout << "Skipping the websocket benchmarks, WS_URL is not ws://127.0.0.1:<port>/v2/" << endl;
+    else if (!curlSupportsWebSockets()) cout << "Skipping the websocket benchmarks, libcurl has no websocket support" << endl;
+    else feedChecked = runWebSocketBenchmarks(suite, webSocketPort);
+
+    if (!jsonFile.empty()) {
+        ofstream file(jsonFile, ios::trunc);
+        file << resultsJson(suite.results).dump(2) << endl;
+        if (!file) {
+            cerr << "Unable to write " << jsonFile << endl;
+            return EXIT_FAILURE;
+        }
+        cout << "Wrote " << suite.results.size() << " results to " << jsonFile << endl;
+    }
+    if (!baselineFile.empty() && !compareWithBaseline(suite.results, baselineFile, tolerancePercent)) return 1;
+    return feedChecked && checksPassed ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include "StubServer.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// Longest time the server thread waits for a connection before it checks whether it was stopped
+static const int kPollMillis = 50;
+
+static const string kNotFound =
+    "HTTP/1.1 404 Not Found\r\nContent-Type: application/json\r\nContent-Length: 2\r\n\r\n{}";
+
+StubServer::~StubServer() {
+    stop();
+}
+
+// **Set the JSON body returned for a path without its query string, such as /v2/time, before start**
+void StubServer::setResponse(const string& path, const string& body) {
+    responses[path] = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: "
+        + to_string(body.size()) + "\r\nConnection: keep-alive\r\n\r\n" + body;
+}
+
+// **Listen on a loopback port and start serving, returns false if the port cannot be bound**
+bool StubServer::start(int port) {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) return false;
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, 128) != 0) {
+        cerr << "Unable to listen on 127.0.0.1:" << port << ": " << strerror(errno) << endl;
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    running = true;
+    worker = thread(&StubServer::run, this);
+    return true;
+}
+
+// **Stop serving and close every connection**
+void StubServer::stop() {
+    running = false;
+    if (worker.joinable()) worker.join();
+    if (listenFd >= 0) close(listenFd);
+    listenFd = -1;
+}
+
+// **Accept connections and answer their requests until stopped**
+void StubServer::run() {
+    vector<pollfd> fds = { { listenFd, POLLIN, 0 } };
+    vector<string> buffers = { string() }; // Index: position in fds, Value: bytes received but not answered
+    char chunk[16384];
+    while (running) {
+        if (poll(fds.data(), fds.size(), kPollMillis) <= 0) continue;
+        if (fds[0].revents & POLLIN) {
+            int client = accept(listenFd, nullptr, nullptr);
+            if (client >= 0) {
+                int noDelay = 1;
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+                fds.push_back({ client, POLLIN, 0 });
+                buffers.emplace_back();
+            }
+        }
+        for (size_t i = fds.size() - 1; i > 0; i--) {
+            if (fds[i].revents == 0) continue;
+            ssize_t received = (fds[i].revents & POLLIN) ? recv(fds[i].fd, chunk, sizeof(chunk), 0) : 0;
+            bool open = received > 0;
+            if (open) {
+                buffers[i].append(chunk, static_cast<size_t>(received));
+                open = serve(fds[i].fd, buffers[i]);
+            }
+            if (!open) {
+                close(fds[i].fd);
+                fds.erase(fds.begin() + i);
+                buffers.erase(buffers.begin() + i);
+            }
+        }
+    }
+    for (size_t i = 1; i < fds.size(); i++) close(fds[i].fd);
+}
+
+// **Answer every complete request in a connection's buffer, returns false if the connection broke**
+bool StubServer::serve(int fd, string& buffer) {
+    while (true) {
+        size_t headerEnd = buffer.find("\r\n\r\n");
+        if (headerEnd == string::npos) return true;
+        size_t bodyLength = 0;
+        size_t lengthAt = buffer.find("Content-Length:");
+        if (lengthAt == string::npos) lengthAt = buffer.find("content-length:");
+        if (lengthAt != string::npos && lengthAt < headerEnd) bodyLength = strtoul(buffer.c_str() + lengthAt + 15, nullptr, 10);
+        size_t requestEnd = headerEnd + 4 + bodyLength;
+        if (buffer.size() < requestEnd) return true;
+
+        // Request line: METHOD /path?query HTTP/1.1
+        size_t pathBegin = buffer.find(' ') + 1;
+        size_t pathEnd = buffer.find_first_of(" ?", pathBegin);
+        auto response = responses.find(buffer.substr(pathBegin, pathEnd - pathBegin));
+        const string& reply = response != responses.end() ? response->second : kNotFound;
+        for (size_t sent = 0; sent < reply.size();) {
+            ssize_t written = send(fd, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+            if (written <= 0) return false;
+            sent += static_cast<size_t>(written);
+        }
+        requests++;
+        buffer.erase(0, requestEnd);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef STUBSERVER_H
+#define STUBSERVER_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// **Minimal HTTP/1.1 server on the loopback interface that answers with canned Bitvavo responses**
+// One background thread serves every connection with keep-alive, so apiRequest can be measured against a
+// server whose own cost is close to zero, without the network or the exchange. Paths that have no response
+// get a 404.
+class StubServer {
+public:
+    StubServer() = default;
+    ~StubServer();
+    StubServer(const StubServer&) = delete;
+    StubServer& operator=(const StubServer&) = delete;
+
+    // **Set the JSON body returned for a path without its query string, such as /v2/time, before start**
+    void setResponse(const std::string& path, const std::string& body);
+
+    // **Listen on a loopback port and start serving, returns false if the port cannot be bound**
+    bool start(int port);
+
+    // **Stop serving and close every connection**
+    void stop();
+
+    // **Requests answered since start**
+    long long requestCount() const { return requests; }
+
+private:
+    std::unordered_map<std::string, std::string> responses; // Index: path, Value: full HTTP response
+    int listenFd = -1;
+    std::thread worker;
+    std::atomic<bool> running{ false };
+    std::atomic<long long> requests{ 0 };
+
+    // **Accept connections and answer their requests until stopped**
+    void run();
+
+    // **Answer every complete request in a connection's buffer, returns false if the connection broke**
+    bool serve(int fd, std::string& buffer);
+};
+
+#endif // !STUBSERVER_H
@@ -0,0 +1,212 @@
+#include "StubWebSocketServer.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Longest time the server thread waits for a connection or a frame before it checks whether it was stopped
+static const int kPollMillis = 50;
+
+// Appended to the client's key before hashing it into the accept header (RFC 6455)
+static const char* const kHandshakeGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+enum WebSocketOpcode : uint8_t { kTextFrame = 0x1, kCloseFrame = 0x8, kPingFrame = 0x9, kPongFrame = 0xA };
+
+// **Unmasked frame of a server message: FIN, the opcode, the payload length and the payload**
+static string serverFrame(uint8_t opcode, const string& payload) {
+    string frame(1, static_cast<char>(0x80 | opcode));
+    const uint64_t length = payload.size();
+    if (length < 126) {
+        frame += static_cast<char>(length);
+    }
+    else if (length <= 0xFFFF) {
+        frame += static_cast<char>(126);
+        for (int shift = 8; shift >= 0; shift -= 8) frame += static_cast<char>((length >> shift) & 0xFF);
+    }
+    else {
+        frame += static_cast<char>(127);
+        for (int shift = 56; shift >= 0; shift -= 8) frame += static_cast<char>((length >> shift) & 0xFF);
+    }
+    return frame + payload;
+}
+
+// **Send all of data, returns false if the connection broke**
+static bool sendAll(int fd, const string& data) {
+    for (size_t sent = 0; sent < data.size();) {
+        ssize_t written = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (written <= 0) return false;
+        sent += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// **Sec-WebSocket-Accept value for a client's Sec-WebSocket-Key: base64 of the SHA-1 of the key and the GUID**
+static string acceptKey(const string& key) {
+    string input = key + kHandshakeGuid;
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    SHA1(reinterpret_cast<const unsigned char*>(input.data()), input.size(), digest);
+    unsigned char encoded[4 * ((SHA_DIGEST_LENGTH + 2) / 3) + 1];
+    int length = EVP_EncodeBlock(encoded, digest, SHA_DIGEST_LENGTH);
+    return string(reinterpret_cast<const char*>(encoded), static_cast<size_t>(length));
+}
+
+StubWebSocketServer::~StubWebSocketServer() {
+    stop();
+}
+
+// **Listen on a loopback port and start serving, returns false if the port cannot be bound**
+bool StubWebSocketServer::start(int port) {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) return false;
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, 16) != 0) {
+        cerr << "Unable to listen on 127.0.0.1:" << port << ": " << strerror(errno) << endl;
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    running = true;
+    worker = thread(&StubWebSocketServer::run, this);
+    return true;
+}
+
+// **Stop serving and close every connection**
+void StubWebSocketServer::stop() {
+    running = false;
+    if (worker.joinable()) worker.join();
+    if (listenFd >= 0) close(listenFd);
+    listenFd = -1;
+}
+
+// **Wait up to timeout for a client to subscribe, returns false if none did**
+bool StubWebSocketServer::waitForSubscriber(chrono::milliseconds timeout) {
+    unique_lock<mutex> lock(clientsMutex);
+    return subscribed.wait_for(lock, timeout, [this] {
+        for (const Client& client : clients) {
+            if (client.subscribed) return true;
+        }
+        return false;
+    });
+}
+
+// **Send a text message to every subscribed client, returns the number of clients it reached**
+size_t StubWebSocketServer::broadcast(const string& message) {
+    const string frame = serverFrame(kTextFrame, message);
+    size_t reached = 0;
+    lock_guard<mutex> lock(clientsMutex);
+    for (const Client& client : clients) {
+        if (client.subscribed && sendAll(client.fd, frame)) reached++;
+    }
+    return reached;
+}
+
+// **Accept connections and read their frames until stopped**
+void StubWebSocketServer::run() {
+    vector<pollfd> fds;
+    char chunk[16384];
+    while (running) {
+        fds.assign(1, { listenFd, POLLIN, 0 });
+        {
+            lock_guard<mutex> lock(clientsMutex);
+            for (const Client& client : clients) fds.push_back({ client.fd, POLLIN, 0 });
+        }
+        if (poll(fds.data(), fds.size(), kPollMillis) <= 0) continue;
+        lock_guard<mutex> lock(clientsMutex);
+        // Clients only change on this thread, so fds[i + 1] is still the descriptor of clients[i]
+        for (size_t i = clients.size(); i-- > 0;) {
+            if (fds[i + 1].revents == 0) continue;
+            ssize_t received = (fds[i + 1].revents & POLLIN) ? recv(clients[i].fd, chunk, sizeof(chunk), 0) : 0;
+            bool open = received > 0;
+            if (open) {
+                clients[i].buffer.append(chunk, static_cast<size_t>(received));
+                open = serve(clients[i]);
+            }
+            if (!open) {
+                close(clients[i].fd);
+                clients.erase(clients.begin() + i);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd >= 0) {
+                int noDelay = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+                Client client;
+                client.fd = fd;
+                clients.push_back(client);
+            }
+        }
+    }
+    lock_guard<mutex> lock(clientsMutex);
+    for (const Client& client : clients) close(client.fd);
+    clients.clear();
+}
+
+// **Answer the handshake and handle every complete frame in a client's buffer, returns false if it broke or closed**
+bool StubWebSocketServer::serve(Client& client) {
+    string& buffer = client.buffer;
+    if (!client.upgraded) {
+        size_t headerEnd = buffer.find("\r\n\r\n");
+        if (headerEnd == string::npos) return true;
+        static const string kKeyHeader = "Sec-WebSocket-Key:";
+        size_t keyAt = buffer.find(kKeyHeader);
+        if (keyAt == string::npos || keyAt > headerEnd) return false;
+        size_t keyBegin = buffer.find_first_not_of(' ', keyAt + kKeyHeader.size());
+        size_t keyEnd = buffer.find("\r\n", keyBegin);
+        string reply = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+            "Sec-WebSocket-Accept: " + acceptKey(buffer.substr(keyBegin, keyEnd - keyBegin)) + "\r\n\r\n";
+        if (!sendAll(client.fd, reply)) return false;
+        client.upgraded = true;
+        buffer.erase(0, headerEnd + 4);
+    }
+
+    // Client frames: FIN and opcode, the mask bit and length, an extended length, the mask and the payload
+    while (buffer.size() >= 2) {
+        const uint8_t opcode = static_cast<uint8_t>(buffer[0]) & 0x0F;
+        const bool masked = (static_cast<uint8_t>(buffer[1]) & 0x80) != 0;
+        uint64_t length = static_cast<uint8_t>(buffer[1]) & 0x7F;
+        size_t offset = 2;
+        if (length >= 126) {
+            const size_t bytes = length == 126 ? 2 : 8;
+            if (buffer.size() < offset + bytes) return true;
+            length = 0;
+            for (size_t n = 0; n < bytes; n++) length = (length << 8) | static_cast<uint8_t>(buffer[offset + n]);
+            offset += bytes;
+        }
+        const size_t maskAt = offset;
+        if (masked) offset += 4;
+        if (buffer.size() < offset + length) return true;
+        string payload = buffer.substr(offset, static_cast<size_t>(length));
+        if (masked) {
+            for (size_t n = 0; n < payload.size(); n++) payload[n] ^= buffer[maskAt + n % 4];
+        }
+        buffer.erase(0, offset + static_cast<size_t>(length));
+
+        if (opcode == kCloseFrame) {
+            sendAll(client.fd, serverFrame(kCloseFrame, string()));
+            return false;
+        }
+        if (opcode == kPingFrame && !sendAll(client.fd, serverFrame(kPongFrame, payload))) return false;
+        if (opcode == kTextFrame && payload.find("\"subscribe\"") != string::npos) {
+            client.subscribed = true;
+            subscribes++;
+            subscribed.notify_all();
+        }
+    }
+    return true;
+}
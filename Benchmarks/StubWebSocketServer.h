@@ -0,0 +1,62 @@
+#ifndef STUBWEBSOCKETSERVER_H
+#define STUBWEBSOCKETSERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// **Minimal websocket server on the loopback interface that stands in for the Bitvavo feed**
+// One background thread accepts connections, completes the upgrade handshake and reads the client frames.
+// Once a client has sent its subscribe message, every broadcast reaches it as one unmasked text frame, so
+// ticker and candle events can be pushed through the real feed without the exchange.
+class StubWebSocketServer {
+public:
+    StubWebSocketServer() = default;
+    ~StubWebSocketServer();
+    StubWebSocketServer(const StubWebSocketServer&) = delete;
+    StubWebSocketServer& operator=(const StubWebSocketServer&) = delete;
+
+    // **Listen on a loopback port and start serving, returns false if the port cannot be bound**
+    bool start(int port);
+
+    // **Stop serving and close every connection**
+    void stop();
+
+    // **Wait up to timeout for a client to subscribe, returns false if none did**
+    bool waitForSubscriber(std::chrono::milliseconds timeout);
+
+    // **Send a text message to every subscribed client, returns the number of clients it reached**
+    size_t broadcast(const std::string& message);
+
+    // **Subscribe messages received since start**
+    long long subscribeCount() const { return subscribes; }
+
+private:
+    // **Connection of one client, upgraded once its handshake was answered**
+    struct Client {
+        int fd = -1;
+        bool upgraded = false;
+        bool subscribed = false;
+        std::string buffer; // Bytes received but not handled yet
+    };
+
+    int listenFd = -1;
+    std::thread worker;
+    std::atomic<bool> running{ false };
+    std::atomic<long long> subscribes{ 0 };
+    std::mutex clientsMutex;
+    std::condition_variable subscribed;
+    std::vector<Client> clients;
+
+    // **Accept connections and read their frames until stopped**
+    void run();
+
+    // **Answer the handshake and handle every complete frame in a client's buffer, returns false if it broke or closed**
+    bool serve(Client& client);
+};
+
+#endif // !STUBWEBSOCKETSERVER_H
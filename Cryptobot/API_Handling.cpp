@@ -1,10 +1,22 @@
 #include "API_Handling.h"
+#include "ApiJournal.h"
 #include "config.h"
+#include "Metrics.h"
+#include "RateLimiter.h"
+#include "RetryScheduler.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <random>
 #include <curl/curl.h>
 #include <openssl/sha.h>
 #include <openssl/hmac.h>
@@ -32,15 +44,24 @@ size_t WriteCallback(void* contents, size_t size, size_t nmemb, string* output)
     return size * nmemb;
 }
 
+// **Write length bytes as 2 * length lowercase hex digits, without a terminating null**
+void hexEncode(const unsigned char* data, size_t length, char* out) {
+    static const char kHexDigits[] = "0123456789abcdef";
+    for (size_t i = 0; i < length; i++) {
+        out[2 * i] = kHexDigits[data[i] >> 4];
+        out[2 * i + 1] = kHexDigits[data[i] & 0x0f];
+    }
+}
+
 // **Generate HMAC-SHA256 signature for API authentication**
 string generateSignature(const string& secret, const string& message) {
-    unsigned char* digest = HMAC(EVP_sha256(), secret.c_str(), secret.length(),
-        (unsigned char*)message.c_str(), message.length(), NULL, NULL);
-    stringstream ss;
-    for (size_t i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        ss << hex << setw(2) << setfill('0') << (int)digest[i];
-    }
-    return ss.str();
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    unsigned int digestLength = 0;
+    HMAC(EVP_sha256(), secret.c_str(), static_cast<int>(secret.length()),
+        (const unsigned char*)message.c_str(), message.length(), digest, &digestLength);
+    string signature(2 * SHA256_DIGEST_LENGTH, '0');
+    hexEncode(digest, SHA256_DIGEST_LENGTH, &signature[0]);
+    return signature;
 }
 
 // **CURL callback to handle header data (rate limits)**
@@ -79,85 +100,820 @@ size_t HeaderCallback(char* buffer, size_t size, size_t nitems, void* userdata)
     return totalSize;
 }
 
-// **API request function with retry logic**
-json apiRequest(const std::string& endpoint, const std::string& method, const std::string& body) {
-    const int maxRetries = 5;
-    int attempt = 0;
-    int delaySeconds = 1;
-    json parsedResponse;
-    while (attempt < maxRetries) {
-        attempt++;
-        CURL* curl = curl_easy_init();
-        if (!curl) {
+// **Reusable request state, one per pooled CURL handle**
+// The header list nodes point into the strings below, so building the headers of a request does not allocate
+// once the strings have grown to their final size.
+struct PooledHandle {
+    CURL* curl = nullptr;
+    string url;
+    string response;
+    string keyHeader;
+    string timestampHeader;
+    string signatureHeader;
+    curl_slist headers[4];
+    long long rateLimitData[2] = { -1, -1 };
+};
+
+// **Thread-safe pool of CURL handles sharing DNS, TLS session and connection caches**
+// Handles are kept alive between requests, so the connection to the exchange is reused instead of
+// paying a TCP and TLS handshake on every call.
+class CurlPool {
+public:
+    static CurlPool& instance() {
+        static CurlPool pool;
+        return pool;
+    }
+
+    // **Take an idle handle, or create one when all are in use**
+    PooledHandle* acquire() {
+        {
+            lock_guard<mutex> lock(poolMutex);
+            if (!idle.empty()) {
+                PooledHandle* handle = idle.back();
+                idle.pop_back();
+                return handle;
+            }
+        }
+        auto handle = make_unique<PooledHandle>();
+        handle->curl = curl_easy_init();
+        if (!handle->curl) return nullptr;
+        curl_easy_setopt(handle->curl, CURLOPT_SHARE, share);
+        curl_easy_setopt(handle->curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(handle->curl, CURLOPT_TCP_KEEPIDLE, 30L);
+        curl_easy_setopt(handle->curl, CURLOPT_TCP_KEEPINTVL, 15L);
+        curl_easy_setopt(handle->curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(handle->curl, CURLOPT_WRITEDATA, &handle->response);
+        curl_easy_setopt(handle->curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+        curl_easy_setopt(handle->curl, CURLOPT_HEADERDATA, handle->rateLimitData);
+        curl_easy_setopt(handle->curl, CURLOPT_HTTPHEADER, handle->headers);
+        curl_easy_setopt(handle->curl, CURLOPT_PIPEWAIT, 1L);
+        static char contentType[] = "Content-Type: application/json";
+        handle->headers[3].data = contentType;
+        handle->headers[3].next = nullptr;
+        for (int i = 0; i < 3; i++) handle->headers[i].next = &handle->headers[i + 1];
+        lock_guard<mutex> lock(poolMutex);
+        handles.push_back(move(handle));
+        return handles.back().get();
+    }
+
+    // **Return a handle to the pool, keeping its connection open**
+    void release(PooledHandle* handle) {
+        lock_guard<mutex> lock(poolMutex);
+        idle.push_back(handle);
+    }
+
+private:
+    CURLSH* share = nullptr;
+    mutex shareLocks[CURL_LOCK_DATA_LAST];
+    mutex poolMutex;
+    vector<unique_ptr<PooledHandle>> handles;
+    vector<PooledHandle*> idle;
+
+    CurlPool() {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        share = curl_share_init();
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockShare);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+
+    ~CurlPool() {
+        for (auto& handle : handles) curl_easy_cleanup(handle->curl);
+        curl_share_cleanup(share);
+        curl_global_cleanup();
+    }
+
+    static void lockShare(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+        static_cast<CurlPool*>(userptr)->shareLocks[data].lock();
+    }
+
+    static void unlockShare(CURL*, curl_lock_data data, void* userptr) {
+        static_cast<CurlPool*>(userptr)->shareLocks[data].unlock();
+    }
+};
+
+// **Returns a pooled handle when it goes out of scope**
+struct PooledHandleGuard {
+    PooledHandle* handle;
+    explicit PooledHandleGuard(PooledHandle* pooled) : handle(pooled) {}
+    PooledHandleGuard(PooledHandleGuard&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    PooledHandleGuard(const PooledHandleGuard&) = delete;
+    PooledHandleGuard& operator=(const PooledHandleGuard&) = delete;
+    ~PooledHandleGuard() {
+        if (handle) CurlPool::instance().release(handle);
+    }
+};
+
+// **Handshakes and latencies of the transfers of apiRequest, over whichever transport they went**
+class TransferStats {
+public:
+    static TransferStats& instance() {
+        static TransferStats transferStats;
+        return transferStats;
+    }
+
+    // **Record handshakes and latency of a finished transfer**
+    void record(const string& endpoint, const ApiResponse& response) {
+        requests++;
+        handshakes += response.newConnections;
+        Metrics::instance().record(apiLatencyMetric(endpoint), response.durationMicros * 1000);
+        lock_guard<mutex> lock(latencyMutex);
+        if (latencySamples.size() < kLatencySamples) latencySamples.push_back(response.durationMicros / 1000.0);
+        else latencySamples[latencyNext] = response.durationMicros / 1000.0;
+        latencyNext = (latencyNext + 1) % kLatencySamples;
+    }
+
+    // **Snapshot of the connection statistics**
+    ConnectionStats stats() {
+        ConnectionStats result;
+        result.requests = requests;
+        result.handshakes = handshakes;
+        vector<double> samples;
+        {
+            lock_guard<mutex> lock(latencyMutex);
+            samples = latencySamples;
+        }
+        if (!samples.empty()) {
+            sort(samples.begin(), samples.end());
+            result.p50Ms = samples[(samples.size() - 1) * 50 / 100];
+            result.p99Ms = samples[(samples.size() - 1) * 99 / 100];
+        }
+        return result;
+    }
+
+private:
+    static const size_t kLatencySamples = 1024;
+
+    atomic<long long> requests{ 0 };
+    atomic<long long> handshakes{ 0 };
+    mutex latencyMutex;
+    vector<double> latencySamples;
+    size_t latencyNext = 0;
+};
+
+// **Connection reuse and latency statistics of apiRequest**
+ConnectionStats getConnectionStats() {
+    return TransferStats::instance().stats();
+}
+
+// **Set URL, method, body and freshly signed headers of a pooled handle**
+static void prepareRequest(PooledHandle& handle, const string& endpoint, const string& method, const string& body) {
+    CURL* curl = handle.curl;
+    handle.response.clear();
+    handle.rateLimitData[0] = -1;
+    handle.rateLimitData[1] = -1;
+    handle.url.assign(BASE_URL).append(endpoint);
+    curl_easy_setopt(curl, CURLOPT_URL, handle.url.c_str());
+    if (method == "POST") {
+        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    }
+    else {
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    }
+    string timestamp = to_string(chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count());
+    string message = timestamp + method + "/v2/" + endpoint + body;
+    string signature = generateSignature(API_SECRET, message);
+    handle.keyHeader.assign("Bitvavo-Access-Key: ").append(API_KEY);
+    handle.timestampHeader.assign("Bitvavo-Access-Timestamp: ").append(timestamp);
+    handle.signatureHeader.assign("Bitvavo-Access-Signature: ").append(signature);
+    handle.headers[0].data = &handle.keyHeader[0];
+    handle.headers[1].data = &handle.timestampHeader[0];
+    handle.headers[2].data = &handle.signatureHeader[0];
+}
+
+// **libcurl transport to BASE_URL over the pooled handles**
+class CurlTransport : public ApiTransport {
+public:
+    static CurlTransport& instance() {
+        static CurlTransport transport;
+        return transport;
+    }
+
+    const char* name() const override { return "libcurl"; }
+
+    bool send(const string& endpoint, const string& method, const string& body, ApiResponse& response) override {
+        PooledHandleGuard guard{ CurlPool::instance().acquire() };
+        if (!guard.handle) {
             cerr << "Failed to initialize CURL" << endl;
-            break;
-        }
-        string url = BASE_URL + endpoint;
-        string response;
-        string timestamp = to_string(chrono::duration_cast<chrono::milliseconds>(
-            chrono::system_clock::now().time_since_epoch()).count());
-        string message = timestamp + method + "/v2/" + endpoint + body;
-        string signature = generateSignature(API_SECRET, message);
-        struct curl_slist* headers = NULL;
-        headers = curl_slist_append(headers, ("Bitvavo-Access-Key: " + API_KEY).c_str());
-        headers = curl_slist_append(headers, ("Bitvavo-Access-Timestamp: " + timestamp).c_str());
-        headers = curl_slist_append(headers, ("Bitvavo-Access-Signature: " + signature).c_str());
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        long long rateLimitData[2] = { -1, -1 };
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
-        curl_easy_setopt(curl, CURLOPT_HEADERDATA, rateLimitData);
-        if (method == "POST") {
-            curl_easy_setopt(curl, CURLOPT_POST, 1L);
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
-        }
-        CURLcode res = curl_easy_perform(curl);
-        if (res != CURLE_OK) {
-            cerr << "curl_easy_perform() failed: " << curl_easy_strerror(res)
-                << ". Attempt " << attempt << " of " << maxRetries << endl;
-            curl_easy_cleanup(curl);
-            curl_slist_free_all(headers);
-            this_thread::sleep_for(chrono::seconds(delaySeconds));
-            delaySeconds *= 2;
-            continue;
+            return false;
+        }
+        prepareRequest(*guard.handle, endpoint, method, body);
+        readTransfer(*guard.handle, curl_easy_perform(guard.handle->curl), response);
+        return true;
+    }
+
+    // **Send the batch over a multi handle, so the requests share the connection pool and run concurrently**
+    bool sendBatch(const vector<ApiRequest>& requests, vector<ApiResponse>& responses) override {
+        CURLM* multi = curl_multi_init();
+        if (!multi) {
+            cerr << "Failed to initialize CURL multi handle, sending the batch sequentially" << endl;
+            return false;
+        }
+        responses.resize(requests.size());
+        vector<PooledHandleGuard> guards;
+        guards.reserve(requests.size());
+        for (size_t i = 0; i < requests.size(); i++) {
+            // Overwritten when the transfer finishes
+            ApiResponse& response = responses[i];
+            response.body.clear();
+            response.httpCode = 0;
+            response.rateLimitRemaining = response.rateLimitResetAt = -1;
+            guards.emplace_back(CurlPool::instance().acquire());
+            PooledHandle* handle = guards.back().handle;
+            if (!handle) {
+                response.error = CURLE_FAILED_INIT;
+                response.errorText = "Failed to initialize CURL";
+                continue;
+            }
+            response.error = CURLE_RECV_ERROR;
+            response.errorText = "The batch ended before the transfer finished";
+            prepareRequest(*handle, requests[i].endpoint, requests[i].method, requests[i].body);
+            curl_easy_setopt(handle->curl, CURLOPT_PRIVATE, reinterpret_cast<char*>(i));
+            curl_multi_add_handle(multi, handle->curl);
+        }
+
+        int stillRunning = 0;
+        do {
+            CURLMcode mc = curl_multi_perform(multi, &stillRunning);
+            if (mc != CURLM_OK) {
+                cerr << "curl_multi_perform() failed: " << curl_multi_strerror(mc) << endl;
+                break;
+            }
+            if (stillRunning) curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        } while (stillRunning);
+
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            char* privateData = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &privateData);
+            size_t i = reinterpret_cast<size_t>(privateData);
+            readTransfer(*guards[i].handle, msg->data.result, responses[i]);
+        }
+        for (PooledHandleGuard& guard : guards) {
+            if (guard.handle) curl_multi_remove_handle(multi, guard.handle->curl);
+        }
+        curl_multi_cleanup(multi);
+        return true;
+    }
+
+private:
+    // **Move the outcome of a finished transfer of a pooled handle into a response**
+    static void readTransfer(PooledHandle& handle, CURLcode res, ApiResponse& response) {
+        response.error = static_cast<int>(res);
+        response.errorText = curl_easy_strerror(res);
+        response.httpCode = 0;
+        if (res == CURLE_OK) curl_easy_getinfo(handle.curl, CURLINFO_RESPONSE_CODE, &response.httpCode);
+        // Swapped, so the handle and the response both keep a grown buffer
+        response.body.swap(handle.response);
+        response.rateLimitRemaining = handle.rateLimitData[0];
+        response.rateLimitResetAt = handle.rateLimitData[1];
+        curl_off_t totalMicroseconds = 0;
+        curl_easy_getinfo(handle.curl, CURLINFO_TOTAL_TIME_T, &totalMicroseconds);
+        response.durationMicros = static_cast<long long>(totalMicroseconds);
+        response.newConnections = 0;
+        curl_easy_getinfo(handle.curl, CURLINFO_NUM_CONNECTS, &response.newConnections);
+    }
+};
+
+// Transport put in place of libcurl, null while apiRequest goes to BASE_URL
+static atomic<ApiTransport*> g_apiTransport{ nullptr };
+
+// **Send requests concurrently, returns false without sending any if the batch cannot be sent**
+bool ApiTransport::sendBatch(const vector<ApiRequest>& requests, vector<ApiResponse>& responses) {
+    responses.resize(requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        if (send(requests[i].endpoint, requests[i].method, requests[i].body, responses[i])) continue;
+        responses[i].error = -1;
+        responses[i].errorText = "The request could not be sent";
+    }
+    return true;
+}
+
+// **Send apiRequest through a transport, or through libcurl to BASE_URL again with null**
+void setApiTransport(ApiTransport* transport) {
+    g_apiTransport.store(transport);
+}
+
+// **Transport apiRequest sends through**
+ApiTransport& apiTransport() {
+    ApiTransport* transport = g_apiTransport.load();
+    return transport ? *transport : CurlTransport::instance();
+}
+
+// **True while apiRequest goes to BASE_URL over libcurl, the exchange the order connection and the feed reach**
+bool usingExchangeTransport() {
+    return g_apiTransport.load() == nullptr;
+}
+
+// **True if a transport error happened before the request could reach the exchange, so sending it again is safe**
+bool failedBeforeSending(int transportError) {
+    return transportError == CURLE_COULDNT_RESOLVE_PROXY || transportError == CURLE_COULDNT_RESOLVE_HOST
+        || transportError == CURLE_COULDNT_CONNECT || transportError == CURLE_SSL_CONNECT_ERROR
+        || transportError == CURLE_FAILED_INIT || transportError == -1;
+}
+
+// **Milliseconds since the epoch on the wall clock**
+static long long wallClockMs() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// **Show the rate limit headers of a response in the poll output**
+static void publishRateLimit(const ApiResponse& response) {
+    if (response.rateLimitRemaining != -1) g_rateLimitRemaining = response.rateLimitRemaining;
+    if (response.rateLimitResetAt != -1) g_rateLimitResetAt = response.rateLimitResetAt;
+}
+
+// **Append a finished transfer to the journal**
+static void captureTransfer(JournalWriter& journal, const string& endpoint, const string& method, const string& body,
+    const ApiResponse& response, long long sentAtMs) {
+    JournalEntry entry;
+    entry.timeMs = sentAtMs;
+    entry.durationMicros = response.durationMicros;
+    entry.transportError = response.error;
+    entry.httpCode = response.httpCode;
+    entry.rateLimitRemaining = response.rateLimitRemaining;
+    entry.rateLimitResetAt = response.rateLimitResetAt;
+    entry.method = method;
+    entry.endpoint = endpoint;
+    entry.requestBody = body;
+    entry.body = response.body;
+    journal.append(entry);
+}
+
+// Attempts of a request before apiRequest gives up on it
+static const int kMaxAttempts = 5;
+
+// **Milliseconds since a steady clock time point**
+static long long millisSince(chrono::steady_clock::time_point start) {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+}
+
+// **Requests of one call, sent in rounds until each is parsed or given up on**
+// Every round sends the requests that are due as one batch, taking their rate limit budget highest priority first.
+// A failed attempt is handed back with a jittered backoff, or to go again at once after HTTP 429 since the rate
+// limiter holds it back until the window resets, and whoever drives the batch files it on a timer wheel while the
+// other requests carry on. A driver that must not wait for budget, such as the retry thread, gets a request the
+// limiter has no budget for handed back in the same way, to go when the window resets. A request whose next
+// attempt would come after its deadline is dropped. A transport
+// without real time, such as a replayed journal, is not rate limited, retries at once and ignores deadlines.
+// Only a GET is retried whatever went wrong. Any other request, such as an order, is only sent again when it did not
+// reach the exchange: after HTTP 429 or a transport error before sending. When it may have been carried out, after a
+// later transport error, a 5xx or a malformed body, its outcome is marked unknown for the caller to look it up.
+class RequestBatch {
+public:
+    // **A request handed back, failed or without budget, and the time until its next attempt**
+    struct Retry {
+        size_t request;
+        long long delayMs;
+    };
+
+    const bool realTime;
+    const bool waitForBudget;    // Block in the rate limiter, instead of handing back requests without budget
+    vector<size_t> ready;        // Requests due to be sent
+    vector<Retry> retries;       // Failed requests to file on the wheel, cleared by the driver
+    vector<bool> outcomeUnknown; // Requests that may have been carried out although no response was parsed
+
+    RequestBatch(const vector<ApiRequest>& batchRequests, const ResponseParser* batchParsers, vector<bool>& parsedOut,
+        bool blockForBudget)
+        : realTime(apiTransport().realTime()), waitForBudget(blockForBudget), requests(batchRequests), parsers(batchParsers), parsed(parsedOut),
+        transport(apiTransport()), journal(apiCapture()), start(chrono::steady_clock::now()) {
+        parsed.assign(requests.size(), false);
+        outcomeUnknown.assign(requests.size(), false);
+        attempts.assign(requests.size(), 0);
+        weights.resize(requests.size());
+        priorities.resize(requests.size());
+        ready.resize(requests.size());
+        for (size_t i = 0; i < requests.size(); i++) {
+            weights[i] = RateLimiter::endpointWeight(requests[i].endpoint, requests[i].method);
+            priorities[i] = min(requests[i].priority, RateLimiter::requestPriority(requests[i].method));
+            ready[i] = i;
+        }
+    }
+
+    // **Milliseconds since the batch was created, the clock its deadlines count on**
+    long long elapsedMs() const { return millisSince(start); }
+
+    // **Send the ready requests as one round and judge their responses**
+    void sendRound() {
+        static const RequestPriority kPriorities[] = { RequestPriority::Order, RequestPriority::Ticker,
+            RequestPriority::MarketData };
+        // Reused by the requests of a thread, so the response bodies keep their capacity
+        thread_local vector<ApiResponse> responses;
+        thread_local vector<ApiRequest> subset;
+        RateLimiter& limiter = RateLimiter::instance();
+
+        // One request per round once the transport could not send a batch
+        round.clear();
+        if (batches) {
+            // In request order, so a round of all requests is the batch as the caller built it
+            round.swap(ready);
+            sort(round.begin(), round.end());
+        }
+        else {
+            round.push_back(ready.front());
+            ready.erase(ready.begin());
+        }
+        for (RequestPriority priority : kPriorities) {
+            for (size_t& i : round) {
+                if (i == kDeferred || priorities[i] != priority) continue;
+                long long retryAtMs;
+                if (realTime && waitForBudget) limiter.acquire(weights[i], priority);
+                else if (realTime && !limiter.tryAcquire(weights[i], priority, &retryAtMs)) {
+                    deferUntil(i, retryAtMs);
+                    i = kDeferred;
+                    continue;
+                }
+                attempts[i]++;
+            }
+        }
+        round.erase(remove(round.begin(), round.end(), kDeferred), round.end());
+        if (round.empty()) return;
+
+        const long long sentAtMs = wallClockMs();
+        bool sent;
+        if (round.size() == 1) {
+            const ApiRequest& request = requests[round.front()];
+            responses.resize(1);
+            sent = transport.send(request.endpoint, request.method, request.body, responses[0]);
+        }
+        else if (round.size() == requests.size()) {
+            sent = transport.sendBatch(requests, responses);
+        }
+        else {
+            subset.clear();
+            for (size_t i : round) subset.push_back(requests[i]);
+            sent = transport.sendBatch(subset, responses);
+        }
+        if (!sent) {
+            for (size_t i : round) {
+                if (realTime) limiter.complete(weights[i], -1, -1, false);
+                attempts[i]--;
+            }
+            // A single request that cannot be sent is not retried
+            if (round.size() > 1) {
+                batches = false;
+                ready.insert(ready.begin(), round.begin(), round.end());
+            }
+            return;
+        }
+        for (size_t n = 0; n < round.size(); n++) handle(round[n], responses[n], sentAtMs);
+    }
+
+private:
+    const vector<ApiRequest>& requests;
+    const ResponseParser* parsers;
+    vector<bool>& parsed;
+    ApiTransport& transport;
+    JournalWriter* journal;
+    const chrono::steady_clock::time_point start;
+    vector<int> attempts;
+    vector<int> weights;
+    vector<RequestPriority> priorities;
+    vector<size_t> round;
+    bool batches = true;
+    static constexpr size_t kDeferred = static_cast<size_t>(-1); // Marks a request of the round handed back for lack of budget
+
+    // **Hand back a request the rate limiter has no budget for, to go when the window resets at retryAtMs**
+    // Dropped instead if that passes its deadline. It is not an attempt, so it does not count as a retry.
+    void deferUntil(size_t i, long long retryAtMs) {
+        const ApiRequest& request = requests[i];
+        const long long delayMs = max(retryAtMs - wallClockMs(), 0LL);
+        if (request.deadlineMs > 0 && elapsedMs() + delayMs > request.deadlineMs) {
+            cerr << "Dropping " << request.endpoint << ", the rate limit window resets after its deadline of "
+                << request.deadlineMs << " ms." << endl;
+            Metrics::instance().recordDropped();
+            return;
+        }
+        retries.push_back({ i, delayMs });
+    }
+
+    // **Hand back the next attempt of a failed request, unless it has used all attempts or would miss its deadline**
+    void retry(size_t i, long httpCode, bool backoff) {
+        thread_local mt19937 random(random_device{}());
+        const ApiRequest& request = requests[i];
+        if (attempts[i] >= kMaxAttempts) {
+            cerr << "Max retries reached for " << request.endpoint << ". Returning empty response." << endl;
+            return;
+        }
+        const long long delayMs = realTime && backoff ? RetryScheduler::backoffMillis(attempts[i], random) : 0;
+        if (realTime && request.deadlineMs > 0 && elapsedMs() + delayMs > request.deadlineMs) {
+            cerr << "Dropping " << request.endpoint << ", its next attempt would pass the deadline of "
+                << request.deadlineMs << " ms." << endl;
+            Metrics::instance().recordDropped();
+            return;
+        }
+        Metrics::instance().recordRetry(httpCode);
+        retries.push_back({ i, delayMs });
+    }
+
+    // **Judge the response to one attempt of a request**
+    void handle(size_t i, const ApiResponse& response, long long sentAtMs) {
+        const ApiRequest& request = requests[i];
+        const long http_code = response.httpCode;
+        if (realTime) RateLimiter::instance().complete(weights[i], response.rateLimitRemaining,
+            response.rateLimitResetAt, http_code == 429);
+        publishRateLimit(response);
+        if (journal) captureTransfer(*journal, request.endpoint, request.method, request.body, response, sentAtMs);
+        const bool idempotent = request.method == "GET";
+        if (response.error != 0) {
+            cerr << "Request failed for " << request.endpoint << ": " << response.errorText << ". Attempt "
+                << attempts[i] << " of " << kMaxAttempts << endl;
+            if (idempotent || failedBeforeSending(response.error)) retry(i, 0, true);
+            else giveUpUnknown(i);
+            return;
         }
-        long http_code = 0;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
+        if (realTime) TransferStats::instance().record(request.endpoint, response);
         if (http_code == 429) {
-            cerr << "HTTP 429 Too Many Requests. Attempt " << attempt
-                << " of " << maxRetries << ". Retrying after " << delaySeconds << " seconds." << endl;
-            this_thread::sleep_for(chrono::seconds(delaySeconds));
-            delaySeconds *= 2;
-            continue;
+            cerr << "HTTP 429 Too Many Requests for " << request.endpoint << ". Attempt " << attempts[i]
+                << " of " << kMaxAttempts << ". Retrying when the rate limit resets." << endl;
+            retry(i, http_code, false);
         }
         else if (http_code == 401 || http_code == 403) {
-            cerr << "Fatal HTTP error " << http_code << ". Not retrying." << endl;
-            break;
+            cerr << "Fatal HTTP error " << http_code << " for " << request.endpoint << ". Not retrying." << endl;
         }
         else if (http_code != 200 && http_code != 201) {
-            cerr << "HTTP request failed with code: " << http_code << ". Attempt " << attempt
-                << " of " << maxRetries << ". Response: " << response << endl;
-            this_thread::sleep_for(chrono::seconds(delaySeconds));
-            delaySeconds *= 2;
+            cerr << "HTTP request failed with code: " << http_code << " for " << request.endpoint << ". Attempt "
+                << attempts[i] << " of " << kMaxAttempts << ". Response: " << response.body << endl;
+            if (idempotent) retry(i, http_code, true);
+            else if (http_code >= 500) giveUpUnknown(i);
+        }
+        else if (parsers[i](response.body.data(), response.body.size())) {
+            parsed[i] = true;
+        }
+        else {
+            cerr << "Malformed response for " << request.endpoint << ". Attempt " << attempts[i] << " of "
+                << kMaxAttempts << ". Response: " << response.body << endl;
+            if (idempotent) retry(i, http_code, true);
+            else giveUpUnknown(i);
+        }
+    }
+
+    // **Stop sending a request that may have been carried out, so it is not carried out twice**
+    void giveUpUnknown(size_t i) {
+        cerr << requests[i].method << " " << requests[i].endpoint << " may have reached the exchange, not sending it again."
+            << endl;
+        outcomeUnknown[i] = true;
+    }
+};
+
+// **Send requests until each is parsed or given up on, waiting for their retries on the calling thread**
+// unknown, if given, receives the requests that may have been carried out although no response was parsed.
+static void sendRequests(const vector<ApiRequest>& requests, const ResponseParser* parsers, vector<bool>& parsed,
+    vector<bool>* unknown = nullptr) {
+    thread_local RetryScheduler retries;
+    retries.clear();
+    RequestBatch batch(requests, parsers, parsed, true);
+    while (true) {
+        for (const RequestBatch::Retry& retry : batch.retries) {
+            retries.schedule(retry.request, batch.realTime ? batch.elapsedMs() + retry.delayMs : 0);
+        }
+        batch.retries.clear();
+        if (!batch.ready.empty()) {
+            batch.sendRound();
             continue;
         }
+        if (retries.empty()) break;
+        if (batch.realTime) {
+            long long waitMs = retries.nextDue() - batch.elapsedMs();
+            if (waitMs > 0) this_thread::sleep_for(chrono::milliseconds(waitMs));
+        }
+        retries.takeDue(batch.realTime ? batch.elapsedMs() : 0, batch.ready);
+    }
+    if (unknown) *unknown = batch.outcomeUnknown;
+}
+
+// **Background thread that sends the batches of apiRequestBatchAsync**
+// The retries of all its batches wait on one timer wheel, so a batch whose requests are backing off holds up
+// neither its caller nor the batches sent after it: each pass sends a round of every batch with requests due,
+// files the failed ones on the wheel and sleeps until the earliest retry or a new batch. It never waits for rate
+// limit budget either, a request without budget goes on the wheel until the window resets.
+class RetryDispatcher {
+public:
+    static RetryDispatcher& instance() {
+        static RetryDispatcher dispatcher;
+        return dispatcher;
+    }
+
+    // **Queue a batch, its result is set once every request is parsed or given up on**
+    future<vector<bool>> submit(const vector<ApiRequest>& requests, const vector<ResponseParser>& parsers,
+        function<void()> onDone) {
+        auto job = make_unique<Job>();
+        job->requests = requests;
+        job->parsers = parsers;
+        job->onDone = move(onDone);
+        future<vector<bool>> result = job->result.get_future();
+        {
+            lock_guard<mutex> lock(submitMutex);
+            submitted.push_back(move(job));
+        }
+        wakeUp.notify_one();
+        return result;
+    }
+
+private:
+    // **A queued batch and its state, owned by the dispatcher thread once taken from submitted**
+    struct Job {
+        vector<ApiRequest> requests;
+        vector<ResponseParser> parsers;
+        vector<bool> parsed;
+        unique_ptr<RequestBatch> batch;
+        size_t waiting = 0; // Retries of the batch on the wheel
+        promise<vector<bool>> result;
+        function<void()> onDone;
+    };
+
+    // **Retry on the wheel, ids of the wheel index these**
+    struct Timer {
+        Job* job;
+        size_t request;
+    };
+
+    mutex submitMutex;
+    condition_variable wakeUp;
+    vector<unique_ptr<Job>> submitted;
+    bool stopping = false;
+    // Dispatcher thread only
+    vector<unique_ptr<Job>> jobs;
+    RetryScheduler wheel;
+    vector<Timer> timers;
+    vector<size_t> freeTimers;
+    vector<size_t> due;
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    thread worker;
+
+    RetryDispatcher() {
+        // Created first, so they are destroyed after the thread that uses them is joined
+        CurlTransport::instance();
+        CurlPool::instance();
+        TransferStats::instance();
+        RateLimiter::instance();
+        Metrics::instance();
+        worker = thread(&RetryDispatcher::run, this);
+    }
+
+    ~RetryDispatcher() {
+        {
+            lock_guard<mutex> lock(submitMutex);
+            stopping = true;
+        }
+        wakeUp.notify_one();
+        worker.join();
+    }
+
+    // **File the retries a round handed back on the shared wheel**
+    void fileRetries(Job& job) {
+        for (const RequestBatch::Retry& retry : job.batch->retries) {
+            size_t id = timers.size();
+            if (!freeTimers.empty()) {
+                id = freeTimers.back();
+                freeTimers.pop_back();
+                timers[id] = { &job, retry.request };
+            }
+            else {
+                timers.push_back({ &job, retry.request });
+            }
+            wheel.schedule(id, millisSince(start) + retry.delayMs);
+            job.waiting++;
+        }
+        job.batch->retries.clear();
+    }
+
+    void run() {
+        while (true) {
+            {
+                unique_lock<mutex> lock(submitMutex);
+                bool sending = any_of(jobs.begin(), jobs.end(), [](const unique_ptr<Job>& job) {
+                    return !job->batch->ready.empty();
+                });
+                if (!sending) {
+                    auto ready = [this] { return stopping || !submitted.empty(); };
+                    if (wheel.empty()) wakeUp.wait(lock, ready);
+                    else wakeUp.wait_for(lock, chrono::milliseconds(max(wheel.nextDue() - millisSince(start), 0LL)), ready);
+                }
+                if (stopping) return;
+                for (unique_ptr<Job>& job : submitted) {
+                    job->batch = make_unique<RequestBatch>(job->requests, job->parsers.data(), job->parsed, false);
+                    jobs.push_back(move(job));
+                }
+                submitted.clear();
+            }
+
+            due.clear();
+            wheel.takeDue(millisSince(start), due);
+            for (size_t id : due) {
+                timers[id].job->batch->ready.push_back(timers[id].request);
+                timers[id].job->waiting--;
+                freeTimers.push_back(id);
+            }
+            for (unique_ptr<Job>& job : jobs) {
+                if (job->batch->ready.empty()) continue;
+                job->batch->sendRound();
+                fileRetries(*job);
+            }
+
+            // A batch with nothing to send and no retries on the wheel is done
+            auto finished = stable_partition(jobs.begin(), jobs.end(), [](const unique_ptr<Job>& job) {
+                return !job->batch->ready.empty() || job->waiting > 0;
+            });
+            // onDone runs first, an owner that waits for the result before it is destroyed is still there
+            for (auto job = finished; job != jobs.end(); ++job) {
+                if ((*job)->onDone) (*job)->onDone();
+                (*job)->result.set_value((*job)->parsed);
+            }
+            jobs.erase(finished, jobs.end());
+        }
+    }
+};
+
+// **API request whose response body is handed to a parser in the receive buffer, with retry logic**
+// A body the parser rejects as malformed is retried like a failed request.
+bool apiRequestParsed(const ApiRequest& request, const ResponseParser& parse) {
+    thread_local vector<ApiRequest> single(1);
+    thread_local vector<bool> parsed;
+    single[0] = request;
+    sendRequests(single, &parse, parsed);
+    return parsed[0];
+}
+
+bool apiRequestParsed(const ApiRequest& request, const ResponseParser& parse, bool& outcomeUnknown) {
+    thread_local vector<ApiRequest> single(1);
+    thread_local vector<bool> parsed;
+    thread_local vector<bool> unknown;
+    single[0] = request;
+    sendRequests(single, &parse, parsed, &unknown);
+    outcomeUnknown = unknown[0];
+    return parsed[0];
+}
+
+bool apiRequestParsed(const std::string& endpoint, const ResponseParser& parse, const std::string& method,
+    const std::string& body) {
+    thread_local ApiRequest request;
+    request.endpoint = endpoint;
+    request.method = method;
+    request.body = body;
+    return apiRequestParsed(request, parse);
+}
+
+// **Parser that stores the response as json, for the requests without a parser of their own**
+static ResponseParser jsonParser(json& result) {
+    return [&result](const char* data, size_t size) {
         try {
-            parsedResponse = json::parse(response);
-            return parsedResponse;
+            result = json::parse(data, data + size);
+            return true;
         }
         catch (const json::parse_error& e) {
-            cerr << "JSON parse error: " << e.what()
-                << ". Attempt " << attempt << " of " << maxRetries << ". Response: " << response << endl;
-            this_thread::sleep_for(chrono::seconds(delaySeconds));
-            delaySeconds *= 2;
-            continue;
+            cerr << "JSON parse error: " << e.what() << endl;
+            return false;
         }
-    }
-    cerr << "Max retries reached. Returning empty JSON." << endl;
-    return json{};
-}
\ No newline at end of file
+    };
+}
+
+// **API request function with retry logic**
+json apiRequest(const std::string& endpoint, const std::string& method, const std::string& body) {
+    json result;
+    if (!apiRequestParsed(endpoint, jsonParser(result), method, body)) return json{};
+    return result;
+}
+
+json apiRequest(const ApiRequest& request) {
+    json result;
+    if (!apiRequestParsed(request, jsonParser(result))) return json{};
+    return result;
+}
+
+// **Send a batch of requests concurrently, handing each response body to the parser of its request**
+// An entry of the result is false when its retries give up or its deadline passes, its parser has then not seen
+// a usable response.
+vector<bool> apiRequestBatchParsed(const vector<ApiRequest>& requests, const vector<ResponseParser>& parsers) {
+    vector<bool> parsed;
+    sendRequests(requests, parsers.data(), parsed);
+    return parsed;
+}
+
+// **Send a batch of requests concurrently, responses are returned in request order**
+vector<json> apiRequestBatch(const vector<ApiRequest>& requests) {
+    vector<json> results(requests.size());
+    vector<ResponseParser> parsers;
+    parsers.reserve(requests.size());
+    for (json& result : results) parsers.push_back(jsonParser(result));
+    apiRequestBatchParsed(requests, parsers);
+    return results;
+}
+
+// **Send a batch of requests in the background, handing each response body to the parser of its request**
+future<vector<bool>> apiRequestBatchAsync(const vector<ApiRequest>& requests, const vector<ResponseParser>& parsers,
+    function<void()> onDone) {
+    if (apiTransport().realTime()) return RetryDispatcher::instance().submit(requests, parsers, move(onDone));
+    // A replayed journal serves the requests in the order they were sent, so the batch is sent before returning
+    promise<vector<bool>> result;
+    vector<bool> parsed = apiRequestBatchParsed(requests, parsers);
+    if (onDone) onDone();
+    result.set_value(move(parsed));
+    return result.get_future();
+}
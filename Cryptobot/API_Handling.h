@@ -1,7 +1,11 @@
 #ifndef API_HANDLING_H
 #define API_HANDLING_H
 
-
+#include "RateLimiter.h"
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
 #include <nlohmann/json.hpp>
 using json = nlohmann::json;
 
@@ -11,13 +15,123 @@ std::string get_env(const std::string& key);
 // **CURL callback to handle response data**
 size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output);
 
+// **Write length bytes as 2 * length lowercase hex digits, without a terminating null**
+void hexEncode(const unsigned char* data, size_t length, char* out);
+
 // **Generate HMAC-SHA256 signature for API authentication**
 std::string generateSignature(const std::string& secret, const std::string& message);
 
 // **CURL callback to handle header data (rate limits)**
 size_t HeaderCallback(char* buffer, size_t size, size_t nitems, void* userdata);
 
+// **Connection reuse and latency statistics of apiRequest**
+struct ConnectionStats {
+    long long requests = 0;   // Completed HTTP transfers
+    long long handshakes = 0; // New connections (TCP and TLS handshakes) opened for them
+    double p50Ms = 0.0;       // Median request latency over the last 1024 requests
+    double p99Ms = 0.0;       // 99th percentile request latency over the last 1024 requests
+};
+ConnectionStats getConnectionStats();
+
+// **Parser of a response body in the receive buffer, returns false if the body is malformed**
+using ResponseParser = std::function<bool(const char* data, size_t size)>;
+
+// **A single request of apiRequest or of a batch**
+// Requests other than a GET are always sent with order priority. A request with a deadline is dropped once its
+// next retry would fall after the deadline, so a stale candle fetch does not hold up the requests around it.
+struct ApiRequest {
+    ApiRequest() = default;
+    ApiRequest(const std::string& requestEndpoint, const std::string& requestMethod = "GET",
+        const std::string& requestBody = "", RequestPriority requestPriority = RequestPriority::MarketData,
+        long long requestDeadlineMs = 0)
+        : endpoint(requestEndpoint), method(requestMethod), body(requestBody), priority(requestPriority),
+        deadlineMs(requestDeadlineMs) {}
+
+    std::string endpoint;
+    std::string method = "GET";
+    std::string body;
+    RequestPriority priority = RequestPriority::MarketData;
+    long long deadlineMs = 0; // Time the request may take including its retries, 0 for no deadline
+};
+
+// **API request whose response body is handed to a parser in the receive buffer, with retry logic**
+// Returns false if no response could be parsed; a body the parser rejects is retried like a failed request.
+bool apiRequestParsed(const std::string& endpoint, const ResponseParser& parse, const std::string& method = "GET",
+    const std::string& body = "");
+bool apiRequestParsed(const ApiRequest& request, const ResponseParser& parse);
+
+// **API request whose response body is handed to a parser, telling whether an unparsed request may have been carried out**
+// A request other than a GET is only sent again when it did not reach the exchange. outcomeUnknown is set when it
+// may have, after a transport error once connected, a 5xx or a malformed body, so the caller can look it up.
+bool apiRequestParsed(const ApiRequest& request, const ResponseParser& parse, bool& outcomeUnknown);
+
 // **API request function with retry logic**
 json apiRequest(const std::string& endpoint, const std::string& method = "GET", const std::string& body = "");
+json apiRequest(const ApiRequest& request);
+
+// **Response of a request as a transport received it**
+struct ApiResponse {
+    int error = 0;                     // Transport error code of the backend, 0 when a response arrived
+    const char* errorText = "";        // Description of the transport error
+    long httpCode = 0;
+    std::string body;
+    long long rateLimitRemaining = -1; // bitvavo-ratelimit-remaining header, -1 if it was missing
+    long long rateLimitResetAt = -1;   // bitvavo-ratelimit-resetat header, -1 if it was missing
+    long long durationMicros = 0;      // Time from sending the request to the end of the response
+    long newConnections = 0;           // Connections opened for the request
+};
+
+// **Sends the requests of apiRequest, below its rate limiting, retries and journaling**
+// The default transport is libcurl to BASE_URL; a mock exchange or a replayed journal can be put in its place.
+class ApiTransport {
+public:
+    virtual ~ApiTransport() = default;
+
+    // **Name of the transport for console output**
+    virtual const char* name() const = 0;
+
+    // **Send a request and wait for its response, returns false if it cannot be sent, which is not retried**
+    virtual bool send(const std::string& endpoint, const std::string& method, const std::string& body,
+        ApiResponse& response) = 0;
+
+    // **Send requests concurrently, returns false without sending any if the batch cannot be sent**
+    // The default sends them one after another.
+    virtual bool sendBatch(const std::vector<ApiRequest>& requests, std::vector<ApiResponse>& responses);
+
+    // **True if requests take real time: they are rate limited, retries wait and their latency is recorded**
+    virtual bool realTime() const { return true; }
+};
+
+// **True if a transport error happened before the request could reach the exchange, so sending it again is safe**
+// Transport errors are libcurl codes, -1 when a transport could not send the request at all.
+bool failedBeforeSending(int transportError);
+
+// **Send apiRequest through a transport, or through libcurl to BASE_URL again with null**
+void setApiTransport(ApiTransport* transport);
+
+// **Transport apiRequest sends through**
+ApiTransport& apiTransport();
+
+// **True while apiRequest goes to BASE_URL over libcurl, the exchange the order connection and the feed reach**
+bool usingExchangeTransport();
+
+// **Send a batch of requests concurrently, responses are returned in request order**
+// Requests that fail are retried with the others, so an entry is only empty when its retries give up or its
+// deadline passes.
+std::vector<json> apiRequestBatch(const std::vector<ApiRequest>& requests);
+
+// **Send a batch of requests concurrently, handing each response body to the parser of its request**
+// An entry of the result is false when no response of that request could be parsed.
+std::vector<bool> apiRequestBatchParsed(const std::vector<ApiRequest>& requests,
+    const std::vector<ResponseParser>& parsers);
+
+// **Send a batch of requests in the background, handing each response body to the parser of its request**
+// Returns at once. The parsers run on a background thread whose retries of all batches wait on one timer wheel,
+// so pending retries hold up neither the caller nor the other batches. Once every request is parsed or given up on,
+// onDone is called on that thread and the result then holds the parse results, so an owner that waits for the result
+// before it is destroyed outlives onDone. Through a transport without real time, such as a replayed journal, the
+// batch is sent before returning.
+std::future<std::vector<bool>> apiRequestBatchAsync(const std::vector<ApiRequest>& requests,
+    const std::vector<ResponseParser>& parsers, std::function<void()> onDone = nullptr);
 
 #endif // !API_HANDLING_H
@@ -0,0 +1,353 @@
+#include "ApiJournal.h"
+#include "config.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include <zlib.h>
+
+using namespace std;
+
+static const char kJournalMagic[8] = { 'C', 'B', 'J', 'O', 'U', 'R', 'N', 'L' };
+
+static atomic<JournalReplay*> g_apiReplay{ nullptr };
+
+// **True if the header belongs to a journal of this format**
+static bool isValidHeader(const JournalHeader& header) {
+    return memcmp(header.magic, kJournalMagic, sizeof(kJournalMagic)) == 0
+        && header.version == kJournalVersion && header.recordSize == sizeof(JournalRecord);
+}
+
+JournalWriter::~JournalWriter() {
+    if (!writer.joinable()) return;
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        stopping = true;
+    }
+    wakeUp.notify_one();
+    writer.join();
+}
+
+// **Open or create a journal and start the writer, returns false on an I/O error or a foreign file**
+// A block torn by a crash is dropped before appending.
+bool JournalWriter::open(const string& filename) {
+    error_code ec;
+    uintmax_t fileSize = filesystem::exists(filename, ec) ? filesystem::file_size(filename, ec) : 0;
+    if (ec) {
+        cerr << "Failed to read the size of " << filename << ": " << ec.message() << endl;
+        return false;
+    }
+    if (fileSize < sizeof(JournalHeader)) {
+        JournalHeader header = {};
+        memcpy(header.magic, kJournalMagic, sizeof(kJournalMagic));
+        header.version = kJournalVersion;
+        header.recordSize = sizeof(JournalRecord);
+        ofstream created(filename, ios::binary | ios::trunc);
+        created.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!created) {
+            cerr << "Failed to create " << filename << endl;
+            return false;
+        }
+    }
+    else {
+        ifstream existing(filename, ios::binary);
+        JournalHeader header;
+        existing.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!existing || !isValidHeader(header)) {
+            cerr << filename << " is not an API journal of version " << kJournalVersion << endl;
+            return false;
+        }
+        // Walk the block headers, a block that does not fit in the file was torn by a crash
+        uintmax_t intactSize = sizeof(JournalHeader);
+        JournalBlockHeader block;
+        while (intactSize + sizeof(block) <= fileSize) {
+            existing.seekg(static_cast<streamoff>(intactSize));
+            existing.read(reinterpret_cast<char*>(&block), sizeof(block));
+            if (!existing || intactSize + sizeof(block) + block.compressedSize > fileSize) break;
+            intactSize += sizeof(block) + block.compressedSize;
+        }
+        existing.close();
+        if (intactSize != fileSize) {
+            filesystem::resize_file(filename, intactSize, ec);
+            if (ec) {
+                cerr << "Failed to drop the torn block of " << filename << ": " << ec.message() << endl;
+                return false;
+            }
+        }
+    }
+    file.open(filename, ios::binary | ios::app);
+    if (!file.is_open()) return false;
+    writer = thread(&JournalWriter::run, this);
+    return true;
+}
+
+// **Queue an entry**
+void JournalWriter::append(const JournalEntry& entry) {
+    JournalRecord record = {};
+    record.timeMs = entry.timeMs;
+    record.rateLimitRemaining = entry.rateLimitRemaining;
+    record.rateLimitResetAt = entry.rateLimitResetAt;
+    record.durationMicros = static_cast<uint32_t>(min<long long>(max<long long>(entry.durationMicros, 0), UINT32_MAX));
+    record.httpCode = static_cast<int32_t>(entry.httpCode);
+    record.transportError = entry.transportError;
+    record.kind = static_cast<uint16_t>(entry.kind);
+    record.methodLength = static_cast<uint16_t>(entry.method.size());
+    record.endpointLength = static_cast<uint32_t>(entry.endpoint.size());
+    record.requestLength = static_cast<uint32_t>(entry.requestBody.size());
+    record.bodyLength = static_cast<uint32_t>(entry.body.size());
+    bool full;
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        if (pendingEntries == 0) firstTimeMs = entry.timeMs;
+        lastTimeMs = max<int64_t>(lastTimeMs, entry.timeMs);
+        pending.append(reinterpret_cast<const char*>(&record), sizeof(record));
+        pending.append(entry.method).append(entry.endpoint).append(entry.requestBody).append(entry.body);
+        pendingEntries++;
+        full = pending.size() >= kBlockBytes;
+    }
+    if (full) wakeUp.notify_one();
+}
+
+// **Write everything queued so far**
+void JournalWriter::flush() {
+    writeBlock();
+}
+
+// **Compress and write the queued entries, writer thread or flush only**
+void JournalWriter::writeBlock() {
+    lock_guard<mutex> fileLock(fileMutex);
+    string raw;
+    JournalBlockHeader header = {};
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        if (pendingEntries == 0) return;
+        raw.swap(pending);
+        header.entries = pendingEntries;
+        header.firstTimeMs = firstTimeMs;
+        header.lastTimeMs = lastTimeMs;
+        pendingEntries = 0;
+        lastTimeMs = 0;
+    }
+    uLongf compressedSize = compressBound(static_cast<uLong>(raw.size()));
+    vector<Bytef> compressed(compressedSize);
+    if (compress2(compressed.data(), &compressedSize, reinterpret_cast<const Bytef*>(raw.data()),
+        static_cast<uLong>(raw.size()), Z_BEST_SPEED) != Z_OK) {
+        cerr << "Failed to compress " << header.entries << " journal entries, they are not written" << endl;
+        return;
+    }
+    header.compressedSize = static_cast<uint32_t>(compressedSize);
+    header.rawSize = static_cast<uint32_t>(raw.size());
+    header.checksum = static_cast<uint32_t>(crc32(0L, compressed.data(), static_cast<uInt>(compressedSize)));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(compressed.data()), static_cast<streamsize>(compressedSize));
+    file.flush();
+    if (!file) cerr << "Failed to write " << header.entries << " journal entries" << endl;
+}
+
+void JournalWriter::run() {
+    while (true) {
+        bool stop;
+        {
+            unique_lock<mutex> lock(pendingMutex);
+            wakeUp.wait_for(lock, chrono::milliseconds(kFlushMillis),
+                [this] { return stopping || pending.size() >= kBlockBytes; });
+            stop = stopping;
+        }
+        writeBlock();
+        if (stop) return;
+    }
+}
+
+// **Journal the API traffic of this process is captured to, null unless API_JOURNAL is set in .env**
+// A replayed session is not captured again.
+JournalWriter* apiCapture() {
+    if (apiReplay()) return nullptr;
+    static JournalWriter* journal = []() -> JournalWriter* {
+        if (API_JOURNAL.empty()) return nullptr;
+        static JournalWriter writer;
+        if (!writer.open(API_JOURNAL)) return nullptr;
+        cout << "Capturing API traffic to " << API_JOURNAL << endl;
+        return &writer;
+    }();
+    return journal;
+}
+
+// **Open a journal, returns false if it is missing or not a journal of this version**
+bool JournalReader::open(const string& filename) {
+    name = filename;
+    file.open(filename, ios::binary);
+    if (!file.is_open()) return false;
+    JournalHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || !isValidHeader(header)) {
+        cerr << filename << " is not an API journal of version " << kJournalVersion << endl;
+        file.close();
+        return false;
+    }
+    block.clear();
+    offset = 0;
+    return true;
+}
+
+// **Read and decompress the next block, returns false at the end**
+bool JournalReader::readBlock() {
+    JournalBlockHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (file.gcount() == 0) return false;
+    string compressed(file.gcount() == sizeof(header) ? header.compressedSize : 0, '\0');
+    file.read(&compressed[0], static_cast<streamsize>(compressed.size()));
+    if (!file) {
+        cerr << name << " ends in a torn block, replaying the entries before it" << endl;
+        return false;
+    }
+    uLongf rawSize = header.rawSize;
+    block.resize(header.rawSize);
+    const Bytef* data = reinterpret_cast<const Bytef*>(compressed.data());
+    const uLong compressedSize = static_cast<uLong>(compressed.size());
+    if (static_cast<uint32_t>(crc32(0L, data, static_cast<uInt>(compressedSize))) != header.checksum
+        || uncompress(reinterpret_cast<Bytef*>(&block[0]), &rawSize, data, compressedSize) != Z_OK
+        || rawSize != header.rawSize) {
+        cerr << name << " has a corrupt block, replaying the entries before it" << endl;
+        return false;
+    }
+    offset = 0;
+    return true;
+}
+
+// **Read the next entry, returns false at the end or at a torn or corrupt block**
+bool JournalReader::next(JournalEntry& entry) {
+    while (offset >= block.size()) {
+        if (!file.is_open() || !readBlock()) return false;
+    }
+    JournalRecord record;
+    if (offset + sizeof(record) > block.size()) return false;
+    memcpy(&record, block.data() + offset, sizeof(record));
+    offset += sizeof(record);
+    const size_t lengths = static_cast<size_t>(record.methodLength) + record.endpointLength + record.requestLength
+        + record.bodyLength;
+    if (offset + lengths > block.size()) {
+        cerr << name << " has a corrupt entry, replaying the entries before it" << endl;
+        block.clear();
+        file.close();
+        return false;
+    }
+    entry.kind = static_cast<JournalKind>(record.kind);
+    entry.timeMs = record.timeMs;
+    entry.durationMicros = record.durationMicros;
+    entry.transportError = record.transportError;
+    entry.httpCode = record.httpCode;
+    entry.rateLimitRemaining = record.rateLimitRemaining;
+    entry.rateLimitResetAt = record.rateLimitResetAt;
+    const char* data = block.data() + offset;
+    entry.method.assign(data, record.methodLength);
+    data += record.methodLength;
+    entry.endpoint.assign(data, record.endpointLength);
+    data += record.endpointLength;
+    entry.requestBody.assign(data, record.requestLength);
+    data += record.requestLength;
+    entry.body.assign(data, record.bodyLength);
+    offset += lengths;
+    return true;
+}
+
+// **Open a journal, returns false if it cannot be read**
+bool JournalReplay::open(const string& filename) {
+    if (!reader.open(filename)) return false;
+    window.clear();
+    walked = 0;
+    ended = false;
+    Slot first;
+    if (!reader.next(first.entry)) {
+        ended = true;
+        return true;
+    }
+    walkTimeMs = first.entry.timeMs;
+    window.push_back(move(first));
+    return true;
+}
+
+// **Read entries into the window up to timeMs, returns false if the journal ended first**
+bool JournalReplay::readUntil(long long timeMs) {
+    while (!ended && (window.empty() || window.back().entry.timeMs <= timeMs)) {
+        Slot slot;
+        if (!reader.next(slot.entry)) {
+            ended = true;
+            break;
+        }
+        window.push_back(move(slot));
+    }
+    return !ended;
+}
+
+// **Next entry in journal order that no request took, returns false at the end**
+bool JournalReplay::next(JournalEntry& entry) {
+    lock_guard<mutex> lock(replayMutex);
+    while (true) {
+        if (walked == window.size()) {
+            Slot slot;
+            if (ended || !reader.next(slot.entry)) {
+                ended = true;
+                return false;
+            }
+            window.push_back(move(slot));
+        }
+        Slot& slot = window[walked++];
+        walkTimeMs = slot.entry.timeMs;
+        const bool taken = slot.taken;
+        if (!taken) entry = slot.entry;
+        // Walked entries stay takeable for a lookahead, a request can come after the entry that was captured first
+        while (walked > 0 && (window.front().taken || window.front().entry.timeMs < walkTimeMs - kLookaheadMillis)) {
+            window.pop_front();
+            walked--;
+        }
+        if (!taken) return true;
+    }
+}
+
+// **Take the recorded transfer of a request, returns false if the journal has none**
+bool JournalReplay::take(const string& method, const string& endpoint, JournalEntry& entry) {
+    lock_guard<mutex> lock(replayMutex);
+    readUntil(walkTimeMs + kLookaheadMillis);
+    for (Slot& slot : window) {
+        if (slot.taken || slot.entry.kind != JournalKind::Rest || slot.entry.method != method
+            || slot.entry.endpoint != endpoint) continue;
+        slot.taken = true;
+        entry = slot.entry;
+        servedCount++;
+        return true;
+    }
+    missedCount++;
+    return false;
+}
+
+// **Serve a request with its recorded transfer, returns false if the journal has none**
+bool JournalReplay::send(const string& endpoint, const string& method, const string&, ApiResponse& response) {
+    JournalEntry entry;
+    if (!take(method, endpoint, entry)) {
+        cerr << "The journal has no response left for " << method << " " << endpoint << endl;
+        return false;
+    }
+    response.error = entry.transportError;
+    response.errorText = "Transfer failed in the captured session";
+    response.httpCode = entry.httpCode;
+    response.body.swap(entry.body);
+    response.rateLimitRemaining = entry.rateLimitRemaining;
+    response.rateLimitResetAt = entry.rateLimitResetAt;
+    response.durationMicros = entry.durationMicros;
+    response.newConnections = 0;
+    return true;
+}
+
+// **Serve apiRequest from a journal, or from the network again with null, making it the transport of apiRequest**
+void setApiReplay(JournalReplay* replay) {
+    g_apiReplay = replay;
+    setApiTransport(replay);
+}
+
+// **Journal apiRequest is served from, null when it goes to the network**
+JournalReplay* apiReplay() {
+    return g_apiReplay.load(memory_order_relaxed);
+}
@@ -0,0 +1,190 @@
+#ifndef APIJOURNAL_H
+#define APIJOURNAL_H
+
+#include "API_Handling.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// **Kind of a journal entry**
+enum class JournalKind : uint16_t { Rest, WebSocket };
+
+// **One REST transfer or received websocket message of a captured session**
+struct JournalEntry {
+    JournalKind kind = JournalKind::Rest;
+    long long timeMs = 0;               // Wall time the request was sent or the message received
+    long long durationMicros = 0;       // Rest: transfer time
+    int transportError = 0;             // Rest: CURLcode of a transfer that got no response, 0 otherwise
+    long httpCode = 0;                  // Rest: HTTP status, 0 without a response
+    long long rateLimitRemaining = -1;  // Rest: bitvavo-ratelimit-remaining header, -1 if absent
+    long long rateLimitResetAt = -1;    // Rest: bitvavo-ratelimit-resetat header, -1 if absent
+    std::string method;                 // Rest: GET or POST
+    std::string endpoint;               // Rest: endpoint below BASE_URL
+    std::string requestBody;            // Rest: body of a POST
+    std::string body;                   // Response body, or the websocket message
+};
+
+// **Header at the start of every API journal, followed by compressed blocks of entries**
+struct JournalHeader {
+    char magic[8];          // "CBJOURNL"
+    uint32_t version;       // kJournalVersion
+    uint32_t recordSize;    // sizeof(JournalRecord)
+    int64_t reserved[2];
+};
+static_assert(sizeof(JournalHeader) == 32, "JournalHeader must be 32 bytes");
+
+// **Header of a block of entries, followed by compressedSize bytes of zlib data**
+struct JournalBlockHeader {
+    uint32_t compressedSize;
+    uint32_t rawSize;       // Size of the decompressed entries
+    uint32_t entries;
+    uint32_t checksum;      // CRC-32 of the compressed data
+    int64_t firstTimeMs;
+    int64_t lastTimeMs;
+};
+static_assert(sizeof(JournalBlockHeader) == 32, "JournalBlockHeader must be 32 bytes");
+
+// **Fixed part of an entry in a decompressed block, followed by its method, endpoint, request body and body**
+struct JournalRecord {
+    int64_t timeMs;
+    int64_t rateLimitRemaining;
+    int64_t rateLimitResetAt;
+    uint32_t durationMicros;
+    int32_t httpCode;
+    int32_t transportError;
+    uint16_t kind;
+    uint16_t methodLength;
+    uint32_t endpointLength;
+    uint32_t requestLength;
+    uint32_t bodyLength;
+    uint32_t reserved;
+};
+static_assert(sizeof(JournalRecord) == 56, "JournalRecord must be packed to 56 bytes");
+
+const uint32_t kJournalVersion = 1;
+
+// **Append-only journal of every REST transfer and websocket message, written by a background thread**
+// append only serializes the entry into a buffer. The writer compresses the buffer into a block once it holds
+// kBlockBytes or its oldest entry is kFlushMillis old, so a crash loses at most the last flush interval. The
+// signed request headers are not captured, a journal holds no credentials.
+class JournalWriter {
+public:
+    JournalWriter() = default;
+    ~JournalWriter();
+    JournalWriter(const JournalWriter&) = delete;
+    JournalWriter& operator=(const JournalWriter&) = delete;
+
+    // **Open or create a journal and start the writer, returns false on an I/O error or a foreign file**
+    // A block torn by a crash is dropped before appending.
+    bool open(const std::string& filename);
+
+    // **Queue an entry**
+    void append(const JournalEntry& entry);
+
+    // **Write everything queued so far**
+    void flush();
+
+private:
+    static const size_t kBlockBytes = 1 << 20;
+    static const long long kFlushMillis = 200;
+
+    // **Compress and write the queued entries, writer thread or flush only**
+    void writeBlock();
+    void run();
+
+    std::ofstream file;
+    std::mutex pendingMutex;
+    std::condition_variable wakeUp;
+    std::string pending;        // Serialized entries not written yet
+    uint32_t pendingEntries = 0;
+    int64_t firstTimeMs = 0;
+    int64_t lastTimeMs = 0;
+    std::mutex fileMutex;       // Held while a block is written
+    bool stopping = false;
+    std::thread writer;
+};
+
+// **Journal the API traffic of this process is captured to, null unless API_JOURNAL is set in .env**
+JournalWriter* apiCapture();
+
+// **Reads the entries of a journal in order**
+class JournalReader {
+public:
+    // **Open a journal, returns false if it is missing or not a journal of this version**
+    bool open(const std::string& filename);
+
+    // **Read the next entry, returns false at the end or at a torn or corrupt block**
+    bool next(JournalEntry& entry);
+
+private:
+    // **Read and decompress the next block, returns false at the end**
+    bool readBlock();
+
+    std::string name;
+    std::ifstream file;
+    std::string block;      // Decompressed entries of the current block
+    size_t offset = 0;
+};
+
+// **Serves apiRequest from a journal instead of the network, to re-run a captured session offline**
+// The session is walked in journal order with next. Requests take the first entry of the same method and endpoint
+// that no request took yet, among the entries up to kLookaheadMillis past the last one walked, so responses are
+// served in the order they were captured. As a transport it has no real time: nothing is rate limited or waited for.
+class JournalReplay : public ApiTransport {
+public:
+    const char* name() const override { return "journal"; }
+
+    // **Serve a request with its recorded transfer, returns false if the journal has none**
+    bool send(const std::string& endpoint, const std::string& method, const std::string& body,
+        ApiResponse& response) override;
+
+    bool realTime() const override { return false; }
+
+    // **Open a journal, returns false if it cannot be read**
+    bool open(const std::string& filename);
+
+    // **Next entry in journal order that no request took, returns false at the end**
+    bool next(JournalEntry& entry);
+
+    // **Take the recorded transfer of a request, returns false if the journal has none**
+    bool take(const std::string& method, const std::string& endpoint, JournalEntry& entry);
+
+    // **Time of the last entry walked, of the first entry before the walk starts**
+    long long timeMs() const { return walkTimeMs; }
+
+    // **Requests served from the journal, and requests it had no entry for**
+    size_t served() const { return servedCount; }
+    size_t missed() const { return missedCount; }
+
+private:
+    static const long long kLookaheadMillis = 120000;
+
+    struct Slot {
+        JournalEntry entry;
+        bool taken = false;
+    };
+
+    // **Read entries into the window up to timeMs, returns false if the journal ended first**
+    bool readUntil(long long timeMs);
+
+    std::mutex replayMutex;
+    JournalReader reader;
+    std::deque<Slot> window;   // Entries read ahead, from a lookahead before the walk position on
+    size_t walked = 0;         // Entries of the window already walked
+    long long walkTimeMs = 0;  // Time of the last entry walked
+    bool ended = false;
+    size_t servedCount = 0;
+    size_t missedCount = 0;
+};
+
+// **Serve apiRequest from a journal, or from the network again with null, making it the transport of apiRequest**
+void setApiReplay(JournalReplay* replay);
+
+// **Journal apiRequest is served from, null when it goes to the network**
+JournalReplay* apiReplay();
+
+#endif // !APIJOURNAL_H
@@ -0,0 +1,98 @@
+#include "Backtest.h"
+#include "CandleArchive.h"
+#include "TradingBot.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+// **Load the candle archives of every interval, returns false if 5m, 15m or 1h is missing**
+bool loadCandleArchives(const string& market, array<CandleHistory, kIntervalCount>& history) {
+    bool complete = true;
+    for (Interval interval : kAllIntervals) {
+        if (loadCandleHistory(market, interval, history[intervalIndex(interval)])) {
+            cout << "Loaded " << history[intervalIndex(interval)].size() << " " << intervalName(interval)
+                << " candles for " << market << endl;
+        }
+        else if (interval != Interval::M1) {
+            cerr << "No " << intervalName(interval) << " candles archived for " << market
+                << ", the signals need 5m, 15m and 1h candles." << endl;
+            complete = false;
+        }
+    }
+    return complete;
+}
+
+// **Interval whose candle closes drive the simulated clock: 1m if it is archived, otherwise 5m**
+Interval clockInterval(const array<CandleHistory, kIntervalCount>& history) {
+    return history[intervalIndex(Interval::M1)].empty() ? Interval::M5 : Interval::M1;
+}
+
+Backtester::Backtester(const string& selectedMarket, double maxPosition, const StrategyParameters& parameters)
+    : market(selectedMarket), maxPositionSize(maxPosition), strategy(parameters) {
+}
+
+// **Load the candle archives of every interval and the book recording if there is one**
+bool Backtester::load() {
+    if (!loadCandleArchives(market, history)) return false;
+    hasBook = bookReplay.open(bookRecordingName(market));
+    if (hasBook) cout << "Filling orders against the book recorded in " << bookRecordingName(market) << endl;
+    return true;
+}
+
+// **Replay the loaded candles, writing backtest_<market>_sim_trades.log and backtest_<market>_sim_log.txt**
+BacktestResult Backtester::run() {
+    BacktestResult result;
+    string logPrefix = "backtest_" + market + "_";
+    remove((logPrefix + "sim_trades.log").c_str());
+    remove((logPrefix + "sim_log.txt").c_str());
+    CryptoTradingBot bot(market, true, logPrefix);
+    bot.setRiskParameters(maxPositionSize);
+    bot.setStrategyParameters(strategy);
+    OrderBook book;
+    if (hasBook) bot.setReplayBook(&book);
+
+    // The finest archived interval drives the clock, the others are fed as their candles close
+    Interval driver = clockInterval(history);
+    const CandleHistory& clock = history[intervalIndex(driver)];
+    const long long driverMillis = intervalMillis(driver);
+    array<size_t, kIntervalCount> next = {};
+
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < clock.size(); i++) {
+        long long closeTime = clock.timestamp[i] + driverMillis;
+        for (Interval interval : kAllIntervals) {
+            if (interval == driver) continue;
+            const CandleHistory& candles = history[intervalIndex(interval)];
+            const long long millis = intervalMillis(interval);
+            size_t& n = next[intervalIndex(interval)];
+            for (; n < candles.size() && candles.timestamp[n] + millis <= closeTime; n++) {
+                bot.addCandle(interval, candles.timestamp[n], candles.open[n], candles.high[n],
+                    candles.low[n], candles.close[n], candles.volume[n]);
+                result.candles++;
+            }
+        }
+        bot.addCandle(driver, clock.timestamp[i], clock.open[i], clock.high[i],
+            clock.low[i], clock.close[i], clock.volume[i]);
+        result.candles++;
+        bot.setSimulatedClock(closeTime);
+        bot.onTickerPrice(clock.close[i]);
+
+        // An order reaches the book once its latency has passed, the recording is replayed up to that moment
+        long long orderDue = bot.simulatedOrderDue();
+        if (orderDue >= 0) {
+            bookReplay.advanceTo(orderDue, book);
+            bot.setSimulatedClock(orderDue);
+            bot.settleSimulatedOrder(bookReplay.covers(orderDue) ? &book : nullptr);
+        }
+    }
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.bookChanges = bookReplay.applied();
+
+    result.trades = bot.getTradeCount();
+    result.totalProfitLoss = bot.getTotalProfitLoss();
+    result.lastPrice = clock.empty() ? 0.0 : clock.close.back();
+    result.finalValue = bot.getSimulationValue(result.lastPrice);
+    return result;
+}
@@ -0,0 +1,54 @@
+#ifndef BACKTEST_H
+#define BACKTEST_H
+
+#include "CandleStore.h"
+#include "OrderBook.h"
+#include "Strategy.h"
+#include <array>
+#include <string>
+
+// **Outcome of a backtest run**
+struct BacktestResult {
+    size_t candles = 0;          // Candles replayed over all intervals
+    size_t trades = 0;           // Trades logged
+    double totalProfitLoss = 0.0;
+    double finalValue = 0.0;     // Simulated fiat plus crypto at the last price
+    double lastPrice = 0.0;
+    double seconds = 0.0;        // Wall time of the replay, excluding loading
+    size_t bookChanges = 0;      // Book changes replayed, 0 without a book recording
+};
+
+// **Load the candle archives of every interval, returns false if 5m, 15m or 1h is missing**
+// Reads <market>_<interval>_candles.bin, or the CSV of an interval that has not been imported yet.
+bool loadCandleArchives(const std::string& market, std::array<CandleHistory, kIntervalCount>& history);
+
+// **Interval whose candle closes drive the simulated clock: 1m if it is archived, otherwise 5m**
+Interval clockInterval(const std::array<CandleHistory, kIntervalCount>& history);
+
+// **Replays the candle archives of a market through the bot's indicator and signal code**
+// Candles are fed in time order, each one once it has closed, and the signals are evaluated at the close
+// of every candle of the finest interval archived. Orders fill at that close on the simulated clock, unless the
+// market has a book recording: then they go through the fill simulator, reaching the book as replayed up to
+// SIM_LATENCY_MS after the close and paying the taker fee, and fill at the close plus fee outside the recording.
+class Backtester {
+public:
+    Backtester(const std::string& market, double maxPositionSize,
+        const StrategyParameters& strategy = StrategyParameters());
+
+    // **Load the candle archives of every interval and the book recording if there is one**
+    // Returns false if 5m, 15m or 1h is missing.
+    bool load();
+
+    // **Replay the loaded candles, writing backtest_<market>_sim_trades.log and backtest_<market>_sim_log.txt**
+    BacktestResult run();
+
+private:
+    std::string market;
+    double maxPositionSize;
+    StrategyParameters strategy;
+    std::array<CandleHistory, kIntervalCount> history; // Index: interval, Value: archived candles
+    BookReplay bookReplay;                             // Book recording of the market, if it has one
+    bool hasBook = false;
+};
+
+#endif // !BACKTEST_H
@@ -0,0 +1,74 @@
+#include "Balances.h"
+
+using namespace std;
+
+BalanceSnapshot::BalanceSnapshot(chrono::seconds maxAgeSeconds) : maxAge(maxAgeSeconds) {
+}
+
+// **Fetch the balances from the exchange, returns false if the request failed**
+bool BalanceSnapshot::refresh() {
+    uint64_t requestGeneration = generation();
+    vector<AssetBalance> response;
+    ParseStatus status = ParseStatus::Malformed;
+    bool received = apiRequestParsed("balance", [&](const char* data, size_t size) {
+        status = parseBalanceResponse(data, size, response);
+        return status != ParseStatus::Malformed;
+    });
+    if (!received || status != ParseStatus::Ok) return false;
+    update(response, requestGeneration);
+    return true;
+}
+
+// **Fetch the balances only if the snapshot is stale, returns false if a needed request failed**
+bool BalanceSnapshot::refreshIfStale() {
+    if (!isStale()) return true;
+    // A caller that waited here while another refreshed finds the snapshot fresh, unless it was invalidated again
+    lock_guard<mutex> lock(refreshMutex);
+    if (!isStale()) return true;
+    return refresh();
+}
+
+// **True if the snapshot is empty, invalidated or older than the maximum age**
+bool BalanceSnapshot::isStale() const {
+    uint64_t current = invalidations.load();
+    lock_guard<mutex> lock(snapshotMutex);
+    return !loaded || validGeneration < current || chrono::steady_clock::now() - updatedAt >= maxAge;
+}
+
+// **Mark the snapshot stale after one of our own orders filled**
+void BalanceSnapshot::invalidate() {
+    invalidations++;
+}
+
+// **Invalidation count, pass it to update for a response requested after reading it**
+uint64_t BalanceSnapshot::generation() const {
+    return invalidations.load();
+}
+
+// **Replace the snapshot with a balance response requested at a generation**
+// The snapshot only counts as fresh for the fills that happened before the request.
+void BalanceSnapshot::update(const vector<AssetBalance>& response, uint64_t requestGeneration) {
+    unordered_map<string, double> parsed;
+    parsed.reserve(response.size());
+    for (const AssetBalance& balance : response) {
+        parsed[balance.symbol] = balance.available;
+    }
+    fetches++;
+    lock_guard<mutex> lock(snapshotMutex);
+    availableBySymbol.swap(parsed);
+    updatedAt = chrono::steady_clock::now();
+    validGeneration = requestGeneration;
+    loaded = true;
+}
+
+// **Available amount of an asset, 0 if unknown**
+double BalanceSnapshot::available(const string& symbol) const {
+    lock_guard<mutex> lock(snapshotMutex);
+    auto it = availableBySymbol.find(symbol);
+    return it != availableBySymbol.end() ? it->second : 0.0;
+}
+
+// **Balance responses applied since the snapshot was created**
+long long BalanceSnapshot::fetchCount() const {
+    return fetches;
+}
@@ -0,0 +1,60 @@
+#ifndef BALANCES_H
+#define BALANCES_H
+
+#include "API_Handling.h"
+#include "ResponseParsers.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Refetch balances at least this often, to pick up deposits, withdrawals and trades made outside the bot
+const long long kBalanceMaxAgeSeconds = 300;
+
+// **Available balances per asset, fetched once and read by every accessor and market**
+// Balances only change through fills, so the snapshot is kept until one of our own orders invalidates it or it
+// is older than the maximum age. Concurrent refreshes of a stale snapshot share a single balance request.
+class BalanceSnapshot {
+public:
+    explicit BalanceSnapshot(std::chrono::seconds maxAge = std::chrono::seconds(kBalanceMaxAgeSeconds));
+
+    // **Fetch the balances from the exchange, returns false if the request failed**
+    bool refresh();
+
+    // **Fetch the balances only if the snapshot is stale, returns false if a needed request failed**
+    bool refreshIfStale();
+
+    // **True if the snapshot is empty, invalidated or older than the maximum age**
+    bool isStale() const;
+
+    // **Mark the snapshot stale after one of our own orders filled**
+    void invalidate();
+
+    // **Invalidation count, pass it to update for a response requested after reading it**
+    uint64_t generation() const;
+
+    // **Replace the snapshot with a balance response requested at a generation**
+    void update(const std::vector<AssetBalance>& response, uint64_t requestGeneration);
+
+    // **Available amount of an asset, 0 if unknown**
+    double available(const std::string& symbol) const;
+
+    // **Balance responses applied since the snapshot was created**
+    long long fetchCount() const;
+
+private:
+    std::chrono::seconds maxAge;
+    mutable std::mutex snapshotMutex;
+    std::unordered_map<std::string, double> availableBySymbol;
+    std::chrono::steady_clock::time_point updatedAt; // Guarded by snapshotMutex
+    uint64_t validGeneration = 0;                    // Guarded by snapshotMutex
+    bool loaded = false;                             // Guarded by snapshotMutex
+    std::atomic<uint64_t> invalidations{ 1 };
+    std::atomic<long long> fetches{ 0 };
+    std::mutex refreshMutex;                         // Held while a refresh request is in flight
+};
+
+#endif // !BALANCES_H
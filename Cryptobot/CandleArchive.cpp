@@ -0,0 +1,233 @@
+#include "CandleArchive.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const char kCandleArchiveMagic[8] = { 'C', 'B', 'C', 'A', 'N', 'D', 'L', 'E' };
+
+// **True if the header belongs to an archive of this format and interval (any interval if intervalMillis is 0)**
+static bool isValidHeader(const CandleArchiveHeader& header, long long intervalMillis) {
+    return memcmp(header.magic, kCandleArchiveMagic, sizeof(kCandleArchiveMagic)) == 0
+        && header.version == kCandleArchiveVersion && header.recordSize == sizeof(CandleRecord)
+        && (intervalMillis == 0 || header.intervalMillis == intervalMillis);
+}
+
+// **Archive file name of a market and interval: <market>_<interval>_candles.bin**
+string candleArchiveName(const string& market, Interval interval) {
+    return market + "_" + intervalName(interval) + "_candles.bin";
+}
+
+CandleArchive::~CandleArchive() {
+    close();
+}
+
+// **Map an archive file, returns false if it is missing or not a valid archive**
+bool CandleArchive::open(const string& filename) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(CandleArchiveHeader))) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        cerr << "Failed to map " << filename << endl;
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int file = ::open(filename.c_str(), O_RDONLY);
+    if (file < 0) return false;
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(CandleArchiveHeader))) {
+        ::close(file);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, file, 0);
+    if (view == MAP_FAILED) {
+        ::close(file);
+        cerr << "Failed to map " << filename << endl;
+        return false;
+    }
+    fd = file;
+    mappedSize = static_cast<size_t>(info.st_size);
+#endif
+    mapped = static_cast<const char*>(view);
+
+    const CandleArchiveHeader* header = reinterpret_cast<const CandleArchiveHeader*>(mapped);
+    if (!isValidHeader(*header, 0)) {
+        cerr << filename << " is not a candle archive of version " << kCandleArchiveVersion << endl;
+        close();
+        return false;
+    }
+    interval = header->intervalMillis;
+    records = reinterpret_cast<const CandleRecord*>(mapped + sizeof(CandleArchiveHeader));
+    // A record torn by a crash during an append is ignored
+    count = (mappedSize - sizeof(CandleArchiveHeader)) / sizeof(CandleRecord);
+    return true;
+}
+
+void CandleArchive::close() {
+    if (!mapped) return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapped);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = fileHandle = nullptr;
+#else
+    munmap(const_cast<char*>(mapped), mappedSize);
+    ::close(fd);
+    fd = -1;
+#endif
+    mapped = nullptr;
+    mappedSize = 0;
+    records = nullptr;
+    count = 0;
+    interval = 0;
+}
+
+// **First record with a timestamp at or after the given one**
+const CandleRecord* CandleArchive::lowerBound(long long timestamp) const {
+    return lower_bound(begin(), end(), timestamp,
+        [](const CandleRecord& record, long long ts) { return record.timestamp < ts; });
+}
+
+// **Records with from <= timestamp < to**
+pair<const CandleRecord*, const CandleRecord*> CandleArchive::range(long long from, long long to) const {
+    const CandleRecord* first = lowerBound(from);
+    const CandleRecord* last = to > from ? lowerBound(to) : first;
+    return { first, last };
+}
+
+// **Append the records newer than the last archived candle, creating the archive if needed**
+// A record torn by a crash during an earlier append is dropped first. Returns false on an I/O error.
+bool appendToCandleArchive(const string& filename, Interval interval, const vector<CandleRecord>& candles,
+    size_t& appended) {
+    appended = 0;
+    error_code ec;
+    uintmax_t fileSize = filesystem::exists(filename, ec) ? filesystem::file_size(filename, ec) : 0;
+    if (ec) {
+        cerr << "Failed to read the size of " << filename << ": " << ec.message() << endl;
+        return false;
+    }
+
+    long long lastArchived = 0;
+    if (fileSize < sizeof(CandleArchiveHeader)) {
+        CandleArchiveHeader header = {};
+        memcpy(header.magic, kCandleArchiveMagic, sizeof(kCandleArchiveMagic));
+        header.version = kCandleArchiveVersion;
+        header.recordSize = sizeof(CandleRecord);
+        header.intervalMillis = intervalMillis(interval);
+        ofstream file(filename, ios::binary | ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!file) {
+            cerr << "Failed to create " << filename << endl;
+            return false;
+        }
+    }
+    else {
+        ifstream file(filename, ios::binary);
+        CandleArchiveHeader header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!file || !isValidHeader(header, intervalMillis(interval))) {
+            cerr << filename << " is not a " << intervalName(interval) << " candle archive of version "
+                << kCandleArchiveVersion << endl;
+            return false;
+        }
+        uintmax_t recordCount = (fileSize - sizeof(CandleArchiveHeader)) / sizeof(CandleRecord);
+        uintmax_t intactSize = sizeof(CandleArchiveHeader) + recordCount * sizeof(CandleRecord);
+        if (recordCount > 0) {
+            CandleRecord last;
+            file.seekg(static_cast<streamoff>(intactSize - sizeof(CandleRecord)));
+            file.read(reinterpret_cast<char*>(&last), sizeof(last));
+            lastArchived = last.timestamp;
+        }
+        file.close();
+        if (intactSize != fileSize) {
+            filesystem::resize_file(filename, intactSize, ec);
+            if (ec) {
+                cerr << "Failed to drop the torn record of " << filename << ": " << ec.message() << endl;
+                return false;
+            }
+        }
+    }
+
+    ofstream file(filename, ios::binary | ios::app);
+    for (const CandleRecord& candle : candles) {
+        if (candle.timestamp <= lastArchived) continue;
+        file.write(reinterpret_cast<const char*>(&candle), sizeof(candle));
+        lastArchived = candle.timestamp;
+        appended++;
+    }
+    file.flush();
+    if (!file) {
+        cerr << "Failed to append candles to " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+// **Load a market's candles of an interval from its archive, or from the CSV if there is no archive yet**
+bool loadCandleHistory(const string& market, Interval interval, CandleHistory& history) {
+    CandleArchive archive;
+    if (!archive.open(candleArchiveName(market, interval))) {
+        return loadCandlesCSV(market + "_" + intervalName(interval) + "_candles.csv", history);
+    }
+    history.clear();
+    history.timestamp.reserve(archive.size());
+    history.open.reserve(archive.size());
+    history.high.reserve(archive.size());
+    history.low.reserve(archive.size());
+    history.close.reserve(archive.size());
+    history.volume.reserve(archive.size());
+    for (const CandleRecord& record : archive) {
+        history.timestamp.push_back(record.timestamp);
+        history.open.push_back(record.open);
+        history.high.push_back(record.high);
+        history.low.push_back(record.low);
+        history.close.push_back(record.close);
+        history.volume.push_back(record.volume);
+    }
+    return !history.empty();
+}
+
+// **Import <market>_<interval>_candles.csv into the binary archive, skipping candles that are already archived**
+bool importCandleCSV(const string& market, Interval interval) {
+    string csvFile = market + "_" + intervalName(interval) + "_candles.csv";
+    CandleHistory history;
+    if (!loadCandlesCSV(csvFile, history)) return false;
+    vector<CandleRecord> records(history.size());
+    for (size_t i = 0; i < history.size(); i++) {
+        records[i] = { history.timestamp[i], history.open[i], history.high[i],
+            history.low[i], history.close[i], history.volume[i] };
+    }
+    size_t appended = 0;
+    string archiveFile = candleArchiveName(market, interval);
+    if (!appendToCandleArchive(archiveFile, interval, records, appended)) return false;
+    cout << "Imported " << appended << " of " << records.size() << " candles from " << csvFile
+        << " into " << archiveFile << endl;
+    return true;
+}
@@ -0,0 +1,88 @@
+#ifndef CANDLEARCHIVE_H
+#define CANDLEARCHIVE_H
+
+#include "CandleStore.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// **One archived candle, stored as a fixed 48 byte record**
+struct CandleRecord {
+    int64_t timestamp; // Candle open time in milliseconds
+    double open;
+    double high;
+    double low;
+    double close;
+    double volume;
+};
+static_assert(sizeof(CandleRecord) == 48, "CandleRecord must be packed to 48 bytes");
+
+// **Header at the start of every archive file, followed by the records in timestamp order**
+struct CandleArchiveHeader {
+    char magic[8];          // "CBCANDLE"
+    uint32_t version;       // kCandleArchiveVersion
+    uint32_t recordSize;    // sizeof(CandleRecord)
+    int64_t intervalMillis; // Interval of the candles
+    int64_t reserved;
+};
+static_assert(sizeof(CandleArchiveHeader) == 32, "CandleArchiveHeader must be 32 bytes");
+
+const uint32_t kCandleArchiveVersion = 1;
+
+// **Archive file name of a market and interval: <market>_<interval>_candles.bin**
+std::string candleArchiveName(const std::string& market, Interval interval);
+
+// **Read-only memory-mapped view of a candle archive**
+// Records are read in place from the mapping, ranges by timestamp are found by binary search.
+class CandleArchive {
+public:
+    CandleArchive() = default;
+    ~CandleArchive();
+    CandleArchive(const CandleArchive&) = delete;
+    CandleArchive& operator=(const CandleArchive&) = delete;
+
+    // **Map an archive file, returns false if it is missing or not a valid archive**
+    bool open(const std::string& filename);
+    void close();
+
+    bool isOpen() const { return mapped != nullptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    long long intervalMillis() const { return interval; }
+    const CandleRecord* begin() const { return records; }
+    const CandleRecord* end() const { return records + count; }
+    const CandleRecord& operator[](size_t i) const { return records[i]; }
+
+    // **First record with a timestamp at or after the given one**
+    const CandleRecord* lowerBound(long long timestamp) const;
+
+    // **Records with from <= timestamp < to**
+    std::pair<const CandleRecord*, const CandleRecord*> range(long long from, long long to) const;
+
+private:
+    const char* mapped = nullptr;
+    size_t mappedSize = 0;
+    const CandleRecord* records = nullptr;
+    size_t count = 0;
+    long long interval = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+// **Append the records newer than the last archived candle, creating the archive if needed**
+// A record torn by a crash during an earlier append is dropped first. Returns false on an I/O error.
+bool appendToCandleArchive(const std::string& filename, Interval interval, const std::vector<CandleRecord>& candles,
+    size_t& appended);
+
+// **Load a market's candles of an interval from its archive, or from the CSV if there is no archive yet**
+bool loadCandleHistory(const std::string& market, Interval interval, CandleHistory& history);
+
+// **Import <market>_<interval>_candles.csv into the binary archive, skipping candles that are already archived**
+bool importCandleCSV(const std::string& market, Interval interval);
+
+#endif // !CANDLEARCHIVE_H
@@ -0,0 +1,163 @@
+#include "CandleStore.h"
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+using namespace std;
+
+// **Interval name as used by the Bitvavo API ("1m", "5m", "15m", "1h")**
+const char* intervalName(Interval interval) {
+    switch (interval) {
+    case Interval::M1: return "1m";
+    case Interval::M5: return "5m";
+    case Interval::M15: return "15m";
+    case Interval::H1: return "1h";
+    }
+    return "";
+}
+
+// **Interval from its API name, returns false for an unknown name**
+bool parseInterval(const string& name, Interval& interval) {
+    for (Interval candidate : kAllIntervals) {
+        if (name == intervalName(candidate)) {
+            interval = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// **Length of an interval in milliseconds**
+long long intervalMillis(Interval interval) {
+    switch (interval) {
+    case Interval::M1: return 60 * 1000LL;
+    case Interval::M5: return 5 * 60 * 1000LL;
+    case Interval::M15: return 15 * 60 * 1000LL;
+    case Interval::H1: return 60 * 60 * 1000LL;
+    }
+    return 0;
+}
+
+// **Set the number of candles retained, dropping the current contents**
+void CandleSeries::setCapacity(size_t capacity) {
+    timestamp.setCapacity(capacity);
+    open.setCapacity(capacity);
+    high.setCapacity(capacity);
+    low.setCapacity(capacity);
+    close.setCapacity(capacity);
+    volume.setCapacity(capacity);
+    appendedCount = 0;
+    revisionCount = 0;
+}
+
+// **Append a candle, returns false if it is not newer than the last stored candle**
+bool CandleSeries::append(long long ts, double o, double h, double l, double c, double v) {
+    if (!timestamp.empty() && ts <= timestamp.back()) return false;
+    timestamp.push_back(ts);
+    open.push_back(o);
+    high.push_back(h);
+    low.push_back(l);
+    close.push_back(c);
+    volume.push_back(v);
+    appendedCount++;
+    return true;
+}
+
+// **Replace the last candle, returns false if it does not have the same open time**
+// The exchange keeps updating the newest candle until its interval has passed.
+bool CandleSeries::replaceLast(long long ts, double o, double h, double l, double c, double v) {
+    if (timestamp.empty() || ts != timestamp.back()) return false;
+    if (open.back() == o && high.back() == h && low.back() == l && close.back() == c && volume.back() == v) return true;
+    open.back() = o;
+    high.back() = h;
+    low.back() = l;
+    close.back() = c;
+    volume.back() = v;
+    revisionCount++;
+    return true;
+}
+
+void CandleHistory::clear() {
+    timestamp.clear();
+    open.clear();
+    high.clear();
+    low.clear();
+    close.clear();
+    volume.clear();
+}
+
+// **Load a timestamp,open,high,low,close,volume candle CSV, sorted by timestamp without duplicates**
+// Malformed lines are skipped. If a timestamp was saved more than once, the last line wins.
+bool loadCandlesCSV(const string& filename, CandleHistory& history) {
+    history.clear();
+    ifstream file(filename, ios::binary);
+    if (!file.is_open()) {
+        cerr << "Failed to open " << filename << " for reading." << endl;
+        return false;
+    }
+    string content;
+    file.seekg(0, ios::end);
+    content.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0, ios::beg);
+    file.read(&content[0], content.size());
+    file.close();
+
+    // timestamp,open,high,low,close,volume
+    bool sorted = true;
+    const char* pos = content.data();
+    const char* end = pos + content.size();
+    while (pos < end) {
+        const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', end - pos));
+        if (!lineEnd) lineEnd = end;
+        long long ts = 0;
+        double values[5];
+        auto result = from_chars(pos, lineEnd, ts);
+        bool valid = result.ec == errc();
+        for (int field = 0; valid && field < 5; field++) {
+            valid = result.ptr < lineEnd && *result.ptr == ',';
+            if (valid) {
+                result = from_chars(result.ptr + 1, lineEnd, values[field]);
+                valid = result.ec == errc();
+            }
+        }
+        if (valid) {
+            if (!history.empty() && ts <= history.timestamp.back()) sorted = false;
+            history.timestamp.push_back(ts);
+            history.open.push_back(values[0]);
+            history.high.push_back(values[1]);
+            history.low.push_back(values[2]);
+            history.close.push_back(values[3]);
+            history.volume.push_back(values[4]);
+        }
+        pos = lineEnd + 1;
+    }
+    if (sorted) return !history.empty();
+
+    // Restarts append overlapping candles, put them back in order and keep the last copy of each
+    vector<size_t> order(history.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(),
+        [&](size_t a, size_t b) { return history.timestamp[a] < history.timestamp[b]; });
+    CandleHistory ordered;
+    for (size_t n = 0; n < order.size(); n++) {
+        if (n + 1 < order.size() && history.timestamp[order[n + 1]] == history.timestamp[order[n]]) continue;
+        size_t i = order[n];
+        ordered.timestamp.push_back(history.timestamp[i]);
+        ordered.open.push_back(history.open[i]);
+        ordered.high.push_back(history.high[i]);
+        ordered.low.push_back(history.low[i]);
+        ordered.close.push_back(history.close[i]);
+        ordered.volume.push_back(history.volume[i]);
+    }
+    history = std::move(ordered);
+    return !history.empty();
+}
+
+// **Format a price or volume with the shortest representation that round-trips**
+string formatNumber(double value) {
+    char buf[32];
+    auto result = to_chars(buf, buf + sizeof(buf), value);
+    return string(buf, result.ptr);
+}
@@ -0,0 +1,132 @@
+#ifndef CANDLESTORE_H
+#define CANDLESTORE_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// **Candle intervals fetched by the bot**
+enum class Interval { M1, M5, M15, H1 };
+const size_t kIntervalCount = 4;
+const std::array<Interval, kIntervalCount> kAllIntervals = { Interval::M1, Interval::M5, Interval::M15, Interval::H1 };
+
+// **Interval name as used by the Bitvavo API ("1m", "5m", "15m", "1h")**
+const char* intervalName(Interval interval);
+
+// **Interval from its API name, returns false for an unknown name**
+bool parseInterval(const std::string& name, Interval& interval);
+
+// **Array index of an interval**
+inline size_t intervalIndex(Interval interval) { return static_cast<size_t>(interval); }
+
+// **Length of an interval in milliseconds**
+long long intervalMillis(Interval interval);
+
+// **Fixed-capacity column that keeps the newest values contiguous**
+// Storage is allocated once at twice the capacity. When the end of the storage is reached
+// the live window is moved back to the front, so pushes never reallocate and cost O(1) amortized.
+template <typename T>
+class RingColumn {
+public:
+    // **Allocate storage for the given number of values, dropping the current contents**
+    void setCapacity(size_t newCapacity) {
+        capacity = newCapacity;
+        storage.assign(newCapacity * 2, T());
+        first = last = 0;
+    }
+
+    // **Append a value, dropping the oldest one once the column is full**
+    void push_back(const T& value) {
+        assert(capacity > 0 && "RingColumn::setCapacity must be called before use");
+        if (last - first == capacity) first++;
+        if (last == storage.size()) {
+            std::copy(storage.begin() + first, storage.begin() + last, storage.begin());
+            last -= first;
+            first = 0;
+        }
+        storage[last++] = value;
+    }
+
+    void clear() { first = last = 0; }
+    size_t size() const { return last - first; }
+    bool empty() const { return last == first; }
+    size_t maxSize() const { return capacity; }
+    T* data() { return storage.data() + first; }
+    const T* data() const { return storage.data() + first; }
+    T& operator[](size_t i) { return storage[first + i]; }
+    const T& operator[](size_t i) const { return storage[first + i]; }
+    T& back() { return storage[last - 1]; }
+    const T& back() const { return storage[last - 1]; }
+
+    // **Drop the newest value**
+    void pop_back() {
+        assert(last > first && "RingColumn::pop_back on an empty column");
+        last--;
+    }
+
+private:
+    std::vector<T> storage;
+    size_t capacity = 0;
+    size_t first = 0;
+    size_t last = 0;
+};
+
+// **Typed candle series, one contiguous column per field, holding the newest candles only**
+struct CandleSeries {
+    RingColumn<long long> timestamp; // Candle open time in milliseconds
+    RingColumn<double> open;
+    RingColumn<double> high;
+    RingColumn<double> low;
+    RingColumn<double> close;
+    RingColumn<double> volume;
+
+    // **Set the number of candles retained, dropping the current contents**
+    void setCapacity(size_t capacity);
+
+    size_t size() const { return timestamp.size(); }
+    bool empty() const { return timestamp.empty(); }
+    long long lastTimestamp() const { return timestamp.empty() ? 0 : timestamp.back(); }
+
+    // **Total number of candles appended, including the ones that were dropped**
+    size_t appended() const { return appendedCount; }
+
+    // **Number of times the last candle was replaced with different values**
+    size_t revisions() const { return revisionCount; }
+
+    // **Append a candle, returns false if it is not newer than the last stored candle**
+    bool append(long long ts, double o, double h, double l, double c, double v);
+
+    // **Replace the last candle, returns false if it does not have the same open time**
+    // The exchange keeps updating the newest candle until its interval has passed.
+    bool replaceLast(long long ts, double o, double h, double l, double c, double v);
+
+private:
+    size_t appendedCount = 0;
+    size_t revisionCount = 0;
+};
+
+// **Unbounded candle columns, used for archives read from disk**
+struct CandleHistory {
+    std::vector<long long> timestamp; // Candle open time in milliseconds
+    std::vector<double> open;
+    std::vector<double> high;
+    std::vector<double> low;
+    std::vector<double> close;
+    std::vector<double> volume;
+
+    size_t size() const { return timestamp.size(); }
+    bool empty() const { return timestamp.empty(); }
+    void clear();
+};
+
+// **Load a timestamp,open,high,low,close,volume candle CSV, sorted by timestamp without duplicates**
+// Malformed lines are skipped. If a timestamp was saved more than once, the last line wins.
+bool loadCandlesCSV(const std::string& filename, CandleHistory& history);
+
+// **Format a price or volume with the shortest representation that round-trips**
+std::string formatNumber(double value);
+
+#endif // !CANDLESTORE_H
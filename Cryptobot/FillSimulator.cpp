@@ -0,0 +1,50 @@
+#include "FillSimulator.h"
+
+using namespace std;
+
+FillSimulator::FillSimulator(double fee, long long latency) : takerFee(fee), latencyMs(latency) {
+}
+
+// **Place a market order at nowMs, a buy spends amount in fiat and a sell sells amount of crypto**
+bool FillSimulator::submit(bool buy, double amount, double signalPrice, long long nowMs) {
+    if (pending) return false;
+    pending = true;
+    pendingBuy = buy;
+    pendingAmount = amount;
+    pendingSignalPrice = signalPrice;
+    due = nowMs + latencyMs;
+    return true;
+}
+
+// **Fill the pending order against a book, or at lastPrice if book is null or the side it takes is empty**
+SimulatedFill FillSimulator::fill(const OrderBook* book, double lastPrice) {
+    SimulatedFill result;
+    if (!pending) return result;
+    pending = false;
+    result.buy = pendingBuy;
+    result.signalPrice = pendingSignalPrice;
+    result.timeMs = due;
+
+    // The fee of a buy comes out of its fiat amount, so only amount / (1 + fee) is spent on the levels
+    const BookSide taken = pendingBuy ? BookSide::Ask : BookSide::Bid;
+    BookWalk walk;
+    if (book && !book->levels(taken).empty()) {
+        walk = pendingBuy ? book->buyQuote(pendingAmount / (1.0 + takerFee)) : book->sellBase(pendingAmount);
+    }
+    else if (lastPrice > 0.0) {
+        walk.quoteAmount = pendingBuy ? pendingAmount / (1.0 + takerFee) : pendingAmount * lastPrice;
+        walk.baseAmount = pendingBuy ? walk.quoteAmount / lastPrice : pendingAmount;
+        walk.complete = true;
+    }
+    if (walk.baseAmount <= 0.0) {
+        result.complete = false;
+        return result;
+    }
+    result.baseAmount = walk.baseAmount;
+    result.fee = walk.quoteAmount * takerFee;
+    result.quoteAmount = pendingBuy ? walk.quoteAmount + result.fee : walk.quoteAmount - result.fee;
+    result.averagePrice = walk.quoteAmount / walk.baseAmount;
+    result.levels = walk.levels;
+    result.complete = walk.complete;
+    return result;
+}
@@ -0,0 +1,50 @@
+#ifndef FILLSIMULATOR_H
+#define FILLSIMULATOR_H
+
+#include "OrderBook.h"
+
+// **Outcome of a simulated market order**
+struct SimulatedFill {
+    bool buy = false;
+    double baseAmount = 0.0;   // Crypto bought or sold, 0 if nothing filled
+    double quoteAmount = 0.0;  // Fiat spent on a buy or received for a sell, after the fee
+    double fee = 0.0;          // Taker fee in fiat
+    double averagePrice = 0.0; // Average price of the levels taken, before the fee
+    double signalPrice = 0.0;  // Last price when the order was placed
+    long long timeMs = 0;      // Time the order reached the book
+    size_t levels = 0;         // Book levels taken, 0 for a fill at the last price
+    bool complete = true;      // False if the book ran out before the order was filled
+};
+
+// **Fills simulated market orders like the exchange would**
+// An order reaches the book latencyMs after it was placed and walks the levels on the other side: a buy spends
+// its fiat amount including the taker fee, a sell receives the value of its crypto minus the fee. Without a book
+// covering that moment, the order fills at the last price, still paying the fee. One order is pending at a time.
+class FillSimulator {
+public:
+    FillSimulator(double takerFee, long long latencyMs);
+
+    // **Place a market order at nowMs, a buy spends amount in fiat and a sell sells amount of crypto**
+    // Returns false while another order is pending.
+    bool submit(bool buy, double amount, double signalPrice, long long nowMs);
+
+    // **True if an order waits for its latency to pass**
+    bool hasPending() const { return pending; }
+
+    // **Time the pending order reaches the book in milliseconds, -1 if there is none**
+    long long dueMs() const { return pending ? due : -1; }
+
+    // **Fill the pending order against a book, or at lastPrice if book is null or the side it takes is empty**
+    SimulatedFill fill(const OrderBook* book, double lastPrice);
+
+private:
+    double takerFee;
+    long long latencyMs;
+    bool pending = false;
+    bool pendingBuy = false;
+    double pendingAmount = 0.0;
+    double pendingSignalPrice = 0.0;
+    long long due = -1;
+};
+
+#endif // !FILLSIMULATOR_H
@@ -0,0 +1,208 @@
+#include "IndicatorKernels.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CRYPTOBOT_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC compiles AVX2 intrinsics in any function, GCC and Clang need the target enabled per function
+#if defined(CRYPTOBOT_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CRYPTOBOT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CRYPTOBOT_TARGET_AVX2
+#endif
+
+using namespace std;
+
+// **Bollinger middle, upper and lower bands of every full window of period closes**
+// Sums oldest to newest in two passes, like IndicatorEngine::update.
+static void bollingerScalar(const double* close, size_t count, int period, double stdDevs,
+    double* middle, double* upper, double* lower) {
+    for (size_t i = period - 1; i < count; i++) {
+        const double* window = close + i + 1 - period;
+        double sum = 0.0, sumSq = 0.0;
+        for (int j = 0; j < period; j++) sum += window[j];
+        double mean = sum / period;
+        for (int j = 0; j < period; j++) {
+            double diff = window[j] - mean;
+            sumSq += diff * diff;
+        }
+        double stdDev = sqrt(sumSq / period);
+        middle[i] = mean;
+        upper[i] = mean + stdDevs * stdDev;
+        lower[i] = mean - stdDevs * stdDev;
+    }
+}
+
+// **True range of every candle after the first**
+static void trueRangeScalar(const double* high, const double* low, const double* close, size_t count, double* range) {
+    for (size_t i = 1; i < count; i++) {
+        double tr = high[i] - low[i];
+        double hpc = fabs(high[i] - close[i - 1]);
+        double lpc = fabs(low[i] - close[i - 1]);
+        if (hpc > tr) tr = hpc;
+        if (lpc > tr) tr = lpc;
+        range[i] = tr;
+    }
+}
+
+// **Gain and loss of every close after the first, the other one is 0**
+static void gainLossScalar(const double* close, size_t count, double* gain, double* loss) {
+    for (size_t i = 1; i < count; i++) {
+        double delta = close[i] - close[i - 1];
+        gain[i] = delta > 0 ? delta : 0.0;
+        loss[i] = delta > 0 ? 0.0 : -delta;
+    }
+}
+
+// **Element-wise a - b, for the MACD line and histogram**
+static void differenceScalar(const double* a, const double* b, size_t count, double* out) {
+    for (size_t i = 0; i < count; i++) out[i] = a[i] - b[i];
+}
+
+// **RSI of every pair of average gain and loss**
+static void rsiScalar(const double* avgGain, const double* avgLoss, size_t count, double* out) {
+    for (size_t i = 0; i < count; i++) {
+        double rs = (avgLoss[i] == 0) ? 100 : avgGain[i] / avgLoss[i];
+        out[i] = 100 - (100 / (1 + rs));
+    }
+}
+
+// **Portable kernels, used when the CPU has no AVX2**
+const IndicatorKernels& scalarIndicatorKernels() {
+    static const IndicatorKernels kernels = {
+        "scalar", bollingerScalar, trueRangeScalar, gainLossScalar, differenceScalar, rsiScalar
+    };
+    return kernels;
+}
+
+#ifdef CRYPTOBOT_X86
+
+// Four candles per instruction; each lane runs the scalar operation sequence of its own candle, and the
+// remainder that does not fill a vector goes through the scalar kernel.
+
+CRYPTOBOT_TARGET_AVX2
+static void bollingerAvx2(const double* close, size_t count, int period, double stdDevs,
+    double* middle, double* upper, double* lower) {
+    const __m256d periodVec = _mm256_set1_pd(static_cast<double>(period));
+    const __m256d stdDevsVec = _mm256_set1_pd(stdDevs);
+    size_t i = period - 1;
+    for (; i + 4 <= count; i += 4) {
+        const double* window = close + i + 1 - period;
+        __m256d sum = _mm256_setzero_pd();
+        for (int j = 0; j < period; j++) sum = _mm256_add_pd(sum, _mm256_loadu_pd(window + j));
+        __m256d mean = _mm256_div_pd(sum, periodVec);
+        __m256d sumSq = _mm256_setzero_pd();
+        for (int j = 0; j < period; j++) {
+            __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(window + j), mean);
+            sumSq = _mm256_add_pd(sumSq, _mm256_mul_pd(diff, diff));
+        }
+        __m256d band = _mm256_mul_pd(stdDevsVec, _mm256_sqrt_pd(_mm256_div_pd(sumSq, periodVec)));
+        _mm256_storeu_pd(middle + i, mean);
+        _mm256_storeu_pd(upper + i, _mm256_add_pd(mean, band));
+        _mm256_storeu_pd(lower + i, _mm256_sub_pd(mean, band));
+    }
+    if (i < count) {
+        size_t done = i - (period - 1);
+        bollingerScalar(close + done, count - done, period, stdDevs, middle + done, upper + done, lower + done);
+    }
+}
+
+CRYPTOBOT_TARGET_AVX2
+static void trueRangeAvx2(const double* high, const double* low, const double* close, size_t count, double* range) {
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    size_t i = 1;
+    for (; i + 4 <= count; i += 4) {
+        __m256d h = _mm256_loadu_pd(high + i);
+        __m256d l = _mm256_loadu_pd(low + i);
+        __m256d prevClose = _mm256_loadu_pd(close + i - 1);
+        __m256d tr = _mm256_sub_pd(h, l);
+        __m256d hpc = _mm256_andnot_pd(signMask, _mm256_sub_pd(h, prevClose));
+        __m256d lpc = _mm256_andnot_pd(signMask, _mm256_sub_pd(l, prevClose));
+        // max_pd(a, b) is a > b ? a : b, the same comparison as the scalar branches
+        tr = _mm256_max_pd(hpc, tr);
+        tr = _mm256_max_pd(lpc, tr);
+        _mm256_storeu_pd(range + i, tr);
+    }
+    if (i < count) trueRangeScalar(high + i - 1, low + i - 1, close + i - 1, count - i + 1, range + i - 1);
+}
+
+CRYPTOBOT_TARGET_AVX2
+static void gainLossAvx2(const double* close, size_t count, double* gain, double* loss) {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    size_t i = 1;
+    for (; i + 4 <= count; i += 4) {
+        __m256d delta = _mm256_sub_pd(_mm256_loadu_pd(close + i), _mm256_loadu_pd(close + i - 1));
+        __m256d rising = _mm256_cmp_pd(delta, zero, _CMP_GT_OQ);
+        _mm256_storeu_pd(gain + i, _mm256_and_pd(rising, delta));
+        _mm256_storeu_pd(loss + i, _mm256_andnot_pd(rising, _mm256_xor_pd(delta, signMask)));
+    }
+    if (i < count) gainLossScalar(close + i - 1, count - i + 1, gain + i - 1, loss + i - 1);
+}
+
+CRYPTOBOT_TARGET_AVX2
+static void differenceAvx2(const double* a, const double* b, size_t count, double* out) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    differenceScalar(a + i, b + i, count - i, out + i);
+}
+
+CRYPTOBOT_TARGET_AVX2
+static void rsiAvx2(const double* avgGain, const double* avgLoss, size_t count, double* out) {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d hundred = _mm256_set1_pd(100.0);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d loss = _mm256_loadu_pd(avgLoss + i);
+        __m256d rs = _mm256_div_pd(_mm256_loadu_pd(avgGain + i), loss);
+        rs = _mm256_blendv_pd(rs, hundred, _mm256_cmp_pd(loss, zero, _CMP_EQ_OQ));
+        _mm256_storeu_pd(out + i, _mm256_sub_pd(hundred, _mm256_div_pd(hundred, _mm256_add_pd(one, rs))));
+    }
+    rsiScalar(avgGain + i, avgLoss + i, count - i, out + i);
+}
+
+// **True if the CPU and the operating system support AVX2**
+static bool cpuHasAvx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0
+        && (_xgetbv(0) & 0x6) == 0x6;
+    if (!osSavesYmm) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // CRYPTOBOT_X86
+
+// **AVX2 kernels, or nullptr if the CPU or the build does not support them**
+const IndicatorKernels* avx2IndicatorKernels() {
+#ifdef CRYPTOBOT_X86
+    static const IndicatorKernels kernels = {
+        "avx2", bollingerAvx2, trueRangeAvx2, gainLossAvx2, differenceAvx2, rsiAvx2
+    };
+    static const bool supported = cpuHasAvx2();
+    return supported ? &kernels : nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+// **Fastest kernels the CPU supports, selected once at runtime**
+const IndicatorKernels& indicatorKernels() {
+    static const IndicatorKernels& selected = avx2IndicatorKernels() ? *avx2IndicatorKernels() : scalarIndicatorKernels();
+    return selected;
+}
@@ -0,0 +1,39 @@
+#ifndef INDICATORKERNELS_H
+#define INDICATORKERNELS_H
+
+#include <cstddef>
+
+// **Batch kernels for the recurrence-free parts of the indicators, over contiguous double arrays**
+// Every kernel produces exactly the values IndicatorEngine::update computes per candle, in the same operation
+// order, so a batch recompute and the streaming engine agree to the last bit. Entries a kernel has no value for
+// (before the first full window, or the first candle of a difference) are left untouched.
+struct IndicatorKernels {
+    const char* name;
+
+    // **Bollinger middle, upper and lower bands of every full window of period closes**
+    void (*bollinger)(const double* close, size_t count, int period, double stdDevs,
+        double* middle, double* upper, double* lower);
+
+    // **True range of every candle after the first**
+    void (*trueRange)(const double* high, const double* low, const double* close, size_t count, double* range);
+
+    // **Gain and loss of every close after the first, the other one is 0**
+    void (*gainLoss)(const double* close, size_t count, double* gain, double* loss);
+
+    // **Element-wise a - b, for the MACD line and histogram**
+    void (*difference)(const double* a, const double* b, size_t count, double* out);
+
+    // **RSI of every pair of average gain and loss**
+    void (*rsi)(const double* avgGain, const double* avgLoss, size_t count, double* out);
+};
+
+// **Portable kernels, used when the CPU has no AVX2**
+const IndicatorKernels& scalarIndicatorKernels();
+
+// **AVX2 kernels, or nullptr if the CPU or the build does not support them**
+const IndicatorKernels* avx2IndicatorKernels();
+
+// **Fastest kernels the CPU supports, selected once at runtime**
+const IndicatorKernels& indicatorKernels();
+
+#endif // !INDICATORKERNELS_H
@@ -0,0 +1,80 @@
+#include "Indicators.h"
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+// **Copy with the Bollinger period clamped to the window the components can hold**
+IndicatorParameters IndicatorParameters::clamped() const {
+    IndicatorParameters result = *this;
+    if (result.bbPeriod > BollingerIndicator::kMaxPeriod) result.bbPeriod = BollingerIndicator::kMaxPeriod;
+    if (result.bbPeriod < 1) result.bbPeriod = 1;
+    return result;
+}
+
+IndicatorEngine::IndicatorEngine(const IndicatorParameters& parameters) : params(parameters.clamped()) {
+}
+
+// **Forget all state, the next candle is treated as the first one**
+void IndicatorEngine::reset() {
+    *this = IndicatorEngine(params);
+}
+
+// **Feed the next candle and return its indicator values**
+IndicatorData IndicatorEngine::update(double high, double low, double close) {
+    const IndicatorInput in = { processed, high, low, close, prevClose };
+    IndicatorData ind;
+    ind.rsi = rsi.update(in, params);
+    MacdIndicator::Value macdValue = macd.update(in, params);
+    ind.macd = macdValue.macd;
+    ind.macd_signal = macdValue.signal;
+    ind.macd_hist = macdValue.hist;
+    ind.ema = ema.update(in, params);
+    BollingerIndicator::Value bands = bollinger.update(in, params);
+    ind.bb_middle = bands.middle;
+    ind.bb_upper = bands.upper;
+    ind.bb_lower = bands.lower;
+    ind.atr = atr.update(in, params);
+
+    prevClose = close;
+    processed++;
+    return ind;
+}
+
+// **Feed many candles at once, writing their indicator values to out**
+// Same values and final state as calling update for every candle. From a fresh engine the recurrence-free
+// parts run through the batch kernels and only the running averages are computed candle by candle.
+void IndicatorEngine::updateBatch(const double* high, const double* low, const double* close, size_t count,
+    IndicatorData* out, const IndicatorKernels& kernels) {
+    if (processed != 0 || count < kMinBatch) {
+        for (size_t i = 0; i < count; i++) out[i] = update(high[i], low[i], close[i]);
+        return;
+    }
+    const IndicatorBatch batch = { high, low, close, count, params, kernels };
+    // Every component runs a block before the next block starts, so the values of the block stay in cache
+    vector<double> columns((RsiIndicator::kColumns + MacdIndicator::kColumns + BollingerIndicator::kColumns
+        + AtrIndicator::kColumns) * kIndicatorColumn);
+    double* rsiColumns = columns.data();
+    double* macdColumns = rsiColumns + RsiIndicator::kColumns * kIndicatorColumn;
+    double* bollingerColumns = macdColumns + MacdIndicator::kColumns * kIndicatorColumn;
+    double* atrColumns = bollingerColumns + BollingerIndicator::kColumns * kIndicatorColumn;
+    for (size_t begin = 0; begin < count; begin += kIndicatorBlock) {
+        const size_t n = count - begin < kIndicatorBlock ? count - begin : kIndicatorBlock;
+        rsi.updateBlock(batch, begin, n, rsiColumns, [out](size_t i, double value) { out[i].rsi = value; });
+        macd.updateBlock(batch, begin, n, macdColumns, [out](size_t i, const MacdIndicator::Value& value) {
+            out[i].macd = value.macd;
+            out[i].macd_signal = value.signal;
+            out[i].macd_hist = value.hist;
+        });
+        ema.updateBlock(batch, begin, n, nullptr, [out](size_t i, double value) { out[i].ema = value; });
+        bollinger.updateBlock(batch, begin, n, bollingerColumns,
+            [out](size_t i, const BollingerIndicator::Value& bands) {
+            out[i].bb_middle = bands.middle;
+            out[i].bb_upper = bands.upper;
+            out[i].bb_lower = bands.lower;
+        });
+        atr.updateBlock(batch, begin, n, atrColumns, [out](size_t i, double value) { out[i].atr = value; });
+    }
+    prevClose = close[count - 1];
+    processed = count;
+}
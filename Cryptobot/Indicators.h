@@ -0,0 +1,397 @@
+#ifndef INDICATORS_H
+#define INDICATORS_H
+
+#include "IndicatorKernels.h"
+#include <cmath>
+#include <cstddef>
+
+// **Indicator values for a single candle**
+struct IndicatorData {
+    double rsi = 0.0;
+    double macd = 0.0;
+    double macd_signal = 0.0;
+    double macd_hist = 0.0;
+    double ema = 0.0;
+    double bb_middle = 0.0;
+    double bb_upper = 0.0;
+    double bb_lower = 0.0;
+    double atr = 0.0;
+};
+
+// **Tunable indicator periods, the defaults are the ones the strategy was written for**
+struct IndicatorParameters {
+    int bbPeriod = 20;      // At most BollingerIndicator::kMaxPeriod
+    double bbStdDev = 2.0;
+    int macdFast = 12;
+    int macdSlow = 26;
+    int macdSignal = 9;
+
+    bool operator==(const IndicatorParameters& other) const {
+        return bbPeriod == other.bbPeriod && bbStdDev == other.bbStdDev && macdFast == other.macdFast
+            && macdSlow == other.macdSlow && macdSignal == other.macdSignal;
+    }
+    bool operator!=(const IndicatorParameters& other) const { return !(*this == other); }
+
+    // **Copy with the Bollinger period clamped to the window the components can hold**
+    IndicatorParameters clamped() const;
+};
+
+// **EMA step, the first value seeds the average**
+inline double emaStep(double value, int period, size_t index, double prevEMA) {
+    double multiplier = 2.0 / (period + 1.0);
+    if (index == 0) return value;
+    return value * multiplier + prevEMA * (1.0 - multiplier);
+}
+
+// **One candle as the indicator components see it**
+struct IndicatorInput {
+    size_t index;      // Candles fed since the last reset, 0 for the first one
+    double high;
+    double low;
+    double close;
+    double prevClose;  // Close of the previous candle, 0 for the first one
+};
+
+// **Candles of a batch fed to fresh indicator components, with the kernels and parameters to run them on**
+// Holds at least IndicatorEngine::kMinBatch candles, shorter batches are cheaper candle by candle.
+struct IndicatorBatch {
+    const double* high;
+    const double* low;
+    const double* close;
+    size_t count;
+    const IndicatorParameters& params;
+    const IndicatorKernels& kernels;
+};
+
+// Candles per block of a batch, few enough for the intermediate columns and the values to stay in cache
+static const size_t kIndicatorBlock = 1024;
+
+// Room before a block in every intermediate column, for the candles a kernel looks back to
+static const size_t kIndicatorLookback = 64;
+
+// Doubles per intermediate column
+static const size_t kIndicatorColumn = kIndicatorLookback + kIndicatorBlock;
+
+// **First candle of a block in column number column of a component's intermediate columns**
+inline double* indicatorColumn(double* columns, size_t column) {
+    return columns + column * kIndicatorColumn + kIndicatorLookback;
+}
+
+// Indicator components: the running state of one indicator, with an update that takes the next candle and
+// returns its value (0 until the indicator is warmed up), and fromData to read the same value from an
+// IndicatorData. IndicatorEngine runs all of them, a strategy pipeline only the ones its conditions use.
+// For a batch, updateBlock feeds a fresh component the blocks of candles in order through the kernels, using
+// kColumns intermediate columns, and hands store(i, value) the value of every candle i of the block.
+
+// **RSI(14), Wilder averages of gains and losses seeded at the 14th candle**
+struct RsiIndicator {
+    using Value = double;
+    static const int kPeriod = 14;
+    static const size_t kColumns = 3;
+
+    double avgGain = 0.0;
+    double avgLoss = 0.0;
+
+    Value update(const IndicatorInput& in, const IndicatorParameters&) {
+        double gain = 0.0, loss = 0.0;
+        if (in.index > 0) {
+            double delta = in.close - in.prevClose;
+            if (delta > 0) gain = delta;
+            else loss = -delta;
+        }
+        if (in.index == kPeriod - 1) {
+            avgGain = gain / 14.0;
+            avgLoss = loss / 14.0;
+        }
+        else if (in.index >= kPeriod) {
+            avgGain = (avgGain * 13 + gain) / 14.0;
+            avgLoss = (avgLoss * 13 + loss) / 14.0;
+            double rs = (avgLoss == 0) ? 100 : avgGain / avgLoss;
+            return 100 - (100 / (1 + rs));
+        }
+        return 0.0;
+    }
+
+    // **Wilder averages candle by candle, the gains, losses and ratios through the kernels**
+    template <typename Store>
+    void updateBlock(const IndicatorBatch& batch, size_t begin, size_t n, double* columns, Store&& store) {
+        double* gain = indicatorColumn(columns, 0);
+        double* loss = indicatorColumn(columns, 1);
+        double* ratio = indicatorColumn(columns, 2);
+        // The differences start at the candle before the block, so its first candle gets its value
+        const size_t back = begin == 0 ? 0 : 1;
+        if (begin == 0) gain[0] = loss[0] = 0.0;
+        batch.kernels.gainLoss(batch.close + begin - back, n + back, gain - back, loss - back);
+        size_t rsiFrom = n;
+        for (size_t k = 0; k < n; k++) {
+            const size_t i = begin + k;
+            if (i == kPeriod - 1) {
+                avgGain = gain[k] / 14.0;
+                avgLoss = loss[k] / 14.0;
+            }
+            else if (i >= kPeriod) {
+                avgGain = (avgGain * 13 + gain[k]) / 14.0;
+                avgLoss = (avgLoss * 13 + loss[k]) / 14.0;
+                if (rsiFrom == n) rsiFrom = k;
+            }
+            gain[k] = avgGain;
+            loss[k] = avgLoss;
+        }
+        batch.kernels.rsi(gain + rsiFrom, loss + rsiFrom, n - rsiFrom, ratio + rsiFrom);
+        for (size_t k = 0; k < n; k++) store(begin + k, k >= rsiFrom ? ratio[k] : 0.0);
+    }
+
+    static Value fromData(const IndicatorData& data) { return data.rsi; }
+};
+
+// **MACD line, signal line and histogram (12, 26, 9 by default)**
+struct MacdIndicator {
+    struct Value {
+        double macd = 0.0;
+        double signal = 0.0;
+        double hist = 0.0;
+    };
+    static const size_t kColumns = 3;
+
+    double emaFast = 0.0;
+    double emaSlow = 0.0;
+    double emaSignal = 0.0;
+
+    Value update(const IndicatorInput& in, const IndicatorParameters& params) {
+        Value value;
+        emaFast = emaStep(in.close, params.macdFast, in.index, emaFast);
+        emaSlow = emaStep(in.close, params.macdSlow, in.index, emaSlow);
+        value.macd = emaFast - emaSlow;
+        emaSignal = emaStep(value.macd, params.macdSignal, in.index, emaSignal);
+        value.signal = emaSignal;
+        value.hist = value.macd - value.signal;
+        return value;
+    }
+
+    // **Averages candle by candle, the MACD line and histogram through the kernels**
+    template <typename Store>
+    void updateBlock(const IndicatorBatch& batch, size_t begin, size_t n, double* columns, Store&& store) {
+        double* fast = indicatorColumn(columns, 0); // Fast average, then the histogram
+        double* slow = indicatorColumn(columns, 1); // Slow average, then the signal line
+        double* line = indicatorColumn(columns, 2);
+        for (size_t k = 0; k < n; k++) {
+            emaFast = emaStep(batch.close[begin + k], batch.params.macdFast, begin + k, emaFast);
+            emaSlow = emaStep(batch.close[begin + k], batch.params.macdSlow, begin + k, emaSlow);
+            fast[k] = emaFast;
+            slow[k] = emaSlow;
+        }
+        batch.kernels.difference(fast, slow, n, line);
+        for (size_t k = 0; k < n; k++) {
+            emaSignal = emaStep(line[k], batch.params.macdSignal, begin + k, emaSignal);
+            slow[k] = emaSignal;
+        }
+        batch.kernels.difference(line, slow, n, fast);
+        for (size_t k = 0; k < n; k++) {
+            Value value;
+            value.macd = line[k];
+            value.signal = slow[k];
+            value.hist = fast[k];
+            store(begin + k, value);
+        }
+    }
+
+    static Value fromData(const IndicatorData& data) {
+        Value value;
+        value.macd = data.macd;
+        value.signal = data.macd_signal;
+        value.hist = data.macd_hist;
+        return value;
+    }
+};
+
+// **EMA(20) of the closes**
+struct EmaIndicator {
+    using Value = double;
+    static const int kPeriod = 20;
+    static const size_t kColumns = 0;
+
+    double ema = 0.0;
+
+    Value update(const IndicatorInput& in, const IndicatorParameters&) {
+        ema = emaStep(in.close, kPeriod, in.index, ema);
+        return ema;
+    }
+
+    // **The average is a recurrence, so it runs candle by candle**
+    template <typename Store>
+    void updateBlock(const IndicatorBatch& batch, size_t begin, size_t n, double*, Store&& store) {
+        for (size_t i = begin; i < begin + n; i++) {
+            ema = emaStep(batch.close[i], kPeriod, i, ema);
+            store(i, ema);
+        }
+    }
+
+    static Value fromData(const IndicatorData& data) { return data.ema; }
+};
+
+// **Bollinger Bands (20 period, 2 std by default), summed oldest to newest like the full recompute**
+// Every close is stored twice, period slots apart, so the last period closes are always contiguous.
+struct BollingerIndicator {
+    struct Value {
+        double middle = 0.0;
+        double upper = 0.0;
+        double lower = 0.0;
+    };
+    static const int kMaxPeriod = 64;
+    static const size_t kColumns = 3;
+    static_assert(static_cast<size_t>(kMaxPeriod) <= kIndicatorLookback, "The columns must hold a window before a block");
+
+    double window[2 * kMaxPeriod] = {};
+    int head = 0;
+
+    Value update(const IndicatorInput& in, const IndicatorParameters& params) {
+        Value value;
+        const int period = params.bbPeriod;
+        window[head] = window[head + period] = in.close;
+        head = (head + 1) % period;
+        if (in.index >= static_cast<size_t>(period - 1)) {
+            const double* closes = window + head;
+            double sum = 0.0, sumSq = 0.0;
+            for (int j = 0; j < period; j++) sum += closes[j];
+            value.middle = sum / period;
+            for (int j = 0; j < period; j++) {
+                double diff = closes[j] - value.middle;
+                sumSq += diff * diff;
+            }
+            double stdDev = std::sqrt(sumSq / period);
+            value.upper = value.middle + params.bbStdDev * stdDev;
+            value.lower = value.middle - params.bbStdDev * stdDev;
+        }
+        return value;
+    }
+
+    // **Bands of every full window through the kernels, the last block leaves its last closes in the window**
+    template <typename Store>
+    void updateBlock(const IndicatorBatch& batch, size_t begin, size_t n, double* columns, Store&& store) {
+        const size_t period = static_cast<size_t>(batch.params.bbPeriod);
+        double* middle = indicatorColumn(columns, 0);
+        double* upper = indicatorColumn(columns, 1);
+        double* lower = indicatorColumn(columns, 2);
+        // The windows start before the block, so its first candle gets its bands
+        const size_t lookback = begin < period - 1 ? begin : period - 1;
+        batch.kernels.bollinger(batch.close + begin - lookback, n + lookback, batch.params.bbPeriod,
+            batch.params.bbStdDev, middle - lookback, upper - lookback, lower - lookback);
+        for (size_t k = 0; k < n; k++) {
+            Value value;
+            if (begin + k + 1 >= period) {
+                value.middle = middle[k];
+                value.upper = upper[k];
+                value.lower = lower[k];
+            }
+            store(begin + k, value);
+        }
+        if (begin + n < batch.count) return;
+        for (size_t i = batch.count - period; i < batch.count; i++) {
+            window[i % period] = window[i % period + period] = batch.close[i];
+        }
+        head = static_cast<int>(batch.count % period);
+    }
+
+    static Value fromData(const IndicatorData& data) {
+        Value value;
+        value.middle = data.bb_middle;
+        value.upper = data.bb_upper;
+        value.lower = data.bb_lower;
+        return value;
+    }
+};
+
+// **ATR(14), the mean of the first true ranges, then a Wilder average**
+struct AtrIndicator {
+    using Value = double;
+    static const int kPeriod = 14;
+    static const size_t kColumns = 1;
+
+    double sumTR = 0.0;
+    double atr = 0.0;
+
+    Value update(const IndicatorInput& in, const IndicatorParameters&) {
+        if (in.index == 0) return 0.0;
+        double hl = in.high - in.low;
+        double hpc = std::fabs(in.high - in.prevClose);
+        double lpc = std::fabs(in.low - in.prevClose);
+        double tr = hl;
+        if (hpc > tr) tr = hpc;
+        if (lpc > tr) tr = lpc;
+        if (in.index <= static_cast<size_t>(kPeriod)) {
+            sumTR += tr;
+            if (in.index == kPeriod) atr = sumTR / 14.0;
+        }
+        else {
+            atr = (atr * 13 + tr) / 14.0;
+        }
+        return in.index >= static_cast<size_t>(kPeriod) ? atr : 0.0;
+    }
+
+    // **Wilder average candle by candle, the true ranges through the kernels**
+    template <typename Store>
+    void updateBlock(const IndicatorBatch& batch, size_t begin, size_t n, double* columns, Store&& store) {
+        double* range = indicatorColumn(columns, 0);
+        // The true ranges start at the candle before the block, so its first candle gets its range
+        const size_t back = begin == 0 ? 0 : 1;
+        if (begin == 0) range[0] = 0.0;
+        batch.kernels.trueRange(batch.high + begin - back, batch.low + begin - back, batch.close + begin - back,
+            n + back, range - back);
+        for (size_t k = 0; k < n; k++) {
+            const size_t i = begin + k;
+            if (i > 0 && i <= static_cast<size_t>(kPeriod)) {
+                sumTR += range[k];
+                if (i == kPeriod) atr = sumTR / 14.0;
+            }
+            else if (i > static_cast<size_t>(kPeriod)) {
+                atr = (atr * 13 + range[k]) / 14.0;
+            }
+            store(i, i >= static_cast<size_t>(kPeriod) ? atr : 0.0);
+        }
+    }
+
+    static Value fromData(const IndicatorData& data) { return data.atr; }
+};
+
+// **Streaming indicator engine: RSI(14), MACD(12, 26, 9), EMA(20), BB(20, 2) and ATR(14)**
+// Runs every indicator component and keeps their running state so each new candle costs O(1),
+// and produces the same values as a full recompute over the whole history.
+// The Bollinger and MACD periods can be changed through IndicatorParameters.
+class IndicatorEngine {
+public:
+    static const int kMaxBBPeriod = BollingerIndicator::kMaxPeriod;
+    static const size_t kMinBatch = 2 * kMaxBBPeriod; // Shorter batches are cheaper candle by candle
+
+    explicit IndicatorEngine(const IndicatorParameters& parameters = IndicatorParameters());
+
+    // **The MACD signal line is only reported once the history holds this many candles**
+    size_t signalWarmup() const { return static_cast<size_t>(params.macdSignal); }
+
+    // **Forget all state, the next candle is treated as the first one**
+    void reset();
+
+    // **Feed the next candle and return its indicator values**
+    IndicatorData update(double high, double low, double close);
+
+    // **Feed many candles at once, writing their indicator values to out**
+    // Same values and final state as calling update for every candle. From a fresh engine the recurrence-free
+    // parts run through the batch kernels and only the running averages are computed candle by candle.
+    void updateBatch(const double* high, const double* low, const double* close, size_t count, IndicatorData* out,
+        const IndicatorKernels& kernels = indicatorKernels());
+
+    // **Number of candles fed since the last reset**
+    size_t count() const { return processed; }
+
+private:
+    IndicatorParameters params;
+    size_t processed = 0;
+    double prevClose = 0.0;
+
+    RsiIndicator rsi;
+    MacdIndicator macd;
+    EmaIndicator ema;
+    BollingerIndicator bollinger;
+    AtrIndicator atr;
+};
+
+#endif // !INDICATORS_H
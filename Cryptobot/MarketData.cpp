@@ -0,0 +1,380 @@
+#include "MarketData.h"
+#include "ApiJournal.h"
+#include "config.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <system_error>
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/select.h>
+#endif
+
+using namespace std;
+using json = nlohmann::json;
+
+// Updates beyond this are dropped oldest first if the trading thread falls behind
+static const size_t kMaxQueuedUpdates = 4096;
+
+// Levels per side of a book snapshot, far more than a simulated market order takes
+static const int kBookSnapshotDepth = 1000;
+
+// **Wait until the socket has data or the timeout expires**
+static void waitReadable(curl_socket_t sock, int timeoutMs) {
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(sock, &readSet);
+    timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+    select(static_cast<int>(sock) + 1, &readSet, nullptr, nullptr, &timeout);
+}
+
+MarketDataFeed::MarketDataFeed(const vector<string>& selectedMarkets, bool streamBooks) : markets(selectedMarkets) {
+    if (!streamBooks) return;
+    for (const string& market : markets) {
+        auto state = make_unique<MarketBook>();
+        if (BOOK_RECORDING && !apiReplay() && state->recorder.open(bookRecordingName(market), market)) {
+            cout << "Recording the " << market << " book to " << bookRecordingName(market) << endl;
+        }
+        books.push_back(move(state));
+    }
+}
+
+MarketDataFeed::~MarketDataFeed() {
+    stop();
+}
+
+// **Start and stop the background connection**
+// Against another transport than the exchange there is no websocket to stream from, the bot then polls over REST.
+void MarketDataFeed::start() {
+    if (running) return;
+    if (!usingExchangeTransport()) {
+        cout << "No websocket feed with the " << apiTransport().name() << " transport, polling over REST." << endl;
+        return;
+    }
+    running = true;
+    worker = thread(&MarketDataFeed::run, this);
+}
+
+void MarketDataFeed::stop() {
+    running = false;
+    if (worker.joinable()) worker.join();
+    queueReady.notify_all();
+}
+
+// **Wait up to timeout for updates, moving all queued updates into out**
+bool MarketDataFeed::waitForUpdates(vector<MarketUpdate>& out, chrono::milliseconds timeout) {
+    unique_lock<mutex> lock(queueMutex);
+    queueReady.wait_for(lock, timeout, [this] { return !queue.empty() || woken; });
+    woken = false;
+    if (queue.empty()) return false;
+    out.insert(out.end(), queue.begin(), queue.end());
+    queue.clear();
+    return true;
+}
+
+// **Make the current or next waitForUpdates return early, for work that completed on another thread**
+void MarketDataFeed::wake() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        woken = true;
+    }
+    queueReady.notify_all();
+}
+
+// **Record the time from receiving an update to the trading decision it triggered**
+void MarketDataFeed::recordDecision(chrono::steady_clock::time_point receivedAt) {
+    auto elapsed = chrono::steady_clock::now() - receivedAt;
+    Metrics::instance().record(LatencyMetric::UpdateToDecision, chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+    double micros = chrono::duration<double, micro>(elapsed).count();
+    lock_guard<mutex> lock(latencyMutex);
+    if (latencySamples.size() < kLatencySamples) latencySamples.push_back(micros);
+    else latencySamples[latencyNext] = micros;
+    latencyNext = (latencyNext + 1) % kLatencySamples;
+}
+
+// **Update-to-decision latency percentiles in microseconds over the last 1024 decisions**
+void MarketDataFeed::decisionLatency(double& p50Us, double& p99Us) {
+    vector<double> samples;
+    {
+        lock_guard<mutex> lock(latencyMutex);
+        samples = latencySamples;
+    }
+    p50Us = p99Us = 0.0;
+    if (samples.empty()) return;
+    sort(samples.begin(), samples.end());
+    p50Us = samples[(samples.size() - 1) * 50 / 100];
+    p99Us = samples[(samples.size() - 1) * 99 / 100];
+}
+
+// **Read the streamed book of a market under its lock, returns false if it is not in sync**
+bool MarketDataFeed::withBook(const string& market, const function<void(const OrderBook&)>& read) {
+    auto it = find(markets.begin(), markets.end(), market);
+    if (it == markets.end() || books.empty()) return false;
+    MarketBook& state = *books[it - markets.begin()];
+    lock_guard<mutex> lock(state.mutex);
+    if (!state.synced) return false;
+    read(state.book);
+    return true;
+}
+
+// **Keep a session open, reconnecting with exponential backoff**
+void MarketDataFeed::run() {
+    int delaySeconds = 1;
+    while (running) {
+        if (session()) delaySeconds = 1;
+        for (int waited = 0; running && waited < delaySeconds * 10; waited++) {
+            this_thread::sleep_for(chrono::milliseconds(100));
+        }
+        delaySeconds = min(delaySeconds * 2, 30);
+    }
+}
+
+// **Connect, subscribe and read messages until the connection drops, returns true if it was subscribed**
+bool MarketDataFeed::session() {
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        cerr << "Failed to initialize CURL for the websocket feed" << endl;
+        return false;
+    }
+    curl_easy_setopt(curl, CURLOPT_URL, WS_URL.c_str());
+    curl_easy_setopt(curl, CURLOPT_CONNECT_ONLY, 2L);
+    CURLcode res = curl_easy_perform(curl);
+    if (res != CURLE_OK) {
+        cerr << "Websocket connect failed: " << curl_easy_strerror(res) << endl;
+        curl_easy_cleanup(curl);
+        return false;
+    }
+
+    json candleIntervals = json::array();
+    for (Interval interval : kAllIntervals) candleIntervals.push_back(intervalName(interval));
+    json subscribe = {
+        { "action", "subscribe" },
+        { "channels", {
+            { { "name", "ticker" }, { "markets", markets } },
+            { { "name", "candles" }, { "interval", candleIntervals }, { "markets", markets } }
+        } }
+    };
+    if (!books.empty()) subscribe["channels"].push_back({ { "name", "book" }, { "markets", markets } });
+    string payload = subscribe.dump();
+    size_t sent = 0;
+    res = curl_ws_send(curl, payload.data(), payload.size(), &sent, 0, CURLWS_TEXT);
+    if (res != CURLE_OK) {
+        cerr << "Websocket subscribe failed: " << curl_easy_strerror(res) << endl;
+        curl_easy_cleanup(curl);
+        return false;
+    }
+    cout << "Websocket feed connected for " << markets.size() << " market(s)" << endl;
+    connected = true;
+
+    // Updates missed while disconnected leave the books out of sync, start each from a new snapshot
+    bookRequests.clear();
+    for (size_t i = 0; i < books.size(); i++) {
+        {
+            lock_guard<mutex> lock(books[i]->mutex);
+            books[i]->synced = false;
+        }
+        bookRequests.push_back(i);
+    }
+    auto requestBooks = [&] {
+        for (size_t marketIndex : bookRequests) {
+            string request = json{ { "action", "getBook" }, { "market", markets[marketIndex] },
+                { "depth", kBookSnapshotDepth } }.dump();
+            if (curl_ws_send(curl, request.data(), request.size(), &sent, 0, CURLWS_TEXT) != CURLE_OK) {
+                cerr << "Websocket book request for " << markets[marketIndex] << " failed" << endl;
+            }
+        }
+        bookRequests.clear();
+    };
+    requestBooks();
+
+    curl_socket_t sock = CURL_SOCKET_BAD;
+    curl_easy_getinfo(curl, CURLINFO_ACTIVESOCKET, &sock);
+    string message;
+    char buffer[16384];
+    JournalWriter* journal = apiCapture();
+    while (running) {
+        size_t received = 0;
+        const curl_ws_frame* meta = nullptr;
+        res = curl_ws_recv(curl, buffer, sizeof(buffer), &received, &meta);
+        if (res == CURLE_AGAIN) {
+            waitReadable(sock, 1000);
+            continue;
+        }
+        if (res != CURLE_OK) {
+            cerr << "Websocket receive failed: " << curl_easy_strerror(res) << endl;
+            break;
+        }
+        if (meta->flags & CURLWS_CLOSE) {
+            cerr << "Websocket closed by the server" << endl;
+            break;
+        }
+        if (meta->flags & CURLWS_TEXT) {
+            message.append(buffer, received);
+            if (meta->bytesleft == 0 && !(meta->flags & CURLWS_CONT)) {
+                if (journal) {
+                    JournalEntry entry;
+                    entry.kind = JournalKind::WebSocket;
+                    entry.timeMs = chrono::duration_cast<chrono::milliseconds>(
+                        chrono::system_clock::now().time_since_epoch()).count();
+                    entry.body = message;
+                    journal->append(entry);
+                }
+                try {
+                    handleMessage(message);
+                }
+                catch (const json::exception& e) {
+                    cerr << "Dropping a websocket message that failed to parse: " << e.what() << endl;
+                }
+                message.clear();
+                if (!bookRequests.empty()) requestBooks();
+            }
+        }
+    }
+    connected = false;
+    for (auto& state : books) {
+        lock_guard<mutex> lock(state->mutex);
+        state->recorder.flush();
+    }
+    curl_easy_cleanup(curl);
+    return true;
+}
+
+// **Handle a websocket message of a replayed journal as if it had just been received**
+void MarketDataFeed::replayMessage(const string& message) {
+    try {
+        handleMessage(message);
+    }
+    catch (const json::exception& e) {
+        cerr << "Dropping a websocket message that failed to parse: " << e.what() << endl;
+    }
+    bookRequests.clear();
+}
+
+// **Number of a websocket field sent as a JSON string or number, false if it is neither or does not parse**
+static bool readNumber(const json& value, double& number) {
+    if (value.is_number()) {
+        number = value.get<double>();
+        return true;
+    }
+    if (!value.is_string()) return false;
+    const string& text = value.get_ref<const string&>();
+    const char* end = text.data() + text.size();
+    from_chars_result result = from_chars(text.data(), end, number);
+    return result.ec == errc() && result.ptr == end;
+}
+
+// **Nonce of a book snapshot or update, 0 if it has none**
+static long long readNonce(const json& event) {
+    auto it = event.find("nonce");
+    return it != event.end() && it->is_number_integer() ? it->get<long long>() : 0;
+}
+
+// **Turn a ticker or candle event into queued updates, and apply book snapshots and updates to the books**
+// Fields of an unexpected type or numbers that do not parse drop the event or the entry they belong to.
+void MarketDataFeed::handleMessage(const string& message) {
+    auto receivedAt = chrono::steady_clock::now();
+    json event = json::parse(message, nullptr, false);
+    if (event.is_discarded() || !event.is_object()) return;
+    auto findMarket = [this](const json& market, size_t& index) {
+        if (!market.is_string()) return false;
+        auto it = find(markets.begin(), markets.end(), market.get_ref<const string&>());
+        index = it - markets.begin();
+        return it != markets.end();
+    };
+    // Book levels are [price, amount] pairs, amount 0 removes the level
+    auto applyLevels = [&](MarketBook& state, const json& source, long long timeMs, bool record) {
+        for (BookSide side : { BookSide::Bid, BookSide::Ask }) {
+            const char* key = side == BookSide::Bid ? "bids" : "asks";
+            if (!source.contains(key)) continue;
+            for (const auto& level : source[key]) {
+                double price = 0.0, amount = 0.0;
+                if (!level.is_array() || level.size() < 2 || !readNumber(level[0], price) || !readNumber(level[1], amount)) continue;
+                state.book.setLevel(side, price, amount);
+                if (record) state.recorder.recordLevel(side, price, amount, timeMs);
+            }
+        }
+    };
+    auto nowMs = [] {
+        return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    };
+
+    size_t marketIndex = 0;
+    if (event.contains("action") && event["action"] == "getBook" && event.contains("response")) {
+        const json& snapshot = event["response"];
+        if (books.empty() || !snapshot.contains("market") || !findMarket(snapshot["market"], marketIndex)) return;
+        MarketBook& state = *books[marketIndex];
+        lock_guard<mutex> lock(state.mutex);
+        long long timeMs = nowMs();
+        state.book.clear();
+        applyLevels(state, snapshot, timeMs, false);
+        state.recorder.recordSnapshot(state.book, timeMs);
+        state.nonce = readNonce(snapshot);
+        state.synced = true;
+        return;
+    }
+    if (!event.contains("event") || !event["event"].is_string()) return;
+    const string& type = event["event"].get_ref<const string&>();
+    if (event.contains("market") && !findMarket(event["market"], marketIndex)) return;
+
+    vector<MarketUpdate> updates;
+    if (type == "ticker" && event.contains("lastPrice")) {
+        MarketUpdate update;
+        update.type = MarketUpdate::Type::Ticker;
+        update.marketIndex = marketIndex;
+        if (!readNumber(event["lastPrice"], update.price)) return;
+        update.receivedAt = receivedAt;
+        updates.push_back(update);
+    }
+    else if (type == "candle" && event.contains("interval") && event.contains("candle")) {
+        Interval interval;
+        const json& intervalName = event["interval"];
+        if (!intervalName.is_string() || !parseInterval(intervalName.get_ref<const string&>(), interval)) return;
+        if (!event["candle"].is_array()) return;
+        for (const auto& candle : event["candle"]) {
+            if (!candle.is_array() || candle.size() < 6 || !candle[0].is_number_integer()) continue;
+            MarketUpdate update;
+            update.type = MarketUpdate::Type::Candle;
+            update.marketIndex = marketIndex;
+            update.interval = interval;
+            update.timestamp = candle[0].get<long long>();
+            if (!readNumber(candle[1], update.open) || !readNumber(candle[2], update.high)
+                || !readNumber(candle[3], update.low) || !readNumber(candle[4], update.close)
+                || !readNumber(candle[5], update.volume)) continue;
+            update.receivedAt = receivedAt;
+            updates.push_back(update);
+        }
+    }
+    else if (type == "book" && !books.empty()) {
+        MarketBook& state = *books[marketIndex];
+        lock_guard<mutex> lock(state.mutex);
+        long long nonce = readNonce(event);
+        if (!state.synced || nonce <= state.nonce) return;
+        if (nonce != state.nonce + 1) {
+            cerr << "Book of " << markets[marketIndex] << " skipped from nonce " << state.nonce << " to " << nonce
+                << ", requesting a new snapshot" << endl;
+            state.synced = false;
+            bookRequests.push_back(marketIndex);
+            return;
+        }
+        applyLevels(state, event, nowMs(), true);
+        state.nonce = nonce;
+        return;
+    }
+    else if (type == "error") {
+        cerr << "Websocket error: " << message << endl;
+    }
+    if (updates.empty()) return;
+
+    {
+        lock_guard<mutex> lock(queueMutex);
+        queue.insert(queue.end(), updates.begin(), updates.end());
+        while (queue.size() > kMaxQueuedUpdates) queue.pop_front();
+    }
+    queueReady.notify_one();
+}
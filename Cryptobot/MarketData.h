@@ -0,0 +1,103 @@
+#ifndef MARKETDATA_H
+#define MARKETDATA_H
+
+#include "CandleStore.h"
+#include "OrderBook.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// **A ticker or candle update received from the websocket feed**
+struct MarketUpdate {
+    enum class Type { Ticker, Candle };
+    Type type = Type::Ticker;
+    size_t marketIndex = 0;         // Index of the market in the list the feed was created with
+    double price = 0.0;             // Ticker: last traded price
+    Interval interval = Interval::M1; // Candle: interval of the candle
+    long long timestamp = 0;        // Candle: open time in milliseconds
+    double open = 0.0;
+    double high = 0.0;
+    double low = 0.0;
+    double close = 0.0;
+    double volume = 0.0;
+    std::chrono::steady_clock::time_point receivedAt;
+};
+
+// **Websocket market data feed for a set of markets (ticker and candle channels, optionally the book channel)**
+// A background thread keeps the websocket connected, reconnecting with backoff, and queues every update.
+// Streamed order books are kept up to date on that thread: each starts from a getBook snapshot, and an update
+// that skips a nonce triggers a new snapshot.
+class MarketDataFeed {
+public:
+    explicit MarketDataFeed(const std::vector<std::string>& markets, bool streamBooks = false);
+    ~MarketDataFeed();
+    MarketDataFeed(const MarketDataFeed&) = delete;
+    MarketDataFeed& operator=(const MarketDataFeed&) = delete;
+
+    // **Start and stop the background connection**
+    // Against another transport than the exchange there is no websocket to stream from, the bot then polls over REST.
+    void start();
+    void stop();
+
+    // **True while the websocket is connected and subscribed**
+    bool isConnected() const { return connected; }
+
+    // **Wait up to timeout for updates, moving all queued updates into out**
+    bool waitForUpdates(std::vector<MarketUpdate>& out, std::chrono::milliseconds timeout);
+
+    // **Make the current or next waitForUpdates return early, for work that completed on another thread**
+    void wake();
+
+    // **Record the time from receiving an update to the trading decision it triggered**
+    void recordDecision(std::chrono::steady_clock::time_point receivedAt);
+
+    // **Update-to-decision latency percentiles in microseconds over the last 1024 decisions**
+    void decisionLatency(double& p50Us, double& p99Us);
+
+    // **Read the streamed book of a market under its lock, returns false if it is not in sync**
+    bool withBook(const std::string& market, const std::function<void(const OrderBook&)>& read);
+
+    // **Handle a websocket message of a replayed journal as if it had just been received**
+    // Its updates are queued for waitForUpdates. The feed must not be started, the snapshots a replayed book
+    // needs after a nonce gap are in the journal already.
+    void replayMessage(const std::string& message);
+
+private:
+    static const size_t kLatencySamples = 1024;
+
+    // **Streamed order book of one market**
+    struct MarketBook {
+        std::mutex mutex;
+        OrderBook book;
+        long long nonce = 0;
+        bool synced = false;
+        BookRecorder recorder; // Only open if BOOK_RECORDING is set
+    };
+
+    std::vector<std::string> markets;
+    std::thread worker;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> connected{ false };
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<MarketUpdate> queue;
+    bool woken = false; // Set by wake, cleared by waitForUpdates
+    std::mutex latencyMutex;
+    std::vector<double> latencySamples;
+    size_t latencyNext = 0;
+    std::vector<std::unique_ptr<MarketBook>> books; // Index: market, empty unless books are streamed
+    std::vector<size_t> bookRequests;               // Markets that need a new snapshot, feed thread only
+
+    void run();
+    bool session();
+    void handleMessage(const std::string& message);
+};
+
+#endif // !MARKETDATA_H
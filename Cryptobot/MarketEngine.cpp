@@ -0,0 +1,147 @@
+#include "MarketEngine.h"
+#include <iostream>
+
+using namespace std;
+
+MarketEngine::MarketEngine(const vector<string>& markets, bool simulationMode, double maxPosition, size_t workerCount)
+    : isSimulation(simulationMode), feed(markets, simulationMode) {
+    for (const auto& market : markets) {
+        auto slot = make_unique<MarketSlot>();
+        slot->bot = make_unique<CryptoTradingBot>(market, simulationMode, market + "_");
+        slot->bot->setRiskParameters(maxPosition);
+        if (!simulationMode) slot->bot->setSharedBalances(&balances);
+        slot->bot->recoverState();
+        slots.push_back(move(slot));
+    }
+    // Spread the first REST polls over the poll interval instead of firing them all at once
+    auto now = chrono::steady_clock::now();
+    for (size_t i = 0; i < slots.size(); i++) {
+        slots[i]->nextPoll = now + chrono::milliseconds(10000 * i / slots.size());
+    }
+    if (workerCount == 0) workerCount = 1;
+    for (size_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&MarketEngine::workerLoop, this);
+    }
+    cout << "Market engine running " << slots.size() << " markets on " << workerCount << " workers" << endl;
+}
+
+MarketEngine::~MarketEngine() {
+    {
+        lock_guard<mutex> lock(runQueueMutex);
+        stopping = true;
+    }
+    runQueueReady.notify_all();
+    for (auto& worker : workers) worker.join();
+    // The onDone of a poll in flight schedules its market
+    for (auto& slot : slots) slot->bot->waitForPoll();
+    feed.stop();
+}
+
+// **Dispatch market data and REST polls to the workers, does not return**
+void MarketEngine::run() {
+    // The workers only touch a bot once it is scheduled, so the bots can be warmed up here first
+    for (auto& slot : slots) slot->bot->warmStart();
+    feed.start();
+    vector<MarketUpdate> updates;
+    auto nextBalanceRefresh = chrono::steady_clock::now();
+    while (true) {
+        auto pollInterval = feed.isConnected() ? chrono::seconds(60) : chrono::seconds(10);
+        pollSeconds = static_cast<int>(pollInterval.count());
+        auto now = chrono::steady_clock::now();
+
+        // One balance request for all markets, only once the snapshot is stale; fills refresh it right away
+        if (!isSimulation && now >= nextBalanceRefresh) {
+            balances.refreshIfStale();
+            nextBalanceRefresh = now + pollInterval;
+        }
+        // Simulated orders are filled by their market's worker once their latency has passed
+        const long long nowMs = chrono::duration_cast<chrono::milliseconds>(
+            chrono::system_clock::now().time_since_epoch()).count();
+        long long wakeMs = nowMs + 1000;
+        for (size_t i = 0; i < slots.size(); i++) {
+            MarketSlot& slot = *slots[i];
+            if (now >= slot.nextPoll) {
+                slot.nextPoll = now + pollInterval;
+                slot.pollDue = true;
+                schedule(i);
+            }
+            long long orderDue = slot.bot->simulatedOrderDue();
+            if (orderDue >= 0 && orderDue <= nowMs) schedule(i);
+            else if (orderDue >= 0) wakeMs = min(wakeMs, orderDue);
+        }
+
+        updates.clear();
+        if (!feed.waitForUpdates(updates, chrono::milliseconds(wakeMs - nowMs))) continue;
+        for (const auto& update : updates) {
+            MarketSlot& slot = *slots[update.marketIndex];
+            lock_guard<mutex> lock(slot.inboxMutex);
+            slot.inbox.push_back(update);
+        }
+        for (const auto& update : updates) {
+            schedule(update.marketIndex);
+        }
+    }
+}
+
+// **Queue a market for a worker unless it is already queued or running**
+void MarketEngine::schedule(size_t slotIndex) {
+    if (slots[slotIndex]->scheduled.exchange(true)) return;
+    {
+        lock_guard<mutex> lock(runQueueMutex);
+        runQueue.push_back(slotIndex);
+    }
+    runQueueReady.notify_one();
+}
+
+// **Run queued markets until the engine stops**
+void MarketEngine::workerLoop() {
+    while (true) {
+        size_t slotIndex;
+        {
+            unique_lock<mutex> lock(runQueueMutex);
+            runQueueReady.wait(lock, [this] { return stopping || !runQueue.empty(); });
+            if (stopping) return;
+            slotIndex = runQueue.front();
+            runQueue.pop_front();
+        }
+        MarketSlot& slot = *slots[slotIndex];
+        runSlot(slotIndex);
+        slot.scheduled = false;
+
+        // Work that arrived while the market was running was not queued, pick it up now
+        bool pending = slot.pollDue || slot.pollDone;
+        if (!pending) {
+            lock_guard<mutex> lock(slot.inboxMutex);
+            pending = !slot.inbox.empty();
+        }
+        if (pending) schedule(slotIndex);
+    }
+}
+
+// **Start a due REST poll, finish a completed one and run the queued updates of one market**
+// The poll's requests run on the retry thread, which queues the market again once they completed, so the worker
+// is free for the updates of this and other markets meanwhile.
+void MarketEngine::runSlot(size_t slotIndex) {
+    MarketSlot& slot = *slots[slotIndex];
+    {
+        lock_guard<mutex> lock(slot.inboxMutex);
+        slot.working.swap(slot.inbox);
+    }
+    if (slot.pollDone.exchange(false)) {
+        if (!slot.bot->finishPoll(feed, chrono::seconds(pollSeconds.load()))) {
+            cout << "Failed to fetch ticker price for " << slot.bot->getMarket() << ", retrying at the next poll." << endl;
+        }
+    }
+    // A poll still in flight when the next one falls due is not started twice
+    if (slot.pollDue.exchange(false) && !slot.bot->pollInFlight()) {
+        slot.bot->startPoll([this, slotIndex] {
+            slots[slotIndex]->pollDone = true;
+            schedule(slotIndex);
+        });
+    }
+    if (!slot.working.empty()) {
+        slot.bot->applyUpdates(slot.working, feed);
+        slot.working.clear();
+    }
+    if (isSimulation) slot.bot->settleSimulatedOrder(feed);
+}
@@ -0,0 +1,60 @@
+#ifndef MARKETENGINE_H
+#define MARKETENGINE_H
+
+#include "Balances.h"
+#include "MarketData.h"
+#include "TradingBot.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// **Runs many markets in one process on a fixed pool of worker threads**
+// A market is only ever processed by one worker at a time, so its bot state needs no locks.
+// The HTTP connection pool, the rate limit state, the websocket feed and the balance snapshot are shared.
+class MarketEngine {
+public:
+    MarketEngine(const std::vector<std::string>& markets, bool simulationMode, double maxPosition, size_t workerCount);
+    ~MarketEngine();
+    MarketEngine(const MarketEngine&) = delete;
+    MarketEngine& operator=(const MarketEngine&) = delete;
+
+    // **Dispatch market data and REST polls to the workers, does not return**
+    void run();
+
+private:
+    // **Per-market state, owned by whichever worker is running the market**
+    struct MarketSlot {
+        std::unique_ptr<CryptoTradingBot> bot;
+        std::mutex inboxMutex;
+        std::vector<MarketUpdate> inbox;   // Filled by the dispatcher
+        std::vector<MarketUpdate> working; // Drained by the worker
+        std::atomic<bool> scheduled{ false };
+        std::atomic<bool> pollDue{ false };
+        std::atomic<bool> pollDone{ false }; // The requests of the market's poll completed on the retry thread
+        std::chrono::steady_clock::time_point nextPoll;
+    };
+
+    bool isSimulation;
+    std::vector<std::unique_ptr<MarketSlot>> slots;
+    MarketDataFeed feed;
+    BalanceSnapshot balances;
+    std::atomic<int> pollSeconds{ 10 };
+
+    std::vector<std::thread> workers;
+    std::mutex runQueueMutex;
+    std::condition_variable runQueueReady;
+    std::deque<size_t> runQueue;
+    bool stopping = false;
+
+    void schedule(size_t slotIndex);
+    void workerLoop();
+    void runSlot(size_t slotIndex);
+};
+
+#endif // !MARKETENGINE_H
@@ -0,0 +1,197 @@
+#include "Metrics.h"
+#include "API_Handling.h"
+#include "config.h"
+#include "RateLimiter.h"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+static const char kMetricsMagic[8] = { 'C', 'B', 'M', 'E', 'T', 'R', 'I', 'C' };
+
+// **Name, labels and help text of a latency metric**
+struct LatencyMetricInfo {
+    const char* name;
+    const char* labels;
+    const char* help;
+};
+
+static const LatencyMetricInfo kLatencyMetricInfo[kLatencyMetricCount] = {
+    { "cryptobot_api_request_seconds", "endpoint=\"candles\"", "REST transfer time by endpoint, without retries" },
+    { "cryptobot_api_request_seconds", "endpoint=\"ticker\"", nullptr },
+    { "cryptobot_api_request_seconds", "endpoint=\"balance\"", nullptr },
+    { "cryptobot_api_request_seconds", "endpoint=\"order\"", nullptr },
+    { "cryptobot_api_request_seconds", "endpoint=\"time\"", nullptr },
+    { "cryptobot_api_request_seconds", "endpoint=\"other\"", nullptr },
+    { "cryptobot_indicator_compute_seconds", "", "Indicator update of one interval, one in 16 updates sampled" },
+    { "cryptobot_poll_tick_seconds", "", "REST poll of one market: fetch, signals and status report" },
+    { "cryptobot_update_to_decision_seconds", "", "Websocket update received to the trading decision it triggered" },
+    { "cryptobot_signal_to_order_seconds", "", "Order signal to the order request handed to the connection" },
+    { "cryptobot_state_write_seconds", "", "Position state written to the state log after a fill, synced to disk" },
+};
+
+// **Counter or gauge read when the metrics are exported**
+struct CounterValue {
+    const char* name;
+    const char* type;
+    const char* help;
+    long long value;
+};
+
+// **Rate limit headroom and connection counters, read from the rate limiter and the connection pool**
+static vector<CounterValue> counterValues() {
+    RateLimitStats limits = RateLimiter::instance().stats();
+    ConnectionStats connections = getConnectionStats();
+    return {
+        { "cryptobot_rate_limit_available", "gauge", "Request weight left in the current rate limit window", limits.available },
+        { "cryptobot_rate_limit_budget", "gauge", "Request weight per rate limit window", limits.budget },
+        { "cryptobot_rate_limit_exchange_remaining", "gauge", "Remaining weight reported by the exchange, -1 if unknown",
+            g_rateLimitRemaining.load() },
+        { "cryptobot_rate_limit_throttled_total", "counter", "Requests that waited for rate limit budget", limits.throttled },
+        { "cryptobot_rate_limit_too_many_requests_total", "counter", "HTTP 429 responses", limits.tooManyRequests },
+        { "cryptobot_api_requests_total", "counter", "Completed HTTP transfers", connections.requests },
+        { "cryptobot_api_handshakes_total", "counter", "New connections opened for them", connections.handshakes },
+        { "cryptobot_api_dropped_total", "counter", "Requests dropped because a retry would pass their deadline",
+            static_cast<long long>(Metrics::instance().dropped()) },
+    };
+}
+
+// **Histogram shard of the calling thread, claimed on its first sample**
+int claimMetricsShard() {
+    static atomic<int> nextShard{ 0 };
+    int shard = nextShard.fetch_add(1, memory_order_relaxed);
+    return shard < kMetricsShards ? shard : kMetricsShards - 1;
+}
+
+// **Samples in a bucket**
+uint64_t LatencyHistogram::bucketCount(int bucket) const {
+    uint64_t count = 0;
+    for (const Shard& shard : shards) count += shard.buckets[bucket].load(memory_order_relaxed);
+    return count;
+}
+
+// **Sum of all samples in nanoseconds**
+uint64_t LatencyHistogram::sum() const {
+    uint64_t total = 0;
+    for (const Shard& shard : shards) total += shard.sumNanos.load(memory_order_relaxed);
+    return total;
+}
+
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+// **Count a request attempt that failed and is retried, code 0 for a transport error**
+void Metrics::recordRetry(long httpCode) {
+    if (httpCode < 0) httpCode = 0;
+    if (httpCode > kMaxRetryCode) httpCode = kMaxRetryCode;
+    retriesByCode[httpCode].fetch_add(1, memory_order_relaxed);
+}
+
+// **Retries counted for an HTTP code**
+uint64_t Metrics::retries(long httpCode) const {
+    if (httpCode < 0 || httpCode > kMaxRetryCode) return 0;
+    return retriesByCode[httpCode].load(memory_order_relaxed);
+}
+
+// **All metrics in the Prometheus text exposition format**
+string Metrics::prometheusText() const {
+    ostringstream out;
+    out << setprecision(10);
+    const char* previous = "";
+    for (size_t m = 0; m < kLatencyMetricCount; m++) {
+        const LatencyMetricInfo& info = kLatencyMetricInfo[m];
+        const LatencyHistogram& histogram = histograms[m];
+        if (strcmp(info.name, previous) != 0) {
+            out << "# HELP " << info.name << " " << info.help << "\n# TYPE " << info.name << " histogram\n";
+            previous = info.name;
+        }
+        const string separator = info.labels[0] ? "," : "";
+        uint64_t cumulative = 0;
+        for (int b = 0; b < LatencyHistogram::kBuckets; b++) {
+            cumulative += histogram.bucketCount(b);
+            if (b + 1 == LatencyHistogram::kBuckets) break;
+            out << info.name << "_bucket{" << info.labels << separator << "le=\""
+                << LatencyHistogram::bucketBound(b) / 1e9 << "\"} " << cumulative << "\n";
+        }
+        out << info.name << "_bucket{" << info.labels << separator << "le=\"+Inf\"} " << cumulative << "\n";
+        const string labels = info.labels[0] ? string("{") + info.labels + "}" : "";
+        out << info.name << "_sum" << labels << " " << histogram.sum() / 1e9 << "\n";
+        out << info.name << "_count" << labels << " " << cumulative << "\n";
+    }
+
+    out << "# HELP cryptobot_api_retries_total Failed request attempts that were retried, by HTTP code "
+        "(0 for a transport error, 2xx for a response that did not parse)\n# TYPE cryptobot_api_retries_total counter\n";
+    for (long code = 0; code <= kMaxRetryCode; code++) {
+        uint64_t count = retries(code);
+        if (count > 0) out << "cryptobot_api_retries_total{code=\"" << code << "\"} " << count << "\n";
+    }
+    for (const CounterValue& counter : counterValues()) {
+        out << "# HELP " << counter.name << " " << counter.help << "\n# TYPE " << counter.name << " " << counter.type
+            << "\n" << counter.name << " " << counter.value << "\n";
+    }
+    return out.str();
+}
+
+// **Append one binary snapshot of all metrics to a dump file, writing the header to a new file**
+bool Metrics::appendSnapshot(const string& filename) const {
+    bool newFile = !filesystem::exists(filename);
+    ofstream file(filename, ios::app | ios::binary);
+    if (!file.is_open()) return false;
+    vector<CounterValue> counters = counterValues();
+    auto writeValue = [&](int64_t value) { file.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    auto writeName = [&](const string& name) {
+        char padded[kMetricsNameSize] = {};
+        memcpy(padded, name.data(), min(name.size(), kMetricsNameSize - 1));
+        file.write(padded, sizeof(padded));
+    };
+    if (newFile) {
+        MetricsDumpHeader header = {};
+        memcpy(header.magic, kMetricsMagic, sizeof(kMetricsMagic));
+        header.version = kMetricsDumpVersion;
+        header.histograms = static_cast<uint32_t>(kLatencyMetricCount);
+        header.buckets = LatencyHistogram::kBuckets;
+        header.firstBucketLog2 = LatencyHistogram::kFirstBucketLog2;
+        header.counters = static_cast<uint32_t>(counters.size());
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const LatencyMetricInfo& info : kLatencyMetricInfo) {
+            writeName(info.labels[0] ? string(info.name) + "{" + info.labels + "}" : string(info.name));
+        }
+        for (const CounterValue& counter : counters) writeName(counter.name);
+    }
+
+    writeValue(chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count());
+    for (const LatencyHistogram& histogram : histograms) {
+        for (int b = 0; b < LatencyHistogram::kBuckets; b++) writeValue(static_cast<int64_t>(histogram.bucketCount(b)));
+        writeValue(static_cast<int64_t>(histogram.sum()));
+    }
+    for (const CounterValue& counter : counters) writeValue(counter.value);
+    vector<pair<long, uint64_t>> retryCounts;
+    for (long code = 0; code <= kMaxRetryCode; code++) {
+        if (retries(code) > 0) retryCounts.emplace_back(code, retries(code));
+    }
+    writeValue(static_cast<int64_t>(retryCounts.size()));
+    for (const auto& retry : retryCounts) {
+        writeValue(retry.first);
+        writeValue(static_cast<int64_t>(retry.second));
+    }
+    file.flush();
+    return static_cast<bool>(file);
+}
+
+// **apiRequest latency metric of an endpoint**
+LatencyMetric apiLatencyMetric(const string& endpoint) {
+    auto startsWith = [&](const char* prefix) { return endpoint.compare(0, char_traits<char>::length(prefix), prefix) == 0; };
+    if (endpoint.find("/candles") != string::npos) return LatencyMetric::ApiCandles;
+    if (startsWith("ticker")) return LatencyMetric::ApiTicker;
+    if (startsWith("balance")) return LatencyMetric::ApiBalance;
+    if (startsWith("order")) return LatencyMetric::ApiOrder;
+    if (startsWith("time")) return LatencyMetric::ApiTime;
+    return LatencyMetric::ApiOther;
+}
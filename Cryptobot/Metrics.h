@@ -0,0 +1,164 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Threads that get a histogram shard of their own, later threads share the last shard
+const int kMetricsShards = 32;
+
+// **Histogram shard of the calling thread, claimed on its first sample**
+int claimMetricsShard();
+inline int metricsShard() {
+    thread_local int shard = claimMetricsShard();
+    return shard;
+}
+
+// **Lock-free latency histogram with power-of-two nanosecond buckets**
+// Bucket i counts the samples of at most 2^(kFirstBucketLog2 + i) ns that did not fit an earlier bucket, the
+// last bucket also counts everything longer. Every recording thread owns a shard that only it writes, so a
+// sample costs a few plain relaxed loads and stores instead of locked read-modify-writes; threads beyond
+// kMetricsShards share the last shard with atomic adds. Readers sum the shards and see each shard at most one
+// sample behind.
+class LatencyHistogram {
+public:
+    static const int kFirstBucketLog2 = 7;  // 128 ns
+    static const int kBuckets = 32;         // Up to 2^38 ns (about 275 s)
+
+    // **Add one sample**
+    void record(long long nanos) {
+        const int shard = metricsShard();
+        Shard& target = shards[shard];
+        std::atomic<uint64_t>& bucket = target.buckets[bucketIndex(nanos)];
+        const uint64_t nanosPositive = static_cast<uint64_t>(nanos > 0 ? nanos : 0);
+        if (shard < kMetricsShards - 1) {
+            bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            target.sumNanos.store(target.sumNanos.load(std::memory_order_relaxed) + nanosPositive, std::memory_order_relaxed);
+        }
+        else {
+            bucket.fetch_add(1, std::memory_order_relaxed);
+            target.sumNanos.fetch_add(nanosPositive, std::memory_order_relaxed);
+        }
+    }
+
+    // **Samples in a bucket**
+    uint64_t bucketCount(int bucket) const;
+
+    // **Sum of all samples in nanoseconds**
+    uint64_t sum() const;
+
+    // **Upper bound of a bucket in nanoseconds, the last bucket has none**
+    static uint64_t bucketBound(int bucket) { return 1ULL << (kFirstBucketLog2 + bucket); }
+
+    // **Bucket a sample falls in**
+    static int bucketIndex(long long nanos) {
+        if (nanos <= (1LL << kFirstBucketLog2)) return 0;
+        // Bits of nanos - 1, so a sample equal to a bound falls in the bucket it bounds
+#ifdef _MSC_VER
+        unsigned long highestBit;
+        _BitScanReverse64(&highestBit, static_cast<unsigned long long>(nanos - 1));
+        const int bits = static_cast<int>(highestBit) + 1;
+#else
+        const int bits = 64 - __builtin_clzll(static_cast<unsigned long long>(nanos - 1));
+#endif
+        const int bucket = bits - kFirstBucketLog2;
+        return bucket < kBuckets ? bucket : kBuckets - 1;
+    }
+
+private:
+    // Cache line aligned so threads never write the same line
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> buckets[kBuckets] = {};
+        std::atomic<uint64_t> sumNanos{ 0 };
+    };
+    Shard shards[kMetricsShards];
+};
+
+// **Latencies the bot records, see kLatencyMetricInfo in Metrics.cpp for their names**
+enum class LatencyMetric {
+    ApiCandles,       // apiRequest transfer time, by endpoint
+    ApiTicker,
+    ApiBalance,
+    ApiOrder,
+    ApiTime,
+    ApiOther,
+    IndicatorCompute, // calculateIndicators, sampled
+    PollTick,         // A full REST poll of one market
+    UpdateToDecision, // Websocket update received to the trading decision it triggered
+    SignalToOrder,    // Order signal to the order request handed to the connection
+    StateWrite,       // Position state recorded after a fill, synced to disk
+};
+const size_t kLatencyMetricCount = 11;
+
+// Highest HTTP code the retry counters keep apart, higher codes are counted as this one
+const long kMaxRetryCode = 599;
+
+// **Process-wide metrics, recorded lock-free from any thread**
+// Rate limit and connection figures are not recorded here; they are read from the rate limiter and the
+// connection pool when the metrics are exported.
+class Metrics {
+public:
+    static Metrics& instance();
+
+    // **Add a latency sample**
+    void record(LatencyMetric metric, long long nanos) {
+        histograms[static_cast<size_t>(metric)].record(nanos);
+    }
+
+    // **Count a request attempt that failed and is retried, code 0 for a transport error**
+    void recordRetry(long httpCode);
+
+    // **Count a request dropped because its next attempt would pass its deadline**
+    void recordDropped() { droppedRequests.fetch_add(1, std::memory_order_relaxed); }
+
+    // **Histogram of a latency metric**
+    const LatencyHistogram& histogram(LatencyMetric metric) const { return histograms[static_cast<size_t>(metric)]; }
+
+    // **Retries counted for an HTTP code**
+    uint64_t retries(long httpCode) const;
+
+    // **Requests dropped at their deadline**
+    uint64_t dropped() const { return droppedRequests.load(std::memory_order_relaxed); }
+
+    // **All metrics in the Prometheus text exposition format**
+    std::string prometheusText() const;
+
+    // **Append one binary snapshot of all metrics to a dump file, writing the header to a new file**
+    bool appendSnapshot(const std::string& filename) const;
+
+private:
+    LatencyHistogram histograms[kLatencyMetricCount];
+    std::atomic<uint64_t> retriesByCode[kMaxRetryCode + 1] = {};
+    std::atomic<uint64_t> droppedRequests{ 0 };
+
+    Metrics() = default;
+};
+
+// **apiRequest latency metric of an endpoint**
+LatencyMetric apiLatencyMetric(const std::string& endpoint);
+
+// Binary metrics dump: a 32 byte header, a table of 64 byte metric names (the latency histograms, then the
+// counters), then one snapshot per dump. A snapshot is the time in milliseconds since the epoch, every histogram
+// as kBuckets bucket counts followed by its sum in nanoseconds, every counter, then the number of retry codes
+// followed by that many (code, count) pairs. All fields are little-endian 64-bit integers.
+const uint32_t kMetricsDumpVersion = 1;
+const size_t kMetricsNameSize = 64;
+
+// **Header at the start of a metrics dump**
+struct MetricsDumpHeader {
+    char magic[8];           // "CBMETRIC"
+    uint32_t version;        // kMetricsDumpVersion
+    uint32_t histograms;     // Latency histograms per snapshot
+    uint32_t buckets;        // Buckets per histogram
+    uint32_t firstBucketLog2;
+    uint32_t counters;       // Counters per snapshot
+    uint32_t reserved;
+};
+static_assert(sizeof(MetricsDumpHeader) == 32, "MetricsDumpHeader must be 32 bytes");
+
+#endif // !METRICS_H
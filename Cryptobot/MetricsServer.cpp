@@ -0,0 +1,149 @@
+#include "MetricsServer.h"
+#include "Metrics.h"
+#include <cstring>
+#include <iostream>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+typedef SOCKET NativeSocket;
+static void closeSocket(NativeSocket sock) { closesocket(sock); }
+#else
+typedef int NativeSocket;
+static void closeSocket(NativeSocket sock) { close(sock); }
+#endif
+
+// A scraper that hangs up early must not raise SIGPIPE
+#ifdef MSG_NOSIGNAL
+static const int kSendFlags = MSG_NOSIGNAL;
+#else
+static const int kSendFlags = 0;
+#endif
+
+// Longest time the server thread waits for a scrape before it checks the dump interval and whether it was stopped
+static const int kPollMillis = 250;
+
+// Largest request accepted, a scrape is a few hundred bytes
+static const size_t kMaxRequestSize = 8192;
+
+static NativeSocket native(intptr_t sock) {
+    return static_cast<NativeSocket>(sock);
+}
+
+// **Wait until the socket has data or the timeout expires**
+static bool waitReadable(NativeSocket sock, int millis) {
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(sock, &readSet);
+    timeval timeout;
+    timeout.tv_sec = millis / 1000;
+    timeout.tv_usec = (millis % 1000) * 1000;
+    return select(static_cast<int>(sock) + 1, &readSet, nullptr, nullptr, &timeout) > 0;
+}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+// **Listen on address:port (port 0 for no endpoint) and dump to dumpFile (empty for no dump)**
+// Returns false if the port cannot be bound or there is nothing to do.
+bool MetricsServer::start(const string& address, int port, const string& dumpFile, chrono::seconds dumpInterval) {
+    if (port <= 0 && dumpFile.empty()) return false;
+    dumpFilename = dumpFile;
+    dumpEvery = dumpInterval;
+    if (port > 0) {
+#ifdef _WIN32
+        WSADATA wsaData;
+        WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+        NativeSocket sock = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in bindAddress = {};
+        bindAddress.sin_family = AF_INET;
+        bindAddress.sin_port = htons(static_cast<uint16_t>(port));
+        int reuse = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+        if (inet_pton(AF_INET, address.c_str(), &bindAddress.sin_addr) != 1
+            || ::bind(sock, reinterpret_cast<sockaddr*>(&bindAddress), sizeof(bindAddress)) != 0
+            || listen(sock, 16) != 0) {
+            cerr << "Unable to serve metrics on " << address << ":" << port << endl;
+            closeSocket(sock);
+            return false;
+        }
+        listenSocket = static_cast<intptr_t>(sock);
+        cout << "Serving metrics on http://" << address << ":" << port << "/metrics" << endl;
+    }
+    running = true;
+    worker = thread(&MetricsServer::run, this);
+    return true;
+}
+
+// **Stop serving and write a last snapshot**
+void MetricsServer::stop() {
+    if (!running) return;
+    running = false;
+    if (worker.joinable()) worker.join();
+    if (listenSocket != -1) closeSocket(native(listenSocket));
+    listenSocket = -1;
+    if (!dumpFilename.empty()) Metrics::instance().appendSnapshot(dumpFilename);
+}
+
+// **Answer scrapes and write dumps until stopped**
+void MetricsServer::run() {
+    auto nextDump = chrono::steady_clock::now() + dumpEvery;
+    while (running) {
+        if (listenSocket == -1) {
+            this_thread::sleep_for(chrono::milliseconds(kPollMillis));
+        }
+        else if (waitReadable(native(listenSocket), kPollMillis)) {
+            NativeSocket client = accept(native(listenSocket), nullptr, nullptr);
+            if (client != static_cast<NativeSocket>(-1)) {
+                serve(static_cast<intptr_t>(client));
+                closeSocket(client);
+            }
+        }
+        if (!dumpFilename.empty() && chrono::steady_clock::now() >= nextDump) {
+            if (!Metrics::instance().appendSnapshot(dumpFilename)) {
+                cerr << "Failed to write metrics dump " << dumpFilename << endl;
+            }
+            nextDump += dumpEvery;
+        }
+    }
+}
+
+// **Read one request from a connection and answer it**
+void MetricsServer::serve(intptr_t client) {
+    NativeSocket sock = native(client);
+    string request;
+    char chunk[1024];
+    while (request.find("\r\n\r\n") == string::npos && request.size() < kMaxRequestSize) {
+        if (!waitReadable(sock, 1000)) return;
+        int received = static_cast<int>(recv(sock, chunk, sizeof(chunk), 0));
+        if (received <= 0) return;
+        request.append(chunk, static_cast<size_t>(received));
+    }
+
+    // Request line: GET /metrics HTTP/1.1, a query string is ignored
+    size_t pathEnd = request.find_first_of(" ?", 4);
+    bool metrics = request.compare(0, 4, "GET ") == 0 && pathEnd != string::npos
+        && request.compare(4, pathEnd - 4, "/metrics") == 0;
+    string body = metrics ? Metrics::instance().prometheusText() : "Not Found\n";
+    string response = string(metrics ? "HTTP/1.1 200 OK" : "HTTP/1.1 404 Not Found")
+        + "\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + to_string(body.size())
+        + "\r\nConnection: close\r\n\r\n" + body;
+    for (size_t sent = 0; sent < response.size();) {
+        int written = static_cast<int>(::send(sock, response.data() + sent, static_cast<int>(response.size() - sent), kSendFlags));
+        if (written <= 0) return;
+        sent += static_cast<size_t>(written);
+    }
+}
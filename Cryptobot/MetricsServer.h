@@ -0,0 +1,41 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// **Embedded HTTP server for GET /metrics and the periodic binary metrics dump**
+// One background thread answers scrapes one connection at a time with the Prometheus text of Metrics, and
+// appends a snapshot to the dump file when its interval has passed. The trading threads are never involved.
+class MetricsServer {
+public:
+    MetricsServer() = default;
+    ~MetricsServer();
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    // **Listen on address:port (port 0 for no endpoint) and dump to dumpFile (empty for no dump)**
+    // Returns false if the port cannot be bound or there is nothing to do.
+    bool start(const std::string& address, int port, const std::string& dumpFile, std::chrono::seconds dumpInterval);
+
+    // **Stop serving and write a last snapshot**
+    void stop();
+
+private:
+    std::intptr_t listenSocket = -1; // SOCKET on Windows, file descriptor elsewhere
+    std::string dumpFilename;
+    std::chrono::seconds dumpEvery{ 60 };
+    std::thread worker;
+    std::atomic<bool> running{ false };
+
+    // **Answer scrapes and write dumps until stopped**
+    void run();
+
+    // **Read one request from a connection and answer it**
+    void serve(std::intptr_t client);
+};
+
+#endif // !METRICSSERVER_H
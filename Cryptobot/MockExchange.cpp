@@ -0,0 +1,334 @@
+#include "MockExchange.h"
+#include "config.h"
+#include "RateLimiter.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+// Most candles the candles endpoint returns per request
+static const int kMaxCandles = 1440;
+
+static const double kTwoPi = 6.283185307179586;
+
+// **Current time in milliseconds since the epoch**
+static long long wallClockMs() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// **Value of a query parameter of an endpoint, empty if it has none**
+static string queryValue(const string& endpoint, const char* key) {
+    size_t query = endpoint.find('?');
+    if (query == string::npos) return "";
+    const size_t keyLength = char_traits<char>::length(key);
+    for (size_t pos = query + 1; pos < endpoint.size();) {
+        size_t end = endpoint.find('&', pos);
+        if (end == string::npos) end = endpoint.size();
+        if (end - pos > keyLength && endpoint.compare(pos, keyLength, key) == 0 && endpoint[pos + keyLength] == '=') {
+            return endpoint.substr(pos + keyLength + 1, end - pos - keyLength - 1);
+        }
+        pos = end + 1;
+    }
+    return "";
+}
+
+// **Milliseconds of a candle interval such as 5m, 0 if it is not one of the exchange's intervals**
+static long long candleMillis(const string& interval) {
+    static const pair<const char*, long long> kIntervals[] = {
+        { "1m", 60000LL }, { "5m", 300000LL }, { "15m", 900000LL }, { "30m", 1800000LL }, { "1h", 3600000LL },
+        { "2h", 7200000LL }, { "4h", 14400000LL }, { "6h", 21600000LL }, { "8h", 28800000LL },
+        { "12h", 43200000LL }, { "1d", 86400000LL },
+    };
+    for (const auto& known : kIntervals) {
+        if (interval == known.first) return known.second;
+    }
+    return 0;
+}
+
+// **Write an error object with an HTTP code into a response**
+static void answerError(ApiResponse& response, long httpCode, int errorCode, const char* message) {
+    char buffer[256];
+    int length = snprintf(buffer, sizeof(buffer), "{\"errorCode\":%d,\"error\":\"%s\"}", errorCode, message);
+    response.httpCode = httpCode;
+    response.body.assign(buffer, static_cast<size_t>(length));
+}
+
+// **Append printf formatted text to a response body**
+template <typename... Args>
+static void appendFormat(string& body, const char* format, Args... args) {
+    char buffer[256];
+    int length = snprintf(buffer, sizeof(buffer), format, args...);
+    if (length > 0) body.append(buffer, min(static_cast<size_t>(length), sizeof(buffer) - 1));
+}
+
+// **Append a positive price or volume as a JSON string with 2 decimals**
+// Written from the integer cents, a candles response has hundreds of numbers and printf or the floating point
+// to_chars take several times longer.
+static void appendQuoted(string& body, double value) {
+    const long long cents = llround(value * 100.0);
+    char buffer[32];
+    char* out = buffer;
+    *out++ = '"';
+    out = to_chars(out, buffer + sizeof(buffer) - 4, cents / 100).ptr;
+    *out++ = '.';
+    *out++ = static_cast<char>('0' + cents % 100 / 10);
+    *out++ = static_cast<char>('0' + cents % 10);
+    *out++ = '"';
+    body.append(buffer, out);
+}
+
+// **Mock exchange options from the MOCK_* settings of the .env file**
+MockExchangeOptions mockExchangeOptionsFromConfig() {
+    MockExchangeOptions options;
+    options.latencyMs = MOCK_LATENCY_MS;
+    options.jitterMs = MOCK_JITTER_MS;
+    options.tooManyRequestsRate = MOCK_429_RATE;
+    options.rateLimit = MOCK_RATE_LIMIT;
+    options.windowMillis = MOCK_WINDOW_MS;
+    options.fiatBalance = MOCK_FIAT_BALANCE;
+    options.takerFee = SIM_TAKER_FEE;
+    return options;
+}
+
+MockExchange::MockExchange(const MockExchangeOptions& exchangeOptions) : options(exchangeOptions), random(1) {
+    balances["EUR"] = options.fiatBalance;
+}
+
+// **Price path of a market: three waves of 12 hours, 97 minutes and 13 minutes around a level**
+// Level and phases are picked from a hash of the market name, so every market moves differently and the
+// indicators see trends and reversals on every interval.
+class PricePath {
+public:
+    explicit PricePath(const string& market) {
+        uint64_t hash = 1469598103934665603ULL;
+        for (char c : market) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ULL;
+        }
+        level = 10.0 * static_cast<double>(1 + hash % 5000);
+        phase = static_cast<double>((hash >> 20) & 0xffff) / 65536.0 * kTwoPi;
+    }
+
+    // **Price at a time in milliseconds since the epoch**
+    double at(long long timeMs) const {
+        return level * (1.0 + 0.03 * wave(timeMs, 43200000LL, phase) + 0.01 * wave(timeMs, 5820000LL, 2 * phase)
+            + 0.004 * wave(timeMs, 780000LL, 3 * phase));
+    }
+
+private:
+    // The time is reduced to the period in integers first, sin of an epoch-sized angle is slow and imprecise
+    static double wave(long long timeMs, long long periodMillis, double phaseShift) {
+        return sin(static_cast<double>(timeMs % periodMillis) / static_cast<double>(periodMillis) * kTwoPi + phaseShift);
+    }
+
+    double level;
+    double phase;
+};
+
+// **Price of a market at a time in milliseconds since the epoch**
+double MockExchange::price(const string& market, long long timeMs) {
+    return PricePath(market).at(timeMs);
+}
+
+MockExchangeStats MockExchange::stats() const {
+    lock_guard<mutex> lock(exchangeMutex);
+    MockExchangeStats result;
+    result.requests = requests;
+    result.tooManyRequests = tooManyRequests;
+    result.orders = orders;
+    return result;
+}
+
+bool MockExchange::send(const string& endpoint, const string& method, const string& body, ApiResponse& response) {
+    long long latencyMicros = answer(endpoint, method, body, response);
+    if (latencyMicros > 0) this_thread::sleep_for(chrono::microseconds(latencyMicros));
+    return true;
+}
+
+// **Answer a batch at once, taking the longest latency of its requests like concurrent transfers**
+bool MockExchange::sendBatch(const vector<ApiRequest>& batch, vector<ApiResponse>& responses) {
+    responses.resize(batch.size());
+    long long latencyMicros = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        latencyMicros = max(latencyMicros, answer(batch[i].endpoint, batch[i].method, batch[i].body, responses[i]));
+    }
+    if (latencyMicros > 0) this_thread::sleep_for(chrono::microseconds(latencyMicros));
+    return true;
+}
+
+// **Answer a request without waiting, returns the latency it takes in microseconds**
+long long MockExchange::answer(const string& endpoint, const string& method, const string& body,
+    ApiResponse& response) {
+    const long long now = wallClockMs();
+    response.error = 0;
+    response.errorText = "";
+    response.newConnections = 0;
+    response.body.clear();
+    long long latencyMicros = options.latencyMs * 1000LL;
+    const int weight = RateLimiter::endpointWeight(endpoint, method);
+    bool refused = false;
+    {
+        lock_guard<mutex> lock(exchangeMutex);
+        requests++;
+        if (options.jitterMs > 0) latencyMicros += static_cast<long long>(random() % (options.jitterMs * 1000ULL + 1));
+        // Fixed windows like the exchange's, a request that does not fit is refused without spending budget
+        if (now >= windowEnd) {
+            windowEnd = now - now % options.windowMillis + options.windowMillis;
+            spent = 0;
+        }
+        const bool injected = options.tooManyRequestsRate > 0.0
+            && uniform_real_distribution<double>(0.0, 1.0)(random) < options.tooManyRequestsRate;
+        response.rateLimitResetAt = windowEnd;
+        refused = injected || spent + weight > options.rateLimit;
+        if (refused) tooManyRequests++;
+        else spent += weight;
+        response.rateLimitRemaining = max(options.rateLimit - spent, 0LL);
+    }
+    response.durationMicros = latencyMicros;
+    if (refused) {
+        answerError(response, 429, 105, "The rate limit has been exceeded.");
+        return latencyMicros;
+    }
+
+    // Prices and candles are computed outside the lock, only balances and orders share state
+    const string path = endpoint.substr(0, endpoint.find('?'));
+    response.httpCode = 200;
+    if (method == "GET" && path == "time") {
+        appendFormat(response.body, "{\"time\":%lld}", now);
+    }
+    else if (method == "GET" && path == "ticker/price") {
+        const string market = queryValue(endpoint, "market");
+        if (market.empty()) answerError(response, 400, 205, "market parameter is required.");
+        else {
+            response.body.append("{\"market\":\"").append(market).append("\",\"price\":");
+            appendQuoted(response.body, price(market, now));
+            response.body.push_back('}');
+        }
+    }
+    else if (method == "GET" && path == "balance") {
+        answerBalance(endpoint, response);
+    }
+    else if (method == "GET" && path.size() > 8 && path.compare(path.size() - 8, 8, "/candles") == 0) {
+        answerCandles(endpoint, now, response);
+    }
+    else if (method == "POST" && path == "order") {
+        answerOrder(body, now, response);
+    }
+    else {
+        answerError(response, 404, 110, "Invalid endpoint. Please check url and HTTP method.");
+    }
+    return latencyMicros;
+}
+
+// **Candles of <market>/candles?interval=..&limit=..&start=..&end=.., newest first like the exchange**
+// The candle still open at the current time is included with the price so far.
+void MockExchange::answerCandles(const string& endpoint, long long now, ApiResponse& response) {
+    const string market = endpoint.substr(0, endpoint.find('/'));
+    const long long millis = candleMillis(queryValue(endpoint, "interval"));
+    if (millis == 0) {
+        answerError(response, 400, 205, "interval parameter is invalid.");
+        return;
+    }
+    const string limitValue = queryValue(endpoint, "limit");
+    const string startValue = queryValue(endpoint, "start");
+    const string endValue = queryValue(endpoint, "end");
+    int limit = limitValue.empty() ? kMaxCandles : atoi(limitValue.c_str());
+    limit = max(1, min(limit, kMaxCandles));
+    const long long start = startValue.empty() ? 0 : atoll(startValue.c_str());
+    const long long end = endValue.empty() ? now : min(atoll(endValue.c_str()), now);
+    const PricePath path(market);
+    response.body.push_back('[');
+    int count = 0;
+    double closePrice = 0.0;
+    for (long long open = end - end % millis; open >= start && count < limit; open -= millis, count++) {
+        // Newest first, so a candle closes at the price the candle after it opened at
+        const long long close = min(open + millis, now);
+        if (count == 0) closePrice = path.at(close);
+        const double openPrice = path.at(open);
+        const double middle = path.at(open + (close - open) / 2);
+        const double high = max(max(openPrice, closePrice), middle);
+        const double low = min(min(openPrice, closePrice), middle);
+        const double volume = 1.0 + static_cast<double>((open / millis) % 97) * 0.1;
+        char time[24];
+        response.body.append(count > 0 ? ",[" : "[");
+        response.body.append(time, to_chars(time, time + sizeof(time), open).ptr);
+        for (double value : { openPrice, high, low, closePrice, volume }) {
+            response.body.push_back(',');
+            appendQuoted(response.body, value);
+        }
+        response.body.push_back(']');
+        closePrice = openPrice;
+    }
+    response.body.push_back(']');
+}
+
+// **Available amount of every asset, or of the one asset of balance?symbol=..**
+void MockExchange::answerBalance(const string& endpoint, ApiResponse& response) {
+    const string symbol = queryValue(endpoint, "symbol");
+    lock_guard<mutex> lock(exchangeMutex);
+    response.body.push_back('[');
+    bool first = true;
+    for (const auto& balance : balances) {
+        if (!symbol.empty() && balance.first != symbol) continue;
+        if (!first) response.body.push_back(',');
+        first = false;
+        // Rounded down to the 8 decimals of the exchange, so selling the whole balance does not ask for more
+        appendFormat(response.body, "{\"symbol\":\"%s\",\"available\":\"%.8f\",\"inOrder\":\"0\"}",
+            balance.first.c_str(), floor(balance.second * 1e8) / 1e8);
+    }
+    response.body.push_back(']');
+}
+
+// **Fill a market order at the current price, buying for amountQuote or selling amount, less the taker fee**
+void MockExchange::answerOrder(const string& body, long long now, ApiResponse& response) {
+    json order = json::parse(body, nullptr, false);
+    if (order.is_discarded() || !order.is_object()) {
+        answerError(response, 400, 107, "The request body is not valid JSON.");
+        return;
+    }
+    const string market = order.value("market", "");
+    const string side = order.value("side", "");
+    const size_t dash = market.find('-');
+    if (dash == string::npos || (side != "buy" && side != "sell")) {
+        answerError(response, 400, 205, "market or side parameter is invalid.");
+        return;
+    }
+    if (order.value("orderType", "") != "market") {
+        answerError(response, 400, 205, "Only market orders are supported by the mock exchange.");
+        return;
+    }
+    const string base = market.substr(0, dash);
+    const string quote = market.substr(dash + 1);
+    const bool buy = side == "buy";
+    const double amount = atof(order.value(buy ? "amountQuote" : "amount", "0").c_str());
+    if (amount <= 0.0) {
+        answerError(response, 400, 205, buy ? "amountQuote parameter is invalid." : "amount parameter is invalid.");
+        return;
+    }
+    const double fillPrice = price(market, now);
+    lock_guard<mutex> lock(exchangeMutex);
+    double& spend = balances[buy ? quote : base];
+    if (spend < amount) {
+        answerError(response, 400, 216, "You do not have sufficient balance to complete this operation.");
+        return;
+    }
+    const double quoteAmount = buy ? amount : amount * fillPrice;
+    const double fee = quoteAmount * options.takerFee;
+    const double baseAmount = buy ? (amount - fee) / fillPrice : amount;
+    spend -= amount;
+    balances[buy ? base : quote] += buy ? baseAmount : quoteAmount - fee;
+    orders++;
+    appendFormat(response.body, "{\"orderId\":\"mock-%lld\",\"market\":\"%s\",\"created\":%lld,\"updated\":%lld,",
+        orders, market.c_str(), now, now);
+    appendFormat(response.body, "\"status\":\"filled\",\"side\":\"%s\",\"orderType\":\"market\",", side.c_str());
+    appendFormat(response.body, "\"filledAmount\":\"%.10g\",\"filledAmountQuote\":\"%.10g\",", baseAmount,
+        quoteAmount);
+    appendFormat(response.body, "\"feePaid\":\"%.10g\",\"feeCurrency\":\"%s\"}", fee, quote.c_str());
+}
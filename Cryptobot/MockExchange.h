@@ -0,0 +1,76 @@
+#ifndef MOCKEXCHANGE_H
+#define MOCKEXCHANGE_H
+
+#include "API_Handling.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+// **Behaviour of the mock exchange**
+struct MockExchangeOptions {
+    int latencyMs = 0;                // Time every response takes
+    int jitterMs = 0;                 // Up to this much longer, uniformly distributed
+    double tooManyRequestsRate = 0.0; // Share of requests answered with HTTP 429 although budget is left
+    long long rateLimit = 1000;       // Weight allowed per window, requests beyond it get HTTP 429
+    long long windowMillis = 60000;   // Length of a rate limit window
+    double fiatBalance = 1000.0;      // Starting EUR balance
+    double takerFee = 0.0025;         // Fee rate of a market order
+};
+
+// **Mock exchange options from the MOCK_* settings of the .env file**
+MockExchangeOptions mockExchangeOptionsFromConfig();
+
+// **Counters of the mock exchange**
+struct MockExchangeStats {
+    long long requests = 0;
+    long long tooManyRequests = 0; // Answered with HTTP 429, injected or over the rate limit
+    long long orders = 0;          // Market orders filled
+};
+
+// **In-process stand-in for the Bitvavo REST API, as a transport of apiRequest**
+// Serves time, ticker/price, balance, candles and market orders. Prices follow a fixed path per market, so a
+// candle is the same in every response, and orders fill at the current price against the balances of the mock.
+// Responses carry the rate limit headers of a fixed window that the endpoint weights of the rate limiter spend,
+// and a share of requests can be answered with HTTP 429 to exercise the retry logic. Nothing goes over a socket,
+// so the bot can be driven at thousands of requests per second.
+class MockExchange : public ApiTransport {
+public:
+    explicit MockExchange(const MockExchangeOptions& options);
+
+    const char* name() const override { return "mock exchange"; }
+
+    bool send(const std::string& endpoint, const std::string& method, const std::string& body,
+        ApiResponse& response) override;
+
+    // **Answer a batch at once, taking the longest latency of its requests like concurrent transfers**
+    bool sendBatch(const std::vector<ApiRequest>& requests, std::vector<ApiResponse>& responses) override;
+
+    // **Price of a market at a time in milliseconds since the epoch**
+    static double price(const std::string& market, long long timeMs);
+
+    MockExchangeStats stats() const;
+
+private:
+    // **Answer a request without waiting, returns the latency it takes in microseconds**
+    long long answer(const std::string& endpoint, const std::string& method, const std::string& body,
+        ApiResponse& response);
+
+    void answerCandles(const std::string& endpoint, long long nowMs, ApiResponse& response);
+    void answerBalance(const std::string& endpoint, ApiResponse& response);
+    void answerOrder(const std::string& body, long long nowMs, ApiResponse& response);
+
+    MockExchangeOptions options;
+    mutable std::mutex exchangeMutex;
+    std::mt19937_64 random;
+    long long windowEnd = 0;
+    long long spent = 0;                    // Weight spent in the current window
+    std::map<std::string, double> balances; // Available amount per asset
+    long long orders = 0;
+    long long requests = 0;
+    long long tooManyRequests = 0;
+};
+
+#endif // !MOCKEXCHANGE_H
@@ -0,0 +1,202 @@
+#include "OrderBook.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+
+static const char kBookRecordingMagic[8] = { 'C', 'B', 'L', '2', 'B', 'O', 'O', 'K' };
+
+// **Remove all levels**
+void OrderBook::clear() {
+    bids.clear();
+    asks.clear();
+}
+
+// **Set the amount at a price, 0 removes the level**
+void OrderBook::setLevel(BookSide side, double price, double amount) {
+    const bool bid = side == BookSide::Bid;
+    vector<BookLevel>& levels = bid ? bids : asks;
+    // Levels worse than the price come first; a bid is worse when lower, an ask when higher
+    auto worse = [bid](const BookLevel& level, double value) { return bid ? level.price < value : level.price > value; };
+    auto it = lower_bound(levels.begin(), levels.end(), price, worse);
+    if (it != levels.end() && it->price == price) {
+        if (amount > 0.0) it->amount = amount;
+        else levels.erase(it);
+    }
+    else if (amount > 0.0) {
+        levels.insert(it, BookLevel{ price, amount });
+    }
+}
+
+// **Walk the asks with a market buy spending quoteAmount**
+BookWalk OrderBook::buyQuote(double quoteAmount) const {
+    BookWalk walk;
+    double remaining = quoteAmount;
+    for (auto it = asks.rbegin(); it != asks.rend() && remaining > 0.0; ++it) {
+        const double levelQuote = it->price * it->amount;
+        const double taken = min(levelQuote, remaining);
+        walk.baseAmount += taken == levelQuote ? it->amount : taken / it->price;
+        walk.quoteAmount += taken;
+        remaining -= taken;
+        walk.levels++;
+    }
+    walk.complete = remaining <= 0.0;
+    return walk;
+}
+
+// **Walk the bids with a market sell of baseAmount**
+BookWalk OrderBook::sellBase(double baseAmount) const {
+    BookWalk walk;
+    double remaining = baseAmount;
+    for (auto it = bids.rbegin(); it != bids.rend() && remaining > 0.0; ++it) {
+        const double taken = min(it->amount, remaining);
+        walk.baseAmount += taken;
+        walk.quoteAmount += taken * it->price;
+        remaining -= taken;
+        walk.levels++;
+    }
+    walk.complete = remaining <= 0.0;
+    return walk;
+}
+
+// **Recording file name of a market: <market>_book.bin**
+string bookRecordingName(const string& market) {
+    return market + "_book.bin";
+}
+
+// **True if the header belongs to a recording of this format**
+static bool isValidHeader(const BookRecordingHeader& header) {
+    return memcmp(header.magic, kBookRecordingMagic, sizeof(kBookRecordingMagic)) == 0
+        && header.version == kBookRecordingVersion && header.recordSize == sizeof(BookRecord);
+}
+
+BookRecorder::~BookRecorder() {
+    flush();
+}
+
+// **Open or create the recording of a market, returns false on an I/O error or a foreign file**
+bool BookRecorder::open(const string& filename, const string& market) {
+    error_code ec;
+    uintmax_t fileSize = filesystem::exists(filename, ec) ? filesystem::file_size(filename, ec) : 0;
+    if (ec) {
+        cerr << "Failed to read the size of " << filename << ": " << ec.message() << endl;
+        return false;
+    }
+    if (fileSize < sizeof(BookRecordingHeader)) {
+        BookRecordingHeader header = {};
+        memcpy(header.magic, kBookRecordingMagic, sizeof(kBookRecordingMagic));
+        header.version = kBookRecordingVersion;
+        header.recordSize = sizeof(BookRecord);
+        memcpy(header.market, market.data(), min(market.size(), sizeof(header.market) - 1));
+        ofstream created(filename, ios::binary | ios::trunc);
+        created.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!created) {
+            cerr << "Failed to create " << filename << endl;
+            return false;
+        }
+    }
+    else {
+        ifstream existing(filename, ios::binary);
+        BookRecordingHeader header;
+        existing.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!existing || !isValidHeader(header)) {
+            cerr << filename << " is not a book recording of version " << kBookRecordingVersion << endl;
+            return false;
+        }
+        existing.close();
+        uintmax_t intactSize = sizeof(BookRecordingHeader)
+            + (fileSize - sizeof(BookRecordingHeader)) / sizeof(BookRecord) * sizeof(BookRecord);
+        if (intactSize != fileSize) {
+            filesystem::resize_file(filename, intactSize, ec);
+            if (ec) {
+                cerr << "Failed to drop the torn record of " << filename << ": " << ec.message() << endl;
+                return false;
+            }
+        }
+    }
+    file.open(filename, ios::binary | ios::app);
+    pending.reserve(kBufferedRecords);
+    return file.is_open();
+}
+
+// **Queue a snapshot: every level of the book, the first one clearing the book**
+void BookRecorder::recordSnapshot(const OrderBook& book, long long timeMs) {
+    if (!file.is_open()) return;
+    uint32_t flags = kBookRecordClear;
+    for (BookSide side : { BookSide::Bid, BookSide::Ask }) {
+        for (const BookLevel& level : book.levels(side)) {
+            pending.push_back(BookRecord{ timeMs, level.price, level.amount, static_cast<uint32_t>(side), flags });
+            flags = 0;
+            if (pending.size() >= kBufferedRecords) flush();
+        }
+    }
+    if (flags != 0) pending.push_back(BookRecord{ timeMs, 0.0, 0.0, static_cast<uint32_t>(BookSide::Bid), flags });
+}
+
+// **Queue one level change**
+void BookRecorder::recordLevel(BookSide side, double price, double amount, long long timeMs) {
+    if (!file.is_open()) return;
+    pending.push_back(BookRecord{ timeMs, price, amount, static_cast<uint32_t>(side), 0 });
+    if (pending.size() >= kBufferedRecords || timeMs - pending.front().timeMs >= kFlushMillis) flush();
+}
+
+// **Write the queued records**
+void BookRecorder::flush() {
+    if (pending.empty() || !file.is_open()) return;
+    file.write(reinterpret_cast<const char*>(pending.data()), static_cast<streamsize>(pending.size() * sizeof(BookRecord)));
+    file.flush();
+    pending.clear();
+}
+
+// **Open a recording, returns false if it is missing, empty or not a valid recording**
+bool BookReplay::open(const string& filename) {
+    file.open(filename, ios::binary);
+    if (!file.is_open()) return false;
+    BookRecordingHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || !isValidHeader(header)) {
+        cerr << filename << " is not a book recording of version " << kBookRecordingVersion << endl;
+        file.close();
+        return false;
+    }
+    file.seekg(0, ios::end);
+    const streamoff records = (static_cast<streamoff>(file.tellg()) - static_cast<streamoff>(sizeof(header)))
+        / static_cast<streamoff>(sizeof(BookRecord));
+    if (records <= 0) {
+        file.close();
+        return false;
+    }
+    BookRecord last;
+    file.seekg(static_cast<streamoff>(sizeof(header)) + (records - 1) * static_cast<streamoff>(sizeof(BookRecord)));
+    file.read(reinterpret_cast<char*>(&last), sizeof(last));
+    lastTime = last.timeMs;
+    file.seekg(static_cast<streamoff>(sizeof(header)));
+    chunk.resize(kReadRecords);
+    file.read(reinterpret_cast<char*>(chunk.data()), static_cast<streamsize>(kReadRecords * sizeof(BookRecord)));
+    chunk.resize(static_cast<size_t>(file.gcount()) / sizeof(BookRecord));
+    firstTime = chunk.front().timeMs;
+    next = 0;
+    appliedCount = 0;
+    return true;
+}
+
+// **Apply the changes recorded at or before timeMs**
+void BookReplay::advanceTo(long long timeMs, OrderBook& book) {
+    while (true) {
+        if (next == chunk.size()) {
+            // A record torn by a crash of the recorder is left out by reading whole records only
+            chunk.resize(kReadRecords);
+            file.read(reinterpret_cast<char*>(chunk.data()), static_cast<streamsize>(kReadRecords * sizeof(BookRecord)));
+            chunk.resize(static_cast<size_t>(file.gcount()) / sizeof(BookRecord));
+            next = 0;
+            if (chunk.empty()) return;
+        }
+        const BookRecord& record = chunk[next];
+        if (record.timeMs > timeMs) return;
+        applyBookRecord(book, record);
+        next++;
+        appliedCount++;
+    }
+}
@@ -0,0 +1,142 @@
+#ifndef ORDERBOOK_H
+#define ORDERBOOK_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// **Side of a book level**
+enum class BookSide : uint32_t { Bid, Ask };
+
+// **Amount offered at one price**
+struct BookLevel {
+    double price;
+    double amount;
+};
+
+// **Levels a market order takes from the book**
+struct BookWalk {
+    double baseAmount = 0.0;  // Crypto taken from the levels
+    double quoteAmount = 0.0; // Fiat value of the levels taken, before fees
+    size_t levels = 0;        // Levels touched
+    bool complete = false;    // False if the side ran out before the order was filled
+};
+
+// **Level 2 order book of one market**
+// Each side is a vector sorted with the best price at the back, bids ascending and asks descending. Most
+// updates change levels near the best price, so inserting or removing a level only moves the few levels in
+// front of it, and market orders walk the vector from the back.
+class OrderBook {
+public:
+    // **Remove all levels**
+    void clear();
+
+    // **Set the amount at a price, 0 removes the level**
+    void setLevel(BookSide side, double price, double amount);
+
+    // **Levels of a side, best price last**
+    const std::vector<BookLevel>& levels(BookSide side) const { return side == BookSide::Bid ? bids : asks; }
+
+    // **Best bid and ask, 0 if the side is empty**
+    double bestBid() const { return bids.empty() ? 0.0 : bids.back().price; }
+    double bestAsk() const { return asks.empty() ? 0.0 : asks.back().price; }
+
+    // **Walk the asks with a market buy spending quoteAmount**
+    BookWalk buyQuote(double quoteAmount) const;
+
+    // **Walk the bids with a market sell of baseAmount**
+    BookWalk sellBase(double baseAmount) const;
+
+private:
+    std::vector<BookLevel> bids;
+    std::vector<BookLevel> asks;
+};
+
+// **One recorded book change, stored as a fixed 32 byte record**
+struct BookRecord {
+    int64_t timeMs;  // Receive time in milliseconds since the epoch
+    double price;
+    double amount;   // New amount at the price, 0 removes the level
+    uint32_t side;   // BookSide
+    uint32_t flags;  // kBookRecordClear on the first level of a snapshot
+};
+static_assert(sizeof(BookRecord) == 32, "BookRecord must be packed to 32 bytes");
+
+// The book is emptied before the record is applied, a snapshot of an empty book is one record with amount 0
+const uint32_t kBookRecordClear = 1;
+
+// **Header at the start of every book recording, followed by the changes in time order**
+struct BookRecordingHeader {
+    char magic[8];       // "CBL2BOOK"
+    uint32_t version;    // kBookRecordingVersion
+    uint32_t recordSize; // sizeof(BookRecord)
+    char market[16];     // Market of the book, zero padded
+};
+static_assert(sizeof(BookRecordingHeader) == 32, "BookRecordingHeader must be 32 bytes");
+
+const uint32_t kBookRecordingVersion = 1;
+
+// **Recording file name of a market: <market>_book.bin**
+std::string bookRecordingName(const std::string& market);
+
+// **Apply a recorded change to a book**
+inline void applyBookRecord(OrderBook& book, const BookRecord& record) {
+    if (record.flags & kBookRecordClear) book.clear();
+    book.setLevel(static_cast<BookSide>(record.side), record.price, record.amount);
+}
+
+// **Appends the changes of a streamed book to its recording**
+// Records are buffered and written in blocks, at the latest a second after the oldest one was queued. A record
+// torn by a crash during an earlier write is dropped when the recording is opened again.
+class BookRecorder {
+public:
+    ~BookRecorder();
+
+    // **Open or create the recording of a market, returns false on an I/O error or a foreign file**
+    bool open(const std::string& filename, const std::string& market);
+
+    // **Queue a snapshot: every level of the book, the first one clearing the book**
+    void recordSnapshot(const OrderBook& book, long long timeMs);
+
+    // **Queue one level change**
+    void recordLevel(BookSide side, double price, double amount, long long timeMs);
+
+    // **Write the queued records**
+    void flush();
+
+private:
+    static const size_t kBufferedRecords = 2048;
+    static const long long kFlushMillis = 1000;
+
+    std::ofstream file;
+    std::vector<BookRecord> pending;
+};
+
+// **Reads a book recording in time order, applying its changes to a book**
+class BookReplay {
+public:
+    // **Open a recording, returns false if it is missing, empty or not a valid recording**
+    bool open(const std::string& filename);
+
+    // **Apply the changes recorded at or before timeMs**
+    void advanceTo(long long timeMs, OrderBook& book);
+
+    // **True if the recording has changes at or before timeMs and after it**
+    bool covers(long long timeMs) const { return timeMs >= firstTime && timeMs <= lastTime; }
+
+    // **Changes applied so far**
+    size_t applied() const { return appliedCount; }
+
+private:
+    static const size_t kReadRecords = 4096;
+
+    std::ifstream file;
+    std::vector<BookRecord> chunk;
+    size_t next = 0;
+    size_t appliedCount = 0;
+    long long firstTime = 0;
+    long long lastTime = -1;
+};
+
+#endif // !ORDERBOOK_H
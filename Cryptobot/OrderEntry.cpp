@@ -0,0 +1,332 @@
+// The SHA256_* functions are deprecated in OpenSSL 3, but unlike HMAC_CTX and EVP_MAC they let the padded key
+// states be copied without allocating
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include "OrderEntry.h"
+#include "ApiJournal.h"
+#include "config.h"
+#include "Metrics.h"
+#include "RateLimiter.h"
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+// Request the order connection with a cheap call when it has been idle this long, well within server idle timeouts
+static const long long kWarmIntervalSeconds = 30;
+
+// Longest time the lookup of an order with an unknown outcome may take, its retries included
+static const long long kOrderLookupDeadlineMs = 10000;
+
+// Longest time an order sent through apiRequest may take, its retries included, before the signal is too old to act on
+static const long long kOrderDeadlineMs = 5000;
+
+void HmacSha256::setKey(const string& key) {
+    unsigned char block[SHA256_CBLOCK] = {};
+    if (key.size() > SHA256_CBLOCK) SHA256(reinterpret_cast<const unsigned char*>(key.data()), key.size(), block);
+    else memcpy(block, key.data(), key.size());
+    unsigned char pad[SHA256_CBLOCK];
+    for (size_t i = 0; i < SHA256_CBLOCK; i++) pad[i] = block[i] ^ 0x36;
+    SHA256_Init(&inner);
+    SHA256_Update(&inner, pad, SHA256_CBLOCK);
+    for (size_t i = 0; i < SHA256_CBLOCK; i++) pad[i] = block[i] ^ 0x5c;
+    SHA256_Init(&outer);
+    SHA256_Update(&outer, pad, SHA256_CBLOCK);
+}
+
+// **Sign a message into a 32 byte digest**
+void HmacSha256::sign(const char* message, size_t length, unsigned char* digest) const {
+    SHA256_CTX context = inner;
+    SHA256_Update(&context, message, length);
+    SHA256_Final(digest, &context);
+    context = outer;
+    SHA256_Update(&context, digest, SHA256_DIGEST_LENGTH);
+    SHA256_Final(digest, &context);
+}
+
+// **Append a string to a buffer, returns the new end or nullptr if it does not fit**
+static char* appendChars(char* out, char* end, const char* text, size_t length) {
+    if (!out || static_cast<size_t>(end - out) < length) return nullptr;
+    memcpy(out, text, length);
+    return out + length;
+}
+
+OrderEntry::OrderEntry(const string& selectedMarket) : market(selectedMarket), idRandom(random_device()()) {
+    hmac.setKey(API_SECRET);
+    orderUrl = BASE_URL + "order";
+    timeUrl = BASE_URL + "time";
+    // Same key order as the json body apiRequest would send
+    buySuffix = "\",\"market\":\"" + market + "\",\"orderType\":\"market\",\"side\":\"buy\"}";
+    sellSuffix = "\",\"market\":\"" + market + "\",\"orderType\":\"market\",\"side\":\"sell\"}";
+    newClientOrderId();
+    keyHeader = "Bitvavo-Access-Key: " + API_KEY;
+    response.reserve(4096);
+    static char contentType[] = "Content-Type: application/json";
+    headers[0].data = &keyHeader[0];
+    headers[1].data = timestampHeader;
+    headers[2].data = signatureHeader;
+    headers[3].data = contentType;
+    headers[3].next = nullptr;
+    for (int i = 0; i < 3; i++) headers[i].next = &headers[i + 1];
+
+    curl = curl_easy_init();
+    if (!curl) {
+        cerr << "Failed to initialize CURL for order entry, orders go through apiRequest." << endl;
+        return;
+    }
+    curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 30L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 15L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, rateLimitData);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+}
+
+OrderEntry::~OrderEntry() {
+    if (curl) curl_easy_cleanup(curl);
+}
+
+// **Sign method, path and body at a timestamp into the timestamp and signature headers**
+void OrderEntry::sign(const char* method, const char* path, const char* requestBody, size_t bodyLength,
+    long long timestampMs) {
+    static const char kTimestampPrefix[] = "Bitvavo-Access-Timestamp: ";
+    static const char kSignaturePrefix[] = "Bitvavo-Access-Signature: ";
+    char* end = message + kMaxMessageSize;
+    char* out = to_chars(message, end, timestampMs).ptr;
+    size_t timestampLength = out - message;
+    out = appendChars(out, end, method, strlen(method));
+    out = appendChars(out, end, path, strlen(path));
+    out = appendChars(out, end, requestBody, bodyLength);
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    hmac.sign(message, out - message, digest);
+
+    memcpy(timestampHeader, kTimestampPrefix, sizeof(kTimestampPrefix) - 1);
+    memcpy(timestampHeader + sizeof(kTimestampPrefix) - 1, message, timestampLength);
+    timestampHeader[sizeof(kTimestampPrefix) - 1 + timestampLength] = '\0';
+    memcpy(signatureHeader, kSignaturePrefix, sizeof(kSignaturePrefix) - 1);
+    hexEncode(digest, SHA256_DIGEST_LENGTH, signatureHeader + sizeof(kSignaturePrefix) - 1);
+    signatureHeader[sizeof(kSignaturePrefix) - 1 + 2 * SHA256_DIGEST_LENGTH] = '\0';
+}
+
+// **Draw a new clientOrderId into its preallocated buffer**
+void OrderEntry::newClientOrderId() {
+    unsigned char bytes[16];
+    for (size_t i = 0; i < sizeof(bytes); i += 8) {
+        uint64_t value = idRandom();
+        memcpy(bytes + i, &value, 8);
+    }
+    bytes[6] = (bytes[6] & 0x0F) | 0x40; // Version 4
+    bytes[8] = (bytes[8] & 0x3F) | 0x80; // RFC 4122 variant
+    // 8-4-4-4-12 hex digits
+    static const size_t kGroups[] = { 4, 2, 2, 2, 6 };
+    char* out = orderId;
+    const unsigned char* in = bytes;
+    for (size_t group = 0; group < 5; group++) {
+        if (group > 0) *out++ = '-';
+        hexEncode(in, kGroups[group], out);
+        in += kGroups[group];
+        out += 2 * kGroups[group];
+    }
+    *out = '\0';
+}
+
+// **Write and sign a market order with a new clientOrderId in the preallocated buffers, returns false if it does not fit**
+// A buy spends amount in the quote currency, a sell sells amount of the base currency.
+bool OrderEntry::prepare(bool buy, double amount, long long timestampMs) {
+    static const char kBuyPrefix[] = "{\"amountQuote\":\"";
+    static const char kSellPrefix[] = "{\"amount\":\"";
+    static const char kClientOrderIdKey[] = "\",\"clientOrderId\":\"";
+    newClientOrderId();
+    char* end = bodyBuffer + kMaxBodySize - 1;
+    char* out = buy ? appendChars(bodyBuffer, end, kBuyPrefix, sizeof(kBuyPrefix) - 1)
+        : appendChars(bodyBuffer, end, kSellPrefix, sizeof(kSellPrefix) - 1);
+    // Six decimals, like the to_string amount of the json body
+    to_chars_result amountEnd = to_chars(out, end, amount, chars_format::fixed, 6);
+    if (amountEnd.ec != errc()) return false;
+    out = appendChars(amountEnd.ptr, end, kClientOrderIdKey, sizeof(kClientOrderIdKey) - 1);
+    out = appendChars(out, end, orderId, kClientOrderIdLength);
+    const string& suffix = buy ? buySuffix : sellSuffix;
+    out = appendChars(out, end, suffix.data(), suffix.size());
+    if (!out) return false;
+    *out = '\0';
+    bodyLength = out - bodyBuffer;
+    // The message is at most the body plus a timestamp, method and path
+    if (bodyLength + 48 > kMaxMessageSize) return false;
+    sign("POST", "/v2/order", bodyBuffer, bodyLength, timestampMs);
+    return true;
+}
+
+// **Send the prepared request, returns the HTTP code or 0 if the transfer failed**
+long OrderEntry::send(bool post) {
+    response.clear();
+    rateLimitData[0] = -1;
+    rateLimitData[1] = -1;
+    if (post) {
+        curl_easy_setopt(curl, CURLOPT_URL, orderUrl.c_str());
+        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, bodyBuffer);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(bodyLength));
+    }
+    else {
+        curl_easy_setopt(curl, CURLOPT_URL, timeUrl.c_str());
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    }
+    const long long sentAtMs = chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    CURLcode res = curl_easy_perform(curl);
+    lastError = res;
+    lastUse = chrono::steady_clock::now();
+    long http_code = 0;
+    curl_off_t totalMicroseconds = 0;
+    if (res == CURLE_OK) {
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &totalMicroseconds);
+        Metrics::instance().record(post ? LatencyMetric::ApiOrder : LatencyMetric::ApiTime,
+            static_cast<long long>(totalMicroseconds) * 1000);
+    }
+    else cerr << "Order entry curl_easy_perform() failed: " << curl_easy_strerror(res) << endl;
+    // Journaled like an apiRequest transfer, so a replayed order is served to apiRequest("order", "POST")
+    if (JournalWriter* journal = apiCapture()) {
+        JournalEntry entry;
+        entry.timeMs = sentAtMs;
+        entry.durationMicros = static_cast<long long>(totalMicroseconds);
+        entry.transportError = static_cast<int>(res);
+        entry.httpCode = http_code;
+        entry.rateLimitRemaining = rateLimitData[0];
+        entry.rateLimitResetAt = rateLimitData[1];
+        entry.method = post ? "POST" : "GET";
+        entry.endpoint = post ? "order" : "time";
+        if (post) entry.requestBody.assign(bodyBuffer, bodyLength);
+        entry.body = response;
+        journal->append(entry);
+    }
+    return http_code;
+}
+
+// **Place a market order, returns the exchange response or an empty json**
+// Orders the fast path cannot send, and all orders while apiRequest has another transport than the exchange, such
+// as a replayed journal or the mock exchange, go through apiRequest. So do orders the exchange did not take: the
+// connection could not be opened or the rate limit was hit. apiRequest only sends an order again in those cases.
+// An order that may have reached the exchange, a transfer that failed after connecting, a 5xx or a malformed
+// response, on either path, is looked up by its clientOrderId and never sent again.
+json OrderEntry::placeMarketOrder(bool buy, double amount) {
+    auto signalTime = chrono::steady_clock::now();
+    long long timestampMs = chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    // The order connection goes to the exchange, orders of a replay or the mock exchange take apiRequest's transport
+    if (!curl || !usingExchangeTransport() || !prepare(buy, amount, timestampMs)) {
+        newClientOrderId();
+        json order;
+        order[buy ? "amountQuote" : "amount"] = to_string(amount);
+        order["clientOrderId"] = orderId;
+        order["market"] = market;
+        order["orderType"] = "market";
+        order["side"] = buy ? "buy" : "sell";
+        return sendThroughApi(order.dump());
+    }
+    RateLimiter& limiter = RateLimiter::instance();
+    limiter.acquire(1, RequestPriority::Order);
+    signalToSendNanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - signalTime).count();
+    Metrics::instance().record(LatencyMetric::SignalToOrder, signalToSendNanos);
+    long http_code = send(true);
+    limiter.complete(1, rateLimitData[0], rateLimitData[1], http_code == 429);
+    if (http_code == 200 || http_code == 201) {
+        try {
+            return json::parse(response);
+        }
+        catch (const json::parse_error& e) {
+            cerr << "JSON parse error: " << e.what() << ". Response: " << response << endl;
+            return lookupOrder();
+        }
+    }
+    if (http_code == 401 || http_code == 403) {
+        cerr << "Fatal HTTP error " << http_code << " placing order. Not retrying." << endl;
+        return json{};
+    }
+    Metrics::instance().recordRetry(http_code);
+    if (http_code == 429 || (http_code == 0 && failedBeforeSending(lastError))) {
+        cerr << "Order entry could not send the order (" << (http_code == 429 ? "HTTP 429" : curl_easy_strerror(lastError))
+            << "). Retrying through apiRequest." << endl;
+        return sendThroughApi(string(bodyBuffer, bodyLength));
+    }
+    if (http_code == 0 || http_code >= 500) {
+        cerr << "Order entry lost the response to order " << orderId << " (";
+        if (http_code == 0) cerr << curl_easy_strerror(lastError);
+        else cerr << "HTTP " << http_code;
+        cerr << "). Looking it up instead of sending it again." << endl;
+        return lookupOrder();
+    }
+    cerr << "Order rejected with code: " << http_code << ". Response: " << response << endl;
+    return json{};
+}
+
+// **Look up the order with the last clientOrderId, returns it or an empty json if it was not placed or is unknown**
+json OrderEntry::lookupOrder() {
+    json order;
+    ApiRequest request("order?market=" + market + "&clientOrderId=" + orderId, "GET", "", RequestPriority::Order,
+        kOrderLookupDeadlineMs);
+    bool found = apiRequestParsed(request, [&order](const char* data, size_t size) {
+        order = json::parse(data, data + size, nullptr, false);
+        return order.is_object();
+    });
+    if (!found || !order.contains("orderId")) {
+        cerr << "Order " << orderId << " was not found on the exchange. It is not sent again; check the open orders "
+            "and balances if it shows up later." << endl;
+        return json{};
+    }
+    if (order.value("status", "") == "rejected") {
+        cerr << "Order " << orderId << " was rejected by the exchange." << endl;
+        return json{};
+    }
+    cout << "Order " << orderId << " was placed, its response was lost." << endl;
+    return order;
+}
+
+// **Send an order body through apiRequest, returns the exchange response, the looked up order or an empty json**
+json OrderEntry::sendThroughApi(const string& orderBody) {
+    json order;
+    bool outcomeUnknown = false;
+    bool placed = apiRequestParsed(ApiRequest("order", "POST", orderBody, RequestPriority::Order, kOrderDeadlineMs),
+        [&order](const char* data, size_t size) {
+            order = json::parse(data, data + size, nullptr, false);
+            return !order.is_discarded();
+        }, outcomeUnknown);
+    if (placed) return order;
+    if (outcomeUnknown) return lookupOrder();
+    return json{};
+}
+
+// **Open the order connection, or keep it open with a cheap request when it has been idle**
+// Skipped without waiting for budget when the rate limit has none left, the next call tries again.
+void OrderEntry::keepWarm() {
+    if (!curl || !usingExchangeTransport()) return;
+    auto now = chrono::steady_clock::now();
+    if (lastUse.time_since_epoch().count() != 0
+        && chrono::duration_cast<chrono::seconds>(now - lastUse).count() < kWarmIntervalSeconds) return;
+    long long timestampMs = chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    RateLimiter& limiter = RateLimiter::instance();
+    if (!limiter.tryAcquire(1, RequestPriority::MarketData)) return;
+    sign("GET", "/v2/time", "", 0, timestampMs);
+    long http_code = send(false);
+    limiter.complete(1, rateLimitData[0], rateLimitData[1], http_code == 429);
+}
+
+// **Nanoseconds from the placeMarketOrder call to handing the request to the connection, of the last order**
+long long OrderEntry::lastSignalToSendNanos() const {
+    return signalToSendNanos;
+}
+
+// **Body of the last prepared order**
+const char* OrderEntry::body() const {
+    return bodyBuffer;
+}
+
+// **clientOrderId of the last order, a version 4 UUID**
+const char* OrderEntry::clientOrderId() const {
+    return orderId;
+}
@@ -0,0 +1,105 @@
+#ifndef ORDERENTRY_H
+#define ORDERENTRY_H
+
+#include "API_Handling.h"
+#include <chrono>
+#include <random>
+#include <string>
+#include <curl/curl.h>
+#include <openssl/sha.h>
+
+// **HMAC-SHA256 with the key padding hashed once**
+// The inner and outer hash states after the padded key are kept, so signing a message only hashes the message
+// and copies two plain structs, without allocating.
+class HmacSha256 {
+public:
+    void setKey(const std::string& key);
+
+    // **Sign a message into a 32 byte digest**
+    void sign(const char* message, size_t length, unsigned char* digest) const;
+
+private:
+    SHA256_CTX inner;
+    SHA256_CTX outer;
+};
+
+// **Dedicated low-latency order entry for one market**
+// Market orders are written into a preallocated body, signed with a reused HMAC key schedule and sent over a
+// connection of their own that is kept warm, so nothing is allocated between the signal and the send. Every order
+// carries a new clientOrderId, so an order whose outcome is unknown can be looked up instead of sent again.
+class OrderEntry {
+public:
+    explicit OrderEntry(const std::string& selectedMarket);
+    ~OrderEntry();
+    OrderEntry(const OrderEntry&) = delete;
+    OrderEntry& operator=(const OrderEntry&) = delete;
+
+    // **Write and sign a market order with a new clientOrderId in the preallocated buffers, returns false if it does not fit**
+    // A buy spends amount in the quote currency, a sell sells amount of the base currency.
+    bool prepare(bool buy, double amount, long long timestampMs);
+
+    // **Place a market order, returns the exchange response or an empty json**
+    // Orders the fast path cannot send, and all orders while apiRequest has another transport than the exchange, such
+    // as a replayed journal or the mock exchange, go through apiRequest. So do orders the exchange did not take: the
+    // connection could not be opened or the rate limit was hit. apiRequest only sends an order again in those cases.
+    // An order that may have reached the exchange, a transfer that failed after connecting, a 5xx or a malformed
+    // response, on either path, is looked up by its clientOrderId and never sent again.
+    json placeMarketOrder(bool buy, double amount);
+
+    // **Open the order connection, or keep it open with a cheap request when it has been idle**
+    // Skipped without waiting for budget when the rate limit has none left, the next call tries again.
+    void keepWarm();
+
+    // **Nanoseconds from the placeMarketOrder call to handing the request to the connection, of the last order**
+    long long lastSignalToSendNanos() const;
+
+    // **Body of the last prepared order**
+    const char* body() const;
+
+    // **clientOrderId of the last order, a version 4 UUID**
+    const char* clientOrderId() const;
+
+private:
+    static const size_t kMaxBodySize = 256;
+    static const size_t kMaxMessageSize = 320;
+    static const size_t kClientOrderIdLength = 36;
+
+    // **Send the prepared request, returns the HTTP code or 0 if the transfer failed**
+    long send(bool post);
+
+    // **Draw a new clientOrderId into its preallocated buffer**
+    void newClientOrderId();
+
+    // **Look up the order with the last clientOrderId, returns it or an empty json if it was not placed or is unknown**
+    json lookupOrder();
+
+    // **Send an order body through apiRequest, returns the exchange response, the looked up order or an empty json**
+    json sendThroughApi(const std::string& orderBody);
+
+    // **Sign method, path and body at a timestamp into the timestamp and signature headers**
+    void sign(const char* method, const char* path, const char* requestBody, size_t bodyLength, long long timestampMs);
+
+    std::string market;
+    CURL* curl = nullptr;
+    HmacSha256 hmac;
+    std::string orderUrl;
+    std::string timeUrl;
+    std::string buySuffix;  // Body after the clientOrderId of a buy
+    std::string sellSuffix; // Body after the clientOrderId of a sell
+    std::string keyHeader;
+    std::string response;
+    char bodyBuffer[kMaxBodySize] = {};
+    size_t bodyLength = 0;
+    char message[kMaxMessageSize] = {};
+    char timestampHeader[64] = {};
+    char signatureHeader[96] = {};
+    char orderId[kClientOrderIdLength + 1] = {};
+    std::mt19937_64 idRandom;
+    CURLcode lastError = CURLE_OK; // Transport error of the last send
+    curl_slist headers[4];
+    long long rateLimitData[2] = { -1, -1 };
+    long long signalToSendNanos = 0;
+    std::chrono::steady_clock::time_point lastUse;
+};
+
+#endif // !ORDERENTRY_H
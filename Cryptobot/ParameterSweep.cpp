@@ -0,0 +1,385 @@
+#include "ParameterSweep.h"
+#include "Backtest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <tuple>
+
+using namespace std;
+
+// Points handed out per task, small enough to balance, large enough to amortize the stealing
+static const size_t kPointsPerTask = 32;
+
+// Simulated starting balance, the same as the bot's simulation mode
+static const double kInitialBalance = 1000.0;
+
+const char* const ParameterSweep::kParameterNames[ParameterSweep::kDimensions] = {
+    "rsiBuy", "rsiSell", "bbPeriod", "bbStdDev", "macdFast", "macdSlow", "macdSignal", "maxPositionPercent"
+};
+
+// **Sweep point from one value per dimension, in the order of kParameterNames**
+static SweepPoint toPoint(const array<double, ParameterSweep::kDimensions>& values) {
+    SweepPoint point;
+    point.strategy.rsiBuy = values[0];
+    point.strategy.rsiSell = values[1];
+    point.strategy.indicators.bbPeriod = static_cast<int>(lround(values[2]));
+    point.strategy.indicators.bbStdDev = values[3];
+    point.strategy.indicators.macdFast = static_cast<int>(lround(values[4]));
+    point.strategy.indicators.macdSlow = static_cast<int>(lround(values[5]));
+    point.strategy.indicators.macdSignal = static_cast<int>(lround(values[6]));
+    point.maxPositionSize = values[7] / 100.0;
+    return point;
+}
+
+// **False for periods the indicator engine cannot compute or position sizes the bot would reject**
+static bool isValidPoint(const SweepPoint& point) {
+    const IndicatorParameters& ind = point.strategy.indicators;
+    return ind.bbPeriod >= 2 && ind.bbPeriod <= IndicatorEngine::kMaxBBPeriod
+        && ind.macdFast >= 1 && ind.macdFast < ind.macdSlow && ind.macdSignal >= 1
+        && point.maxPositionSize > 0.0 && point.maxPositionSize <= 1.0;
+}
+
+// **Round a sampled value to the step of its range, staying inside the range**
+static double snapToStep(const ParameterRange& range, double value) {
+    if (range.step > 0) value = range.min + round((value - range.min) / range.step) * range.step;
+    return min(max(value, range.min), range.max);
+}
+
+// **Strict ordering on indicator periods, so points sharing them are replayed back to back**
+static bool indicatorsBefore(const IndicatorParameters& a, const IndicatorParameters& b) {
+    return tie(a.bbPeriod, a.bbStdDev, a.macdFast, a.macdSlow, a.macdSignal)
+        < tie(b.bbPeriod, b.bbStdDev, b.macdFast, b.macdSlow, b.macdSignal);
+}
+
+// **Range of tasks owned by one worker, the owner takes from the front and thieves from the back**
+struct WorkRange {
+    mutex lock;
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+// **Take the next task of a worker, stealing half of another worker's remaining tasks when it has none**
+static bool takeTask(vector<WorkRange>& ranges, size_t self, size_t& task) {
+    {
+        lock_guard<mutex> lock(ranges[self].lock);
+        if (ranges[self].begin < ranges[self].end) {
+            task = ranges[self].begin++;
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < ranges.size(); offset++) {
+        WorkRange& victim = ranges[(self + offset) % ranges.size()];
+        size_t stolenBegin, stolenEnd;
+        {
+            lock_guard<mutex> lock(victim.lock);
+            size_t remaining = victim.end - victim.begin;
+            if (remaining == 0) continue;
+            stolenEnd = victim.end;
+            stolenBegin = victim.end - (remaining + 1) / 2;
+            victim.end = stolenBegin;
+        }
+        lock_guard<mutex> lock(ranges[self].lock);
+        ranges[self].begin = stolenBegin + 1;
+        ranges[self].end = stolenEnd;
+        task = stolenBegin;
+        return true;
+    }
+    return false;
+}
+
+ParameterSweep::ParameterSweep(const string& selectedMarket) : market(selectedMarket) {
+    SweepPoint defaults;
+    const array<double, kDimensions> values = {
+        defaults.strategy.rsiBuy, defaults.strategy.rsiSell,
+        static_cast<double>(defaults.strategy.indicators.bbPeriod), defaults.strategy.indicators.bbStdDev,
+        static_cast<double>(defaults.strategy.indicators.macdFast), static_cast<double>(defaults.strategy.indicators.macdSlow),
+        static_cast<double>(defaults.strategy.indicators.macdSignal), defaults.maxPositionSize * 100.0
+    };
+    for (size_t d = 0; d < kDimensions; d++) ranges[d] = { values[d], values[d], 0.0 };
+}
+
+// **Read name=value or name=min:max:step lines, parameters that are not listed keep their default**
+bool ParameterSweep::loadRanges(const string& filename) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Failed to open " << filename << " for reading." << endl;
+        return false;
+    }
+    string line;
+    while (getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        line.erase(remove_if(line.begin(), line.end(), [](char c) { return isspace(static_cast<unsigned char>(c)); }), line.end());
+        if (line.empty()) continue;
+        size_t pos = line.find('=');
+        const char* const* name = find(begin(kParameterNames), end(kParameterNames), line.substr(0, pos));
+        if (pos == string::npos || name == end(kParameterNames)) {
+            cerr << "Unknown sweep parameter: " << line << endl;
+            return false;
+        }
+        double numbers[3] = {};
+        int count = 0;
+        const char* cursor = line.c_str() + pos + 1;
+        while (count < 3) {
+            char* next = nullptr;
+            numbers[count] = strtod(cursor, &next);
+            if (next == cursor) break;
+            count++;
+            if (*next != ':') {
+                cursor = next;
+                break;
+            }
+            cursor = next + 1;
+        }
+        if (*cursor != '\0' || (count != 1 && count != 3)) {
+            cerr << "Expected value or min:max:step for sweep parameter: " << line << endl;
+            return false;
+        }
+        ParameterRange& range = ranges[name - begin(kParameterNames)];
+        range = count == 1 ? ParameterRange{ numbers[0], numbers[0], 0.0 } : ParameterRange{ numbers[0], numbers[1], numbers[2] };
+        if (range.max < range.min) swap(range.min, range.max);
+    }
+    return true;
+}
+
+// **Load and align the candle archives, returns false if 5m, 15m or 1h is missing**
+bool ParameterSweep::loadCandles() {
+    if (!loadCandleArchives(market, history)) return false;
+    Interval driver = clockInterval(history);
+    const CandleHistory& clock = history[intervalIndex(driver)];
+    const long long driverMillis = intervalMillis(driver);
+    clockClose = clock.close;
+
+    // The newest candle of each interval that has closed at every clock step, as the backtest feeds them
+    firstReadyStep = 0;
+    for (Interval interval : { Interval::M5, Interval::M15, Interval::H1 }) {
+        const CandleHistory& candles = history[intervalIndex(interval)];
+        const long long millis = intervalMillis(interval);
+        vector<int>& closed = closedIndex[intervalIndex(interval)];
+        closed.resize(clock.size());
+        size_t n = 0;
+        for (size_t step = 0; step < clock.size(); step++) {
+            long long closeTime = clock.timestamp[step] + driverMillis;
+            while (n < candles.size() && candles.timestamp[n] + millis <= closeTime) n++;
+            closed[step] = static_cast<int>(n) - 1;
+        }
+        size_t ready = find_if(closed.begin(), closed.end(), [](int index) { return index >= 0; }) - closed.begin();
+        firstReadyStep = max(firstReadyStep, ready);
+    }
+    return true;
+}
+
+// **Points of the sweep, invalid combinations (such as a fast MACD period above the slow one) are skipped**
+vector<SweepPoint> ParameterSweep::points(SweepMode mode, size_t samples, unsigned seed) const {
+    vector<SweepPoint> result;
+    size_t skipped = 0;
+    auto add = [&](const array<double, kDimensions>& values) {
+        SweepPoint point = toPoint(values);
+        if (isValidPoint(point)) result.push_back(point);
+        else skipped++;
+    };
+
+    if (mode == SweepMode::Grid) {
+        array<vector<double>, kDimensions> axes;
+        size_t total = 1;
+        for (size_t d = 0; d < kDimensions; d++) {
+            const ParameterRange& range = ranges[d];
+            axes[d].push_back(range.min);
+            if (range.step > 0) {
+                for (size_t k = 1; range.min + k * range.step <= range.max + range.step * 1e-9; k++) {
+                    axes[d].push_back(range.min + k * range.step);
+                }
+            }
+            total *= axes[d].size();
+        }
+        result.reserve(total);
+        array<size_t, kDimensions> position = {};
+        array<double, kDimensions> values;
+        for (size_t n = 0; n < total; n++) {
+            for (size_t d = 0; d < kDimensions; d++) values[d] = axes[d][position[d]];
+            add(values);
+            for (size_t d = 0; d < kDimensions && ++position[d] == axes[d].size(); d++) position[d] = 0;
+        }
+    }
+    else {
+        mt19937_64 rng(seed);
+        uniform_real_distribution<double> unit(0.0, 1.0);
+        // Latin hypercube: every dimension is cut into samples strata and each stratum is used exactly once
+        array<vector<size_t>, kDimensions> strata;
+        if (mode == SweepMode::LatinHypercube) {
+            for (auto& order : strata) {
+                order.resize(samples);
+                iota(order.begin(), order.end(), 0);
+                shuffle(order.begin(), order.end(), rng);
+            }
+        }
+        array<double, kDimensions> values;
+        for (size_t n = 0; n < samples; n++) {
+            for (size_t d = 0; d < kDimensions; d++) {
+                double fraction = mode == SweepMode::LatinHypercube
+                    ? (strata[d][n] + unit(rng)) / samples : unit(rng);
+                values[d] = snapToStep(ranges[d], ranges[d].min + fraction * (ranges[d].max - ranges[d].min));
+            }
+            add(values);
+        }
+    }
+    if (skipped > 0) cout << "Skipped " << skipped << " invalid parameter combinations" << endl;
+    return result;
+}
+
+// **Strategy indicators of an interval as the bot sees them when each candle closes**
+ParameterSweep::SignalSeries ParameterSweep::signalIndicators(Interval interval, const IndicatorParameters& parameters) const {
+    const CandleHistory& candles = history[intervalIndex(interval)];
+    Strategy::Indicators engine(parameters);
+    SignalSeries indicators(candles.size());
+    engine.updateBatch(candles.high.data(), candles.low.data(), candles.close.data(), candles.size(), indicators.data());
+    // The bot reports no signal line until the history holds signalWarmup candles
+    for (size_t i = 0; i + 1 < engine.signalWarmup() && i < indicators.size(); i++) {
+        MacdIndicator::Value& macd = indicators[i].get<MacdIndicator>();
+        macd.signal = 0.0;
+        macd.hist = 0.0;
+    }
+    return indicators;
+}
+
+// **Replay one point against the precomputed indicators of the strategy timeframes**
+// Mirrors CryptoTradingBot::evaluateSignals and the simulated fills of placeMarketOrder.
+SweepResult ParameterSweep::replay(const SweepPoint& point, const array<SignalSeries, kIntervalCount>& indicators) const {
+    SweepResult result;
+    result.point = point;
+    const StrategyParameters& strategy = point.strategy;
+    size_t step = firstReadyStep;
+    auto latest = [&](Interval interval) -> const Strategy::Indicators::Values& {
+        const size_t index = intervalIndex(interval);
+        return indicators[index][closedIndex[index][step]];
+    };
+
+    double fiatBalance = kInitialBalance;
+    double cryptoBalance = 0.0;
+    double entryPrice = 0.0;
+    double peakValue = kInitialBalance;
+    for (; step < clockClose.size(); step++) {
+        const double tickerPrice = clockClose[step];
+        if (cryptoBalance < 1e-8 && fiatBalance > 50) {
+            if (allTimeframes<Strategy>([&](Interval interval) {
+                return Strategy::buy(latest(interval), tickerPrice, strategy);
+            })) {
+                double amount = point.maxPositionSize * fiatBalance;
+                cryptoBalance += amount / tickerPrice;
+                fiatBalance -= amount;
+                entryPrice = tickerPrice;
+                result.trades++;
+            }
+        }
+        else if (cryptoBalance > 0.00001 && entryPrice > 0 && allTimeframes<Strategy>([&](Interval interval) {
+            return Strategy::sell(latest(interval), tickerPrice, strategy);
+        })) {
+            fiatBalance += cryptoBalance * tickerPrice;
+            result.totalProfitLoss += (tickerPrice - entryPrice) * cryptoBalance;
+            cryptoBalance = 0.0;
+            entryPrice = 0.0;
+            result.trades++;
+        }
+        double value = fiatBalance + cryptoBalance * tickerPrice;
+        if (value > peakValue) peakValue = value;
+        else result.maxDrawdownPercent = max(result.maxDrawdownPercent, (peakValue - value) / peakValue * 100.0);
+    }
+    result.finalValue = fiatBalance + cryptoBalance * (clockClose.empty() ? 0.0 : clockClose.back());
+    return result;
+}
+
+// **Backtest every point, returns the results ranked by final value**
+vector<SweepResult> ParameterSweep::run(const vector<SweepPoint>& points, unsigned workerCount) const {
+    vector<SweepResult> results(points.size());
+    if (points.empty()) return results;
+    if (workerCount == 0) workerCount = 1;
+
+    // Replay points that share indicator periods back to back, so their indicators are computed once
+    vector<size_t> order(points.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return indicatorsBefore(points[a].strategy.indicators, points[b].strategy.indicators);
+    });
+
+    const size_t taskCount = (points.size() + kPointsPerTask - 1) / kPointsPerTask;
+    vector<WorkRange> ranges(workerCount);
+    for (size_t w = 0; w < workerCount; w++) {
+        ranges[w].begin = taskCount * w / workerCount;
+        ranges[w].end = taskCount * (w + 1) / workerCount;
+    }
+
+    atomic<size_t> done{ 0 };
+    auto worker = [&](size_t self) {
+        array<SignalSeries, kIntervalCount> indicators;
+        IndicatorParameters cached;
+        bool haveIndicators = false;
+        size_t task;
+        while (takeTask(ranges, self, task)) {
+            size_t last = min((task + 1) * kPointsPerTask, points.size());
+            for (size_t n = task * kPointsPerTask; n < last; n++) {
+                const SweepPoint& point = points[order[n]];
+                if (!haveIndicators || point.strategy.indicators != cached) {
+                    allTimeframes<Strategy>([&](Interval interval) {
+                        indicators[intervalIndex(interval)] = signalIndicators(interval, point.strategy.indicators);
+                        return true;
+                    });
+                    cached = point.strategy.indicators;
+                    haveIndicators = true;
+                }
+                results[order[n]] = replay(point, indicators);
+            }
+            done += last - task * kPointsPerTask;
+        }
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (size_t w = 0; w < workerCount; w++) workers.emplace_back(worker, w);
+    auto lastReport = start;
+    while (done < points.size()) {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        auto now = chrono::steady_clock::now();
+        if (now - lastReport >= chrono::seconds(5)) {
+            cout << "Swept " << done << "/" << points.size() << " points" << endl;
+            lastReport = now;
+        }
+    }
+    for (auto& t : workers) t.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Swept " << points.size() << " points over " << clockClose.size() << " clock steps in " << seconds
+        << " s on " << workerCount << " worker(s)" << endl;
+
+    stable_sort(results.begin(), results.end(),
+        [](const SweepResult& a, const SweepResult& b) { return a.finalValue > b.finalValue; });
+    return results;
+}
+
+// **Write the ranked results as CSV**
+bool ParameterSweep::writeResults(const vector<SweepResult>& ranked, const string& filename) const {
+    ofstream file(filename, ios::trunc);
+    if (!file.is_open()) {
+        cerr << "Failed to open " << filename << " for writing." << endl;
+        return false;
+    }
+    file << "rank";
+    for (const char* name : kParameterNames) file << "," << name;
+    file << ",trades,totalProfitLoss,finalValue,returnPercent,maxDrawdownPercent\n";
+    for (size_t rank = 0; rank < ranked.size(); rank++) {
+        const SweepResult& r = ranked[rank];
+        const StrategyParameters& s = r.point.strategy;
+        file << rank + 1 << "," << s.rsiBuy << "," << s.rsiSell << "," << s.indicators.bbPeriod << ","
+            << s.indicators.bbStdDev << "," << s.indicators.macdFast << "," << s.indicators.macdSlow << ","
+            << s.indicators.macdSignal << "," << r.point.maxPositionSize * 100.0 << "," << r.trades << ","
+            << r.totalProfitLoss << "," << r.finalValue << "," << (r.finalValue / kInitialBalance - 1.0) * 100.0 << ","
+            << r.maxDrawdownPercent << "\n";
+    }
+    cout << "Wrote " << ranked.size() << " ranked results to " << filename << endl;
+    return true;
+}
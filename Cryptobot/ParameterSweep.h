@@ -0,0 +1,82 @@
+#ifndef PARAMETERSWEEP_H
+#define PARAMETERSWEEP_H
+
+#include "CandleStore.h"
+#include "Strategy.h"
+#include <array>
+#include <string>
+#include <vector>
+
+// **How sweep points are chosen from the parameter ranges**
+enum class SweepMode { Grid, Random, LatinHypercube };
+
+// **Range of one swept parameter, a single value when min == max**
+// A grid walks from min to max in steps, random and Latin hypercube samples are snapped to the step if it is set.
+struct ParameterRange {
+    double min = 0.0;
+    double max = 0.0;
+    double step = 0.0;
+};
+
+// **Parameters of one backtest in a sweep**
+struct SweepPoint {
+    StrategyParameters strategy;
+    double maxPositionSize = 0.25;
+};
+
+// **Outcome of one sweep point**
+struct SweepResult {
+    SweepPoint point;
+    size_t trades = 0;
+    double totalProfitLoss = 0.0;
+    double finalValue = 0.0;         // Simulated fiat plus crypto at the last price, starting from 1000
+    double maxDrawdownPercent = 0.0; // Largest drop of the value from its previous peak
+};
+
+// **Backtests many strategy parameter sets over the candle archives of a market on all cores**
+// The archives are parsed once and shared read-only by every worker. The signal indicators only depend on
+// the indicator periods, so each worker computes them once per period set and then replays the thresholds
+// and position sizes that share it. Points are split over the workers, and an idle worker steals half of
+// the remaining points of a busy one.
+class ParameterSweep {
+public:
+    static const size_t kDimensions = 8;
+    static const char* const kParameterNames[kDimensions];
+
+    explicit ParameterSweep(const std::string& market);
+
+    // **Read name=value or name=min:max:step lines, parameters that are not listed keep their default**
+    bool loadRanges(const std::string& filename);
+
+    // **Load and align the candle archives, returns false if 5m, 15m or 1h is missing**
+    bool loadCandles();
+
+    // **Points of the sweep, invalid combinations (such as a fast MACD period above the slow one) are skipped**
+    std::vector<SweepPoint> points(SweepMode mode, size_t samples, unsigned seed) const;
+
+    // **Backtest every point, returns the results ranked by final value**
+    std::vector<SweepResult> run(const std::vector<SweepPoint>& points, unsigned workerCount) const;
+
+    // **Write the ranked results as CSV**
+    bool writeResults(const std::vector<SweepResult>& ranked, const std::string& filename) const;
+
+private:
+    // Strategy the sweep replays, only the indicators its conditions read are computed and kept
+    using Strategy = MultiTimeframeStrategy;
+    using SignalSeries = std::vector<Strategy::Indicators::Values>;
+
+    std::string market;
+    std::array<ParameterRange, kDimensions> ranges;
+    std::array<CandleHistory, kIntervalCount> history; // Index: interval, Value: archived candles
+    std::vector<double> clockClose;                    // Close of every candle of the clock interval
+    std::array<std::vector<int>, kIntervalCount> closedIndex; // Index: interval, Value: newest closed candle per clock step, -1 if none
+    size_t firstReadyStep = 0;                         // First clock step with a closed 5m, 15m and 1h candle
+
+    // **Strategy indicators of an interval as the bot sees them when each candle closes**
+    SignalSeries signalIndicators(Interval interval, const IndicatorParameters& parameters) const;
+
+    // **Replay one point against the precomputed indicators of the strategy timeframes**
+    SweepResult replay(const SweepPoint& point, const std::array<SignalSeries, kIntervalCount>& indicators) const;
+};
+
+#endif // !PARAMETERSWEEP_H
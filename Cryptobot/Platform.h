@@ -0,0 +1,51 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <cstdio>
+#include <ctime>
+#include <string>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// **MSVC's thread-safe localtime_s and gmtime_s, on POSIX where they are called localtime_r and gmtime_r**
+#ifndef _WIN32
+inline int localtime_s(std::tm* result, const std::time_t* time) {
+    return localtime_r(time, result) ? 0 : -1;
+}
+
+inline int gmtime_s(std::tm* result, const std::time_t* time) {
+    return gmtime_r(time, result) ? 0 : -1;
+}
+#endif
+
+// **Flush a file's data to disk, returns 0 on success**
+inline int syncFile(std::FILE* file) {
+#ifdef _WIN32
+    return _commit(_fileno(file));
+#elif defined(__linux__)
+    return fdatasync(fileno(file));
+#else
+    return fsync(fileno(file));
+#endif
+}
+
+// **Flush a directory's entries to disk, so a rename into it survives a crash, returns 0 on success**
+// NTFS journals renames itself, so this does nothing on Windows.
+inline int syncDirectory(const std::string& directory) {
+#ifdef _WIN32
+    (void)directory;
+    return 0;
+#else
+    int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+    if (fd < 0) return -1;
+    int result = fsync(fd);
+    close(fd);
+    return result;
+#endif
+}
+
+#endif // !PLATFORM_H
@@ -0,0 +1,137 @@
+#include "RateLimiter.h"
+#include "config.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+// Length of a rate limit window, used until a response reports when the window resets
+static const long long kWindowMillis = 60 * 1000;
+
+// Weight market data requests leave untouched, so orders still go through when the budget runs low
+static const long long kOrderReserve = 20;
+
+// Wait this long past the reported reset before refilling, to absorb clock skew with the exchange
+static const long long kResetMarginMillis = 250;
+
+// **Current time in milliseconds since the epoch, the clock of the resetat header**
+static long long nowMillis() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+RateLimiter& RateLimiter::instance() {
+    static RateLimiter limiter;
+    return limiter;
+}
+
+RateLimiter::RateLimiter() : budget(RATE_LIMIT_BUDGET), tokens(RATE_LIMIT_BUDGET) {
+}
+
+// **Weight of a request, unknown endpoints weigh 1**
+// Balance, order lists and trade history are the heavier endpoints of the Bitvavo API.
+int RateLimiter::endpointWeight(const string& endpoint, const string& method) {
+    auto startsWith = [&](const char* prefix) { return endpoint.compare(0, char_traits<char>::length(prefix), prefix) == 0; };
+    if (startsWith("balance")) return 5;
+    if (method == "GET" && (startsWith("orders") || startsWith("trades") || endpoint.find("/trades") != string::npos)) return 5;
+    return 1;
+}
+
+// **Priority of a request, anything that is not a GET is treated as order placement**
+RequestPriority RateLimiter::requestPriority(const string& method) {
+    return method == "GET" ? RequestPriority::MarketData : RequestPriority::Order;
+}
+
+// **Start a new window once the current one has passed**
+void RateLimiter::refillIfReset(long long now) {
+    if (resetAt == 0) {
+        resetAt = now + kWindowMillis;
+        return;
+    }
+    if (now < resetAt + kResetMarginMillis) return;
+    tokens = budget - inFlight;
+    // The exchange reports the real end of the new window with the next response
+    resetAt = now + kWindowMillis;
+    resetKnown = false;
+}
+
+// **Block until the weight is available, then take it**
+void RateLimiter::acquire(int weight, RequestPriority priority) {
+    unique_lock<mutex> guard(lock);
+    const bool isOrder = priority == RequestPriority::Order;
+    const long long reserve = isOrder ? 0 : kOrderReserve;
+    if (isOrder) ordersWaiting++;
+    bool waited = false;
+    while (true) {
+        long long now = nowMillis();
+        refillIfReset(now);
+        if ((isOrder || ordersWaiting == 0) && tokens - weight >= reserve) break;
+        if (!waited) {
+            throttled++;
+            waited = true;
+        }
+        // Woken early when a response resynchronizes the bucket or an order has gone through
+        long long waitMillis = max(resetAt + kResetMarginMillis - now, 1LL);
+        released.wait_for(guard, chrono::milliseconds(waitMillis));
+    }
+    if (isOrder) {
+        ordersWaiting--;
+        if (ordersWaiting == 0) released.notify_all();
+    }
+    tokens -= weight;
+    inFlight += weight;
+}
+
+// **Take the weight if it is available now, returns false without waiting if it is not**
+// A request that is turned away counts as throttled, and market data still leaves the reserve and yields to a
+// waiting order.
+bool RateLimiter::tryAcquire(int weight, RequestPriority priority, long long* retryAtMs) {
+    lock_guard<mutex> guard(lock);
+    const bool isOrder = priority == RequestPriority::Order;
+    const long long reserve = isOrder ? 0 : kOrderReserve;
+    refillIfReset(nowMillis());
+    if (!(isOrder || ordersWaiting == 0) || tokens - weight < reserve) {
+        throttled++;
+        if (retryAtMs) *retryAtMs = resetAt + kResetMarginMillis;
+        return false;
+    }
+    tokens -= weight;
+    inFlight += weight;
+    return true;
+}
+
+// **Return the result of a request taken with acquire or tryAcquire, remaining and resetAt are -1 if the headers were missing**
+void RateLimiter::complete(int weight, long long remaining, long long reportedResetAt, bool tooMany) {
+    {
+        lock_guard<mutex> guard(lock);
+        inFlight -= weight;
+        long long now = nowMillis();
+        if (tooMany) {
+            // Out of budget until the window resets
+            tooManyRequests++;
+            tokens = 0;
+            resetAt = reportedResetAt > now ? reportedResetAt : max(resetAt, now + 1000);
+            resetKnown = reportedResetAt > now;
+        }
+        else if (remaining >= 0 && reportedResetAt > now) {
+            // Requests still in flight may not be counted in remaining yet
+            long long reported = remaining - inFlight;
+            if (!resetKnown || reportedResetAt > resetAt) tokens = reported;
+            else tokens = min(tokens, reported);
+            if (remaining > budget) budget = remaining;
+            resetAt = reportedResetAt;
+            resetKnown = true;
+        }
+    }
+    released.notify_all();
+}
+
+RateLimitStats RateLimiter::stats() {
+    lock_guard<mutex> guard(lock);
+    RateLimitStats result;
+    result.available = tokens;
+    result.budget = budget;
+    result.resetAt = resetAt;
+    result.throttled = throttled;
+    result.tooManyRequests = tooManyRequests;
+    return result;
+}
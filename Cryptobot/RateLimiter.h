@@ -0,0 +1,64 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+// **Request priority, orders are let through before market data when the budget runs short**
+// Ticker reads are sent and retried ahead of the other market data, which they share the budget with.
+enum class RequestPriority { Order, Ticker, MarketData };
+
+// **Snapshot of the rate limiter state**
+struct RateLimitStats {
+    long long available = 0;       // Weight that can still be spent in the current window
+    long long budget = 0;          // Weight per window
+    long long resetAt = 0;         // End of the current window in milliseconds since the epoch
+    long long throttled = 0;       // Requests that had to wait for budget
+    long long tooManyRequests = 0; // HTTP 429 responses received
+};
+
+// **Thread-safe weighted token bucket in front of the Bitvavo REST API**
+// Every request takes its endpoint weight from the bucket before it is sent. The bitvavo-ratelimit-remaining and
+// bitvavo-ratelimit-resetat headers of each response resynchronize the bucket with the exchange, and the bucket
+// is refilled when the exchange's window resets. Market data requests leave a reserve for orders and wait while
+// an order is waiting, so order placement is never starved by candle fetches.
+class RateLimiter {
+public:
+    static RateLimiter& instance();
+
+    // **Weight of a request, unknown endpoints weigh 1**
+    static int endpointWeight(const std::string& endpoint, const std::string& method);
+
+    // **Priority of a request, anything that is not a GET is treated as order placement**
+    static RequestPriority requestPriority(const std::string& method);
+
+    // **Block until the weight is available, then take it**
+    void acquire(int weight, RequestPriority priority);
+
+    // **Take the weight if it is available now, returns false without waiting if it is not**
+    // retryAtMs, if given, receives the time in milliseconds since the epoch at which the window resets.
+    bool tryAcquire(int weight, RequestPriority priority, long long* retryAtMs = nullptr);
+
+    // **Return the result of a request taken with acquire or tryAcquire, remaining and resetAt are -1 if the headers were missing**
+    void complete(int weight, long long remaining, long long resetAt, bool tooManyRequests);
+
+    RateLimitStats stats();
+
+private:
+    RateLimiter();
+    void refillIfReset(long long nowMs);
+
+    std::mutex lock;
+    std::condition_variable released;
+    long long budget;
+    long long tokens;
+    long long resetAt = 0;      // End of the current window, estimated until a response reports it
+    bool resetKnown = false;    // True once resetAt comes from a response header
+    long long inFlight = 0;     // Weight of requests sent but not completed
+    int ordersWaiting = 0;
+    long long throttled = 0;
+    long long tooManyRequests = 0;
+};
+
+#endif // !RATELIMITER_H
@@ -0,0 +1,406 @@
+#include "ResponseParsers.h"
+#include <cctype>
+#include <charconv>
+#include <cstring>
+
+using namespace std;
+
+// Deepest nesting the parsers skip over, deeper bodies count as malformed
+static const int kMaxDepth = 64;
+
+// **A string or number value as it appears in the body, usable if it can be read as a number**
+struct ScalarSpan {
+    const char* begin = nullptr;
+    const char* stop = nullptr;
+    bool usable = false; // False for escaped strings, literals, objects and arrays
+};
+
+// **Read position in a response body, with the JSON grammar checks the parsers need**
+struct JsonCursor {
+    const char* pos;
+    const char* end;
+
+    void skipWhitespace() {
+        while (pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t')) pos++;
+    }
+
+    // **True if only whitespace is left**
+    bool atEnd() {
+        skipWhitespace();
+        return pos == end;
+    }
+
+    // **True if the next character after whitespace is c, without consuming it**
+    bool peek(char c) {
+        skipWhitespace();
+        return pos < end && *pos == c;
+    }
+
+    // **Consume c if it is the next character after whitespace**
+    bool consume(char c) {
+        if (!peek(c)) return false;
+        pos++;
+        return true;
+    }
+
+    // **Read a string at its opening quote, giving its content with any escapes left in place**
+    bool readString(const char*& begin, const char*& stop, bool& escaped) {
+        pos++;
+        begin = pos;
+        escaped = false;
+        while (pos < end) {
+            const char c = *pos;
+            if (c == '"') {
+                stop = pos++;
+                return true;
+            }
+            if (static_cast<unsigned char>(c) < 0x20) return false;
+            if (c == '\\') {
+                escaped = true;
+                if (++pos == end) return false;
+                if (*pos == 'u') {
+                    if (end - pos < 5) return false;
+                    for (int i = 1; i <= 4; i++) {
+                        if (!isxdigit(static_cast<unsigned char>(pos[i]))) return false;
+                    }
+                    pos += 4;
+                }
+                else if (!strchr("\"\\/bfnrt", *pos)) {
+                    return false;
+                }
+            }
+            pos++;
+        }
+        return false;
+    }
+
+    // **Skip a number: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?**
+    bool skipNumber() {
+        auto digits = [&] {
+            const char* start = pos;
+            while (pos < end && *pos >= '0' && *pos <= '9') pos++;
+            return pos > start;
+        };
+        if (pos < end && *pos == '-') pos++;
+        if (pos < end && *pos == '0') pos++;
+        else if (!digits()) return false;
+        if (pos < end && *pos == '.') {
+            pos++;
+            if (!digits()) return false;
+        }
+        if (pos < end && (*pos == 'e' || *pos == 'E')) {
+            pos++;
+            if (pos < end && (*pos == '+' || *pos == '-')) pos++;
+            if (!digits()) return false;
+        }
+        return true;
+    }
+
+    // **Skip a literal such as true, false or null**
+    bool skipLiteral(const char* literal) {
+        const size_t length = strlen(literal);
+        if (static_cast<size_t>(end - pos) < length || memcmp(pos, literal, length) != 0) return false;
+        pos += length;
+        return true;
+    }
+
+    // **Skip any value, checking its syntax**
+    bool skipValue(int depth) {
+        skipWhitespace();
+        if (pos == end || depth > kMaxDepth) return false;
+        const char c = *pos;
+        if (c == '"') {
+            const char* begin;
+            const char* stop;
+            bool escaped;
+            return readString(begin, stop, escaped);
+        }
+        if (c == '{' || c == '[') {
+            const char close = c == '{' ? '}' : ']';
+            pos++;
+            if (consume(close)) return true;
+            do {
+                if (c == '{') {
+                    const char* begin;
+                    const char* stop;
+                    bool escaped;
+                    if (!peek('"') || !readString(begin, stop, escaped) || !consume(':')) return false;
+                }
+                if (!skipValue(depth + 1)) return false;
+            } while (consume(','));
+            return consume(close);
+        }
+        if (c == 't') return skipLiteral("true");
+        if (c == 'f') return skipLiteral("false");
+        if (c == 'n') return skipLiteral("null");
+        return skipNumber();
+    }
+
+    // **Read a value that should hold a number, as a JSON string or a JSON number**
+    bool readScalar(ScalarSpan& scalar, int depth) {
+        skipWhitespace();
+        if (pos == end) return false;
+        if (*pos == '"') {
+            bool escaped;
+            if (!readString(scalar.begin, scalar.stop, escaped)) return false;
+            scalar.usable = !escaped;
+            return true;
+        }
+        if (*pos == '-' || (*pos >= '0' && *pos <= '9')) {
+            scalar.begin = pos;
+            if (!skipNumber()) return false;
+            scalar.stop = pos;
+            scalar.usable = true;
+            return true;
+        }
+        scalar.usable = false;
+        return skipValue(depth);
+    }
+
+    // **Read an object key at its opening quote and the colon after it**
+    bool readKey(const char*& begin, const char*& stop) {
+        bool escaped;
+        return peek('"') && readString(begin, stop, escaped) && consume(':');
+    }
+};
+
+// **True if a key equals a name**
+static bool keyIs(const char* begin, const char* stop, const char* name) {
+    const size_t length = strlen(name);
+    return static_cast<size_t>(stop - begin) == length && memcmp(begin, name, length) == 0;
+}
+
+// **Parse a whole scalar as a double**
+static bool toDouble(const ScalarSpan& scalar, double& value) {
+    if (!scalar.usable) return false;
+    from_chars_result result = from_chars(scalar.begin, scalar.stop, value);
+    return result.ec == errc() && result.ptr == scalar.stop && scalar.stop > scalar.begin;
+}
+
+// **Parse a whole scalar as a timestamp, truncating a fractional or exponent form**
+static bool toTimestamp(const ScalarSpan& scalar, int64_t& value) {
+    if (!scalar.usable) return false;
+    from_chars_result result = from_chars(scalar.begin, scalar.stop, value);
+    if (result.ec == errc() && result.ptr == scalar.stop && scalar.stop > scalar.begin) return true;
+    double fractional = 0.0;
+    if (!toDouble(scalar, fractional)) return false;
+    value = static_cast<int64_t>(fractional);
+    return true;
+}
+
+// **Value of a hex digit**
+static unsigned hexValue(char c) {
+    if (c >= '0' && c <= '9') return static_cast<unsigned>(c - '0');
+    return static_cast<unsigned>((c | 0x20) - 'a' + 10);
+}
+
+// **Append the UTF-8 encoding of a code point**
+static void appendUtf8(unsigned codePoint, string& out) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    }
+    else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// **Assign the content of a string checked by readString, resolving its escapes**
+static void assignUnescaped(const char* begin, const char* stop, string& out) {
+    out.clear();
+    for (const char* p = begin; p < stop; p++) {
+        if (*p != '\\') {
+            out += *p;
+            continue;
+        }
+        p++;
+        switch (*p) {
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': {
+            unsigned codePoint = 0;
+            for (int i = 1; i <= 4; i++) codePoint = codePoint * 16 + hexValue(p[i]);
+            p += 4;
+            // A high surrogate followed by an escaped low surrogate is one code point
+            if (codePoint >= 0xD800 && codePoint < 0xDC00 && stop - p >= 7 && p[1] == '\\' && p[2] == 'u') {
+                unsigned low = 0;
+                for (int i = 3; i <= 6; i++) low = low * 16 + hexValue(p[i]);
+                if (low >= 0xDC00 && low < 0xE000) {
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                }
+            }
+            appendUtf8(codePoint, out);
+            break;
+        }
+        default: out += *p; break;
+        }
+    }
+}
+
+// **Status of a body that does not start with the expected container**
+static ParseStatus otherShape(JsonCursor& in) {
+    return in.skipValue(0) && in.atEnd() ? ParseStatus::WrongShape : ParseStatus::Malformed;
+}
+
+// **Read one candle array at its opening bracket, appending it if it has six usable fields**
+static bool readCandle(JsonCursor& in, vector<CandleRecord>& candles) {
+    in.pos++;
+    CandleRecord candle = {};
+    double* const prices[] = { &candle.open, &candle.high, &candle.low, &candle.close, &candle.volume };
+    size_t fields = 0;
+    bool usable = true;
+    if (!in.consume(']')) {
+        do {
+            if (fields < 6) {
+                ScalarSpan scalar;
+                if (!in.readScalar(scalar, 2)) return false;
+                if (fields == 0 ? !toTimestamp(scalar, candle.timestamp) : !toDouble(scalar, *prices[fields - 1])) {
+                    usable = false;
+                }
+            }
+            else if (!in.skipValue(2)) {
+                return false;
+            }
+            fields++;
+        } while (in.consume(','));
+        if (!in.consume(']')) return false;
+    }
+    if (usable && fields >= 6) candles.push_back(candle);
+    return true;
+}
+
+// **Candles of a candles response in response order: [[timestamp, open, high, low, close, volume], ...]**
+ParseStatus parseCandlesResponse(const char* data, size_t size, vector<CandleRecord>& candles) {
+    candles.clear();
+    JsonCursor in{ data, data + size };
+    if (!in.peek('[')) return otherShape(in);
+    in.pos++;
+    if (!in.consume(']')) {
+        do {
+            if (in.peek('[')) {
+                if (!readCandle(in, candles)) return ParseStatus::Malformed;
+            }
+            else if (!in.skipValue(1)) {
+                return ParseStatus::Malformed;
+            }
+        } while (in.consume(','));
+        if (!in.consume(']')) return ParseStatus::Malformed;
+    }
+    return in.atEnd() ? ParseStatus::Ok : ParseStatus::Malformed;
+}
+
+// **Read one balance object at its opening brace into balances[used], counting it if it has a symbol and amount**
+static bool readBalance(JsonCursor& in, vector<AssetBalance>& balances, size_t& used) {
+    in.pos++;
+    if (balances.size() <= used) balances.emplace_back();
+    AssetBalance& balance = balances[used];
+    balance.available = balance.inOrder = 0.0;
+    bool hasSymbol = false;
+    bool hasAvailable = false;
+    if (!in.consume('}')) {
+        do {
+            const char* key;
+            const char* keyEnd;
+            if (!in.readKey(key, keyEnd)) return false;
+            if (keyIs(key, keyEnd, "symbol") && in.peek('"')) {
+                const char* begin;
+                const char* stop;
+                bool escaped;
+                if (!in.readString(begin, stop, escaped)) return false;
+                if (escaped) assignUnescaped(begin, stop, balance.symbol);
+                else balance.symbol.assign(begin, stop);
+                hasSymbol = true;
+            }
+            else if (keyIs(key, keyEnd, "available") || keyIs(key, keyEnd, "inOrder")) {
+                ScalarSpan scalar;
+                if (!in.readScalar(scalar, 2)) return false;
+                double amount = 0.0;
+                if (toDouble(scalar, amount)) {
+                    if (key[0] == 'a') {
+                        balance.available = amount;
+                        hasAvailable = true;
+                    }
+                    else {
+                        balance.inOrder = amount;
+                    }
+                }
+            }
+            else if (!in.skipValue(2)) {
+                return false;
+            }
+        } while (in.consume(','));
+        if (!in.consume('}')) return false;
+    }
+    if (hasSymbol && hasAvailable) used++;
+    return true;
+}
+
+// **Balances of a balance response: [{"symbol": ..., "available": ..., "inOrder": ...}, ...]**
+ParseStatus parseBalanceResponse(const char* data, size_t size, vector<AssetBalance>& balances) {
+    size_t used = 0;
+    JsonCursor in{ data, data + size };
+    ParseStatus status = ParseStatus::Ok;
+    if (!in.peek('[')) {
+        status = otherShape(in);
+    }
+    else {
+        in.pos++;
+        if (!in.consume(']')) {
+            do {
+                if (in.peek('{') ? !readBalance(in, balances, used) : !in.skipValue(1)) {
+                    status = ParseStatus::Malformed;
+                    break;
+                }
+            } while (in.consume(','));
+            if (status == ParseStatus::Ok && (!in.consume(']') || !in.atEnd())) status = ParseStatus::Malformed;
+        }
+        else if (!in.atEnd()) {
+            status = ParseStatus::Malformed;
+        }
+    }
+    balances.resize(status == ParseStatus::Ok ? used : 0);
+    return status;
+}
+
+// **Price of a ticker/price response: {"market": ..., "price": ...}, 0 if it has none**
+ParseStatus parseTickerPriceResponse(const char* data, size_t size, double& price) {
+    price = 0.0;
+    JsonCursor in{ data, data + size };
+    if (!in.peek('{')) return otherShape(in);
+    in.pos++;
+    bool hasPrice = false;
+    if (!in.consume('}')) {
+        do {
+            const char* key;
+            const char* keyEnd;
+            if (!in.readKey(key, keyEnd)) return ParseStatus::Malformed;
+            if (keyIs(key, keyEnd, "price")) {
+                ScalarSpan scalar;
+                if (!in.readScalar(scalar, 1)) return ParseStatus::Malformed;
+                hasPrice = toDouble(scalar, price);
+            }
+            else if (!in.skipValue(1)) {
+                return ParseStatus::Malformed;
+            }
+        } while (in.consume(','));
+        if (!in.consume('}')) return ParseStatus::Malformed;
+    }
+    if (!in.atEnd()) return ParseStatus::Malformed;
+    if (!hasPrice) price = 0.0;
+    return hasPrice ? ParseStatus::Ok : ParseStatus::WrongShape;
+}
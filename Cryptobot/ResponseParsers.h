@@ -0,0 +1,37 @@
+#ifndef RESPONSEPARSERS_H
+#define RESPONSEPARSERS_H
+
+#include "CandleArchive.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// **Outcome of parsing a response body**
+enum class ParseStatus {
+    Ok,         // The body has the expected shape and was parsed
+    WrongShape, // Valid JSON of another shape, such as an error object
+    Malformed,  // Not valid JSON, retried like a json parse error
+};
+
+// **Available and in-order amount of one asset in a balance response**
+struct AssetBalance {
+    std::string symbol;
+    double available = 0.0;
+    double inOrder = 0.0;
+};
+
+// Hand-written parsers for the fixed shapes of the candles, balance and ticker/price responses. They read the
+// body where curl received it and write the values straight into typed records, without building a json DOM or
+// copying values into strings. Numbers may be JSON strings or JSON numbers. Entries of the wrong shape are
+// skipped like the DOM path skipped them, and the output vectors keep their capacity across calls.
+
+// **Candles of a candles response in response order: [[timestamp, open, high, low, close, volume], ...]**
+ParseStatus parseCandlesResponse(const char* data, size_t size, std::vector<CandleRecord>& candles);
+
+// **Balances of a balance response: [{"symbol": ..., "available": ..., "inOrder": ...}, ...]**
+ParseStatus parseBalanceResponse(const char* data, size_t size, std::vector<AssetBalance>& balances);
+
+// **Price of a ticker/price response: {"market": ..., "price": ...}, 0 if it has none**
+ParseStatus parseTickerPriceResponse(const char* data, size_t size, double& price);
+
+#endif // !RESPONSEPARSERS_H
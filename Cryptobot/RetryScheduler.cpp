@@ -0,0 +1,75 @@
+#include "RetryScheduler.h"
+#include <algorithm>
+
+using namespace std;
+
+// Backoff before the first retry, doubled for every further retry
+static const long long kFirstBackoffMillis = 1000;
+
+// Longest backoff between two attempts
+static const long long kMaxBackoffMillis = 16000;
+
+RetryScheduler::RetryScheduler(long long tickMillis, size_t slotCount)
+    : tickMillis(max(tickMillis, 1LL)), slots(max<size_t>(slotCount, 1)) {
+}
+
+// **Jittered backoff before retry number attempt, doubling from 1 second up to 16 seconds**
+long long RetryScheduler::backoffMillis(int attempt, mt19937& random) {
+    long long delay = kFirstBackoffMillis;
+    for (int n = 1; n < attempt && delay < kMaxBackoffMillis; n++) delay *= 2;
+    delay = min(delay, kMaxBackoffMillis);
+    return uniform_int_distribution<long long>(delay / 2, delay)(random);
+}
+
+// **Queue an id to be taken once the clock reaches dueMs**
+void RetryScheduler::schedule(size_t id, long long dueMs) {
+    // A retry due in a tick the wheel has already passed goes in the current slot, which the next takeDue visits
+    long long tick = max(dueMs / tickMillis, cursor);
+    slots[static_cast<size_t>(tick) % slots.size()].push_back({ id, dueMs });
+    queued++;
+}
+
+// **Move the ids that are due at nowMs to due, earliest first**
+void RetryScheduler::takeDue(long long nowMs, vector<size_t>& due) {
+    const long long nowTick = nowMs / tickMillis;
+    if (queued == 0) {
+        cursor = max(cursor, nowTick);
+        return;
+    }
+    vector<Timer> taken;
+    auto takeSlot = [&](vector<Timer>& slot) {
+        auto firstLater = partition(slot.begin(), slot.end(), [&](const Timer& timer) { return timer.dueMs <= nowMs; });
+        taken.insert(taken.end(), slot.begin(), firstLater);
+        slot.erase(slot.begin(), firstLater);
+    };
+    // The current slot is visited again, it holds the retries scheduled since the last call
+    const long long firstTick = cursor < 0 ? nowTick - static_cast<long long>(slots.size()) : cursor;
+    if (nowTick - firstTick >= static_cast<long long>(slots.size())) {
+        for (vector<Timer>& slot : slots) takeSlot(slot);
+    }
+    else {
+        for (long long tick = firstTick; tick <= nowTick; tick++) takeSlot(slots[static_cast<size_t>(tick) % slots.size()]);
+    }
+    cursor = max(cursor, nowTick);
+    sort(taken.begin(), taken.end(), [](const Timer& a, const Timer& b) { return a.dueMs < b.dueMs; });
+    for (const Timer& timer : taken) due.push_back(timer.id);
+    queued -= taken.size();
+}
+
+// **Due time of the earliest queued id, -1 if none is queued**
+long long RetryScheduler::nextDue() const {
+    long long earliest = -1;
+    if (queued == 0) return earliest;
+    for (const vector<Timer>& slot : slots) {
+        for (const Timer& timer : slot) {
+            if (earliest < 0 || timer.dueMs < earliest) earliest = timer.dueMs;
+        }
+    }
+    return earliest;
+}
+
+// **Forget every queued id**
+void RetryScheduler::clear() {
+    for (vector<Timer>& slot : slots) slot.clear();
+    queued = 0;
+}
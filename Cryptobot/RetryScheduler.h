@@ -0,0 +1,47 @@
+#ifndef RETRYSCHEDULER_H
+#define RETRYSCHEDULER_H
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+// **Timer wheel of the retries waiting in apiRequest**
+// A retry is filed in the slot of its due time, so scheduling is constant time and taking the due retries only
+// looks at the slots the clock has passed. Times are milliseconds on any monotonic clock the caller uses
+// consistently. Retries due more than one turn of the wheel ahead stay in their slot until their turn comes.
+class RetryScheduler {
+public:
+    explicit RetryScheduler(long long tickMillis = 10, size_t slotCount = 256);
+
+    // **Jittered backoff before retry number attempt, doubling from 1 second up to 16 seconds**
+    // The delay is drawn from the upper half of the doubled delay, so retries of requests that failed together
+    // spread out instead of hitting the exchange at the same moment again.
+    static long long backoffMillis(int attempt, std::mt19937& random);
+
+    // **Queue an id to be taken once the clock reaches dueMs**
+    void schedule(size_t id, long long dueMs);
+
+    // **Move the ids that are due at nowMs to due, earliest first**
+    void takeDue(long long nowMs, std::vector<size_t>& due);
+
+    // **Due time of the earliest queued id, -1 if none is queued**
+    long long nextDue() const;
+
+    bool empty() const { return queued == 0; }
+
+    // **Forget every queued id**
+    void clear();
+
+private:
+    struct Timer {
+        size_t id;
+        long long dueMs;
+    };
+
+    long long tickMillis;
+    std::vector<std::vector<Timer>> slots;
+    long long cursor = -1; // Last tick whose slot was taken, -1 before the first takeDue
+    size_t queued = 0;
+};
+
+#endif // !RETRYSCHEDULER_H
@@ -0,0 +1,83 @@
+#include "SessionReplay.h"
+#include "MarketData.h"
+#include "TradingBot.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+SessionReplayer::SessionReplayer(const string& file, const string& selectedMarket, bool simulationMode,
+    double maxPosition)
+    : journalFile(file), market(selectedMarket), simulation(simulationMode), maxPositionSize(maxPosition) {
+}
+
+// **Open the journal, returns false if it cannot be read**
+bool SessionReplayer::open() {
+    if (!replay.open(journalFile)) {
+        cerr << "Failed to open the API journal " << journalFile << endl;
+        return false;
+    }
+    return true;
+}
+
+// **Replay the session, writing replay_<market>_[sim_]trades.log and replay_<market>_[sim_]log.txt**
+ReplayResult SessionReplayer::run() {
+    ReplayResult result;
+    const string logPrefix = "replay_" + market + "_";
+    const string mode = simulation ? "sim_" : "";
+    remove((logPrefix + mode + "trades.log").c_str());
+    remove((logPrefix + mode + "log.txt").c_str());
+    setApiReplay(&replay);
+    {
+        CryptoTradingBot bot(market, simulation, logPrefix);
+        bot.setRiskParameters(maxPositionSize);
+        MarketDataFeed feed({ market }, simulation);
+        const string tickerEndpoint = "ticker/price?market=" + market;
+        const long long startMs = replay.timeMs();
+        long long clockMs = startMs;
+        bot.setSimulatedClock(clockMs);
+
+        auto start = chrono::steady_clock::now();
+        bot.warmStart();
+        JournalEntry entry;
+        vector<MarketUpdate> updates;
+        while (replay.next(entry)) {
+            // A simulated order fills once its latency has passed, before anything captured after that moment
+            long long orderDue = bot.simulatedOrderDue();
+            if (orderDue >= 0 && orderDue <= entry.timeMs) {
+                clockMs = max(clockMs, orderDue);
+                bot.setSimulatedClock(clockMs);
+                bot.settleSimulatedOrder(feed);
+            }
+            // Transfers are journaled as they complete, so their send times can run slightly back
+            clockMs = max(clockMs, entry.timeMs);
+            bot.setSimulatedClock(clockMs);
+            if (entry.kind == JournalKind::WebSocket) {
+                feed.replayMessage(entry.body);
+                result.messages++;
+                updates.clear();
+                if (feed.waitForUpdates(updates, chrono::milliseconds(0))) bot.applyUpdates(updates, feed);
+            }
+            else if (entry.method == "GET" && entry.endpoint == tickerEndpoint) {
+                // Every poll requests the ticker, the rest of the poll takes the transfers captured around it
+                bot.pollTick(feed, chrono::seconds(60));
+                result.polls++;
+            }
+            else if (!simulation && entry.endpoint == "balance") {
+                // The snapshot goes stale on the wall clock, so a replay refreshes it where the session did
+                bot.refreshBalances();
+            }
+            bot.settleSimulatedOrder(feed);
+        }
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        result.sessionMillis = clockMs - startMs;
+        result.trades = bot.getTradeCount();
+        result.totalProfitLoss = bot.getTotalProfitLoss();
+    }
+    setApiReplay(nullptr);
+    result.served = replay.served();
+    result.missed = replay.missed();
+    return result;
+}
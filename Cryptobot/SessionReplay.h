@@ -0,0 +1,42 @@
+#ifndef SESSIONREPLAY_H
+#define SESSIONREPLAY_H
+
+#include "ApiJournal.h"
+#include <string>
+
+// **Outcome of a session replay**
+struct ReplayResult {
+    size_t messages = 0;         // Websocket messages replayed
+    size_t polls = 0;            // REST polls re-run
+    size_t served = 0;           // Requests served from the journal
+    size_t missed = 0;           // Requests the journal had no response for, the replay diverged if not 0
+    size_t trades = 0;           // Trades logged
+    double totalProfitLoss = 0.0;
+    long long sessionMillis = 0; // Time span of the captured session
+    double seconds = 0.0;        // Wall time of the replay
+};
+
+// **Re-runs a session of one market captured with API_JOURNAL, offline and on the session's clock**
+// The journal is walked in capture order: websocket messages go through the feed's message handling into
+// applyUpdates, and each captured ticker request re-runs a REST poll, whose requests are served from the journal
+// like every other request of the bot, orders included. Nothing is sent and nothing waits, so the session replays
+// as fast as the CPU allows, and the same journal and candle archives always give the same trades.
+class SessionReplayer {
+public:
+    SessionReplayer(const std::string& journalFile, const std::string& market, bool simulation, double maxPositionSize);
+
+    // **Open the journal, returns false if it cannot be read**
+    bool open();
+
+    // **Replay the session, writing replay_<market>_[sim_]trades.log and replay_<market>_[sim_]log.txt**
+    ReplayResult run();
+
+private:
+    std::string journalFile;
+    std::string market;
+    bool simulation;
+    double maxPositionSize;
+    JournalReplay replay;
+};
+
+#endif // !SESSIONREPLAY_H
@@ -0,0 +1,54 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// **Lock-free bounded queue for one producer and one consumer thread**
+// The producer only writes tail and the consumer only writes head, so a push or pop is a copy and two atomic
+// accesses. Capacity must be a power of two. Handing the producer or consumer role to another thread is safe
+// when the handover itself synchronizes, like a mutex protected run queue.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    // **Append an item, returns false if the queue is full**
+    bool tryPush(const T& item) {
+        const size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - cachedHead == Capacity) {
+            cachedHead = headIndex.load(std::memory_order_acquire);
+            if (tail - cachedHead == Capacity) return false;
+        }
+        items[tail & (Capacity - 1)] = item;
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // **Take the oldest item, returns false if the queue is empty**
+    bool tryPop(T& item) {
+        const size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == cachedTail) {
+            cachedTail = tailIndex.load(std::memory_order_acquire);
+            if (head == cachedTail) return false;
+        }
+        item = items[head & (Capacity - 1)];
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // **Number of queued items, exact only on the producer or consumer thread**
+    size_t size() const {
+        return tailIndex.load(std::memory_order_acquire) - headIndex.load(std::memory_order_acquire);
+    }
+
+private:
+    // Producer and consumer indices on separate cache lines, so the two threads do not share a line
+    alignas(64) std::atomic<size_t> tailIndex{ 0 };
+    size_t cachedHead = 0; // Producer's last view of headIndex
+    alignas(64) std::atomic<size_t> headIndex{ 0 };
+    size_t cachedTail = 0; // Consumer's last view of tailIndex
+    alignas(64) T items[Capacity];
+};
+
+#endif // !SPSCQUEUE_H
@@ -0,0 +1,179 @@
+#include "StateStore.h"
+#include "Platform.h"
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include <zlib.h>
+
+using namespace std;
+
+static const char kStateMagic[8] = { 'C', 'B', 'S', 'T', 'A', 'T', 'E', '1' };
+
+// **Header every state file starts with**
+static StateFileHeader stateFileHeader() {
+    StateFileHeader header = {};
+    memcpy(header.magic, kStateMagic, sizeof(kStateMagic));
+    header.version = kStateFileVersion;
+    header.recordSize = sizeof(StateRecord);
+    return header;
+}
+
+// **True if a header was written by this version of the state store**
+static bool validHeader(const StateFileHeader& header) {
+    return memcmp(header.magic, kStateMagic, sizeof(kStateMagic)) == 0 && header.version == kStateFileVersion
+        && header.recordSize == sizeof(StateRecord);
+}
+
+// **CRC-32 of a record without its checksum field**
+static uint32_t recordChecksum(const StateRecord& record) {
+    return static_cast<uint32_t>(crc32(0L, reinterpret_cast<const Bytef*>(&record), offsetof(StateRecord, checksum)));
+}
+
+StateStore::StateStore(const string& fileName, bool simulation)
+    : snapshotFile(fileName), logFile(fileName + ".wal"), isSimulation(simulation) {
+}
+
+StateStore::~StateStore() {
+    // A clean shutdown leaves the latest state in the snapshot
+    checkpoint();
+    if (log) fclose(log);
+}
+
+// **Load the latest recorded state, returns false if nothing was recorded yet**
+bool StateStore::recover(PositionState& state) {
+    const uint32_t simulation = isSimulation ? 1 : 0;
+    auto apply = [&](const StateRecord& record) {
+        latest = record;
+        sequence = record.sequence;
+        state.entryPrice = record.entryPrice;
+        state.boughtCryptoAmount = record.boughtCryptoAmount;
+        state.totalProfitLoss = record.totalProfitLoss;
+        state.simFiatBalance = record.simFiatBalance;
+        state.simCryptoBalance = record.simCryptoBalance;
+    };
+
+    if (FILE* file = fopen(snapshotFile.c_str(), "rb")) {
+        StateFileHeader header;
+        StateRecord record;
+        bool valid = fread(&header, sizeof(header), 1, file) == 1 && validHeader(header)
+            && fread(&record, sizeof(record), 1, file) == 1 && record.checksum == recordChecksum(record)
+            && record.simulation == simulation;
+        fclose(file);
+        if (valid) {
+            apply(record);
+            snapshotSequence = record.sequence;
+        }
+        else {
+            cerr << "Ignoring the unreadable state snapshot " << snapshotFile << endl;
+        }
+    }
+
+    // The log records after the snapshot, each in the ring slot of its sequence number
+    if (FILE* file = fopen(logFile.c_str(), "rb")) {
+        StateFileHeader header;
+        vector<StateRecord> ring(kStateLogRecords);
+        size_t records = 0;
+        if (fread(&header, sizeof(header), 1, file) == 1 && validHeader(header)) {
+            records = fread(ring.data(), sizeof(StateRecord), ring.size(), file);
+        }
+        fclose(file);
+        while (true) {
+            size_t slot = static_cast<size_t>(sequence % kStateLogRecords);
+            if (slot >= records) break;
+            const StateRecord& record = ring[slot];
+            if (record.sequence != sequence + 1 || record.checksum != recordChecksum(record)
+                || record.simulation != simulation) break;
+            apply(record);
+        }
+    }
+    return sequence > 0;
+}
+
+// **Record a state after a fill, durable once this returns true**
+bool StateStore::record(const PositionState& state, long long timeMs) {
+    auto startedAt = chrono::steady_clock::now();
+    if (!log && !openLog()) return false;
+    // The slot of the next record must hold a state the snapshot already covers
+    if (sequence + 1 > snapshotSequence + kStateLogRecords && !checkpoint()) return false;
+    StateRecord record = makeRecord(state, timeMs);
+    record.sequence = sequence + 1;
+    record.checksum = recordChecksum(record);
+    const long offset = static_cast<long>(sizeof(StateFileHeader) + (sequence % kStateLogRecords) * sizeof(StateRecord));
+    if (fseek(log, offset, SEEK_SET) != 0 || fwrite(&record, sizeof(record), 1, log) != 1 || fflush(log) != 0
+        || syncFile(log) != 0) {
+        cerr << "Failed to write the state log " << logFile << endl;
+        return false;
+    }
+    sequence = record.sequence;
+    latest = record;
+    recordNanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - startedAt).count();
+    return true;
+}
+
+// **Write the latest state as the snapshot, so the log ring can be reused**
+bool StateStore::checkpoint() {
+    if (sequence == snapshotSequence) return true;
+    const string tempFile = snapshotFile + ".tmp";
+    FILE* file = fopen(tempFile.c_str(), "wb");
+    if (!file) {
+        cerr << "Unable to open " << tempFile << " for writing." << endl;
+        return false;
+    }
+    StateFileHeader header = stateFileHeader();
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(&latest, sizeof(latest), 1, file) == 1
+        && fflush(file) == 0 && syncFile(file) == 0;
+    fclose(file);
+    error_code error;
+    if (written) filesystem::rename(tempFile, snapshotFile, error);
+    if (!written || error) {
+        cerr << "Failed to write the state snapshot " << snapshotFile << endl;
+        return false;
+    }
+    syncDirectory(filesystem::path(snapshotFile).parent_path().string());
+    snapshotSequence = sequence;
+    return true;
+}
+
+// **Open the log ring, creating it at its full size if it is missing or too short**
+// Records are overwritten in place, so syncing one never has to update the size of the file.
+bool StateStore::openLog() {
+    const size_t fullSize = sizeof(StateFileHeader) + kStateLogRecords * sizeof(StateRecord);
+    error_code error;
+    if (filesystem::exists(logFile, error) && filesystem::file_size(logFile, error) >= fullSize) {
+        log = fopen(logFile.c_str(), "r+b");
+        StateFileHeader header;
+        if (log && fread(&header, sizeof(header), 1, log) == 1 && validHeader(header)) return true;
+        if (log) fclose(log);
+    }
+    log = fopen(logFile.c_str(), "w+b");
+    if (!log) {
+        cerr << "Unable to open " << logFile << " for writing." << endl;
+        return false;
+    }
+    StateFileHeader header = stateFileHeader();
+    vector<StateRecord> empty(kStateLogRecords, StateRecord{});
+    if (fwrite(&header, sizeof(header), 1, log) != 1 || fwrite(empty.data(), sizeof(StateRecord), empty.size(), log) != empty.size()
+        || fflush(log) != 0 || syncFile(log) != 0) {
+        cerr << "Failed to create the state log " << logFile << endl;
+        fclose(log);
+        log = nullptr;
+        return false;
+    }
+    syncDirectory(filesystem::path(logFile).parent_path().string());
+    return true;
+}
+
+StateRecord StateStore::makeRecord(const PositionState& state, long long timeMs) const {
+    StateRecord record = {};
+    record.timeMs = timeMs;
+    record.entryPrice = state.entryPrice;
+    record.boughtCryptoAmount = state.boughtCryptoAmount;
+    record.totalProfitLoss = state.totalProfitLoss;
+    record.simFiatBalance = state.simFiatBalance;
+    record.simCryptoBalance = state.simCryptoBalance;
+    record.simulation = isSimulation ? 1 : 0;
+    return record;
+}
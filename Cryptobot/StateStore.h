@@ -0,0 +1,86 @@
+#ifndef STATESTORE_H
+#define STATESTORE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// **Position of a bot that has to survive a restart**
+struct PositionState {
+    double entryPrice = 0.0;         // 0 without an open position
+    double boughtCryptoAmount = 0.0;
+    double totalProfitLoss = 0.0;
+    double simFiatBalance = 0.0;     // Simulated balances, 0 for a live bot
+    double simCryptoBalance = 0.0;
+};
+
+// **One state of the snapshot or of the write-ahead log, stored as a fixed 64 byte record**
+struct StateRecord {
+    uint64_t sequence;       // Number of states recorded, 1 for the first
+    int64_t timeMs;          // Time of the fill in milliseconds since the epoch
+    double entryPrice;
+    double boughtCryptoAmount;
+    double totalProfitLoss;
+    double simFiatBalance;
+    double simCryptoBalance;
+    uint32_t simulation;     // 1 for a simulated position
+    uint32_t checksum;       // CRC-32 of the bytes before it, a torn write does not match
+};
+static_assert(sizeof(StateRecord) == 64, "StateRecord must be packed to 64 bytes");
+
+// **Header at the start of the snapshot and of the write-ahead log**
+struct StateFileHeader {
+    char magic[8];          // "CBSTATE1"
+    uint32_t version;       // kStateFileVersion
+    uint32_t recordSize;    // sizeof(StateRecord)
+    int64_t reserved[2];
+};
+static_assert(sizeof(StateFileHeader) == 32, "StateFileHeader must be 32 bytes");
+
+const uint32_t kStateFileVersion = 1;
+
+// Records of the write-ahead log, it is checkpointed into the snapshot when they are used up
+const size_t kStateLogRecords = 64;
+
+// **Crash-safe position state of a bot: a snapshot and a write-ahead log of every fill**
+// Each fill overwrites one record of a preallocated write-ahead log ring (<file>.wal) and syncs it, which only
+// writes one block of data and no file metadata. Once every record of the ring is used, the latest state is
+// written to <file>.tmp, synced and renamed over the snapshot, so the snapshot is always either the old or the
+// new one. Recovery reads the snapshot, then the log records that follow its sequence number in order, stopping
+// at the first record that is missing or torn.
+class StateStore {
+public:
+    StateStore(const std::string& fileName, bool simulation);
+    ~StateStore();
+    StateStore(const StateStore&) = delete;
+    StateStore& operator=(const StateStore&) = delete;
+
+    // **Load the latest recorded state, returns false if nothing was recorded yet**
+    bool recover(PositionState& state);
+
+    // **Record a state after a fill, durable once this returns true**
+    bool record(const PositionState& state, long long timeMs);
+
+    // **Write the latest state as the snapshot, so the log ring can be reused**
+    bool checkpoint();
+
+    // **Time the last record took in nanoseconds, syncing included**
+    long long lastRecordNanos() const { return recordNanos; }
+
+private:
+    // **Open the log ring, creating it at its full size if it is missing or too short**
+    bool openLog();
+
+    StateRecord makeRecord(const PositionState& state, long long timeMs) const;
+
+    std::string snapshotFile;
+    std::string logFile;
+    bool isSimulation;
+    std::FILE* log = nullptr;
+    uint64_t sequence = 0;         // Sequence number of the latest state
+    uint64_t snapshotSequence = 0; // Sequence number of the state in the snapshot
+    StateRecord latest = {};       // Latest state, written by checkpoint
+    long long recordNanos = 0;
+};
+
+#endif // !STATESTORE_H
@@ -0,0 +1,146 @@
+#ifndef STRATEGY_H
+#define STRATEGY_H
+
+#include "CandleStore.h"
+#include "Indicators.h"
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// **Tunable thresholds and indicator periods of the multi-timeframe strategy**
+struct StrategyParameters {
+    double rsiBuy = 30.0;   // Buy below this RSI
+    double rsiSell = 70.0;  // Sell above this RSI
+    IndicatorParameters indicators;
+};
+
+// **Position of a component in a component list, a compile error if it is not listed**
+template <typename Component, typename First, typename... Rest>
+constexpr size_t componentIndex() {
+    if constexpr (std::is_same<Component, First>::value) return 0;
+    else return 1 + componentIndex<Component, Rest...>();
+}
+
+// **Values of a fixed set of indicator components for one candle, stored back to back**
+template <typename... Components>
+struct IndicatorValues {
+    std::tuple<typename Components::Value...> values;
+
+    template <typename Component>
+    const typename Component::Value& get() const { return std::get<componentIndex<Component, Components...>()>(values); }
+    template <typename Component>
+    typename Component::Value& get() { return std::get<componentIndex<Component, Components...>()>(values); }
+};
+
+// **Streaming engine that only runs the listed indicator components**
+// Produces the same values as IndicatorEngine for those components, without computing or storing the others.
+template <typename... Components>
+class IndicatorSet {
+public:
+    using Values = IndicatorValues<Components...>;
+
+    explicit IndicatorSet(const IndicatorParameters& parameters = IndicatorParameters())
+        : params(parameters.clamped()) {}
+
+    // **The MACD signal line is only reported once the history holds this many candles**
+    size_t signalWarmup() const { return static_cast<size_t>(params.macdSignal); }
+
+    // **Feed the next candle and return the values of the listed components**
+    Values update(double high, double low, double close) {
+        const IndicatorInput in = { processed, high, low, close, prevClose };
+        Values result = { { std::get<Components>(states).update(in, params)... } };
+        prevClose = close;
+        processed++;
+        return result;
+    }
+
+    // **Feed many candles at once, writing their values to out**
+    // Same values and final state as calling update for every candle. From a fresh set only the listed components
+    // run through the batch kernels, block by block, each storing its values straight into out.
+    void updateBatch(const double* high, const double* low, const double* close, size_t count, Values* out,
+        const IndicatorKernels& kernels = indicatorKernels()) {
+        if (processed != 0 || count < IndicatorEngine::kMinBatch) {
+            for (size_t i = 0; i < count; i++) out[i] = update(high[i], low[i], close[i]);
+            return;
+        }
+        const IndicatorBatch batch = { high, low, close, count, params, kernels };
+        std::vector<double> columns((Components::kColumns + ...) * kIndicatorColumn);
+        for (size_t begin = 0; begin < count; begin += kIndicatorBlock) {
+            const size_t n = count - begin < kIndicatorBlock ? count - begin : kIndicatorBlock;
+            double* componentColumns = columns.data();
+            ((std::get<Components>(states).updateBlock(batch, begin, n, componentColumns,
+                [out](size_t i, const typename Components::Value& value) {
+                    out[i].template get<Components>() = value;
+                }), componentColumns += Components::kColumns * kIndicatorColumn), ...);
+        }
+        prevClose = close[count - 1];
+        processed = count;
+    }
+
+    // **Forget all state, the next candle is treated as the first one**
+    void reset() { *this = IndicatorSet(params); }
+
+    // **Number of candles fed since the last reset**
+    size_t count() const { return processed; }
+
+private:
+    IndicatorParameters params;
+    size_t processed = 0;
+    double prevClose = 0.0;
+    std::tuple<Components...> states;
+};
+
+// **Value of one component, from a strategy's own values or from a full IndicatorData**
+template <typename Component, typename... Components>
+inline const typename Component::Value& indicator(const IndicatorValues<Components...>& values) {
+    return values.template get<Component>();
+}
+template <typename Component>
+inline typename Component::Value indicator(const IndicatorData& data) {
+    return Component::fromData(data);
+}
+
+// **Candle intervals a strategy needs to agree on, as a type**
+template <Interval... Intervals>
+struct TimeframeList {
+    static constexpr size_t size = sizeof...(Intervals);
+};
+
+// A strategy is a type with Timeframes (a TimeframeList), Indicators (an IndicatorSet of the components its
+// conditions read) and static buy and sell conditions on the values of one timeframe. Everything is resolved
+// at compile time, so the conditions inline into the caller's loop.
+
+// **Bollinger Bands, RSI and MACD agreeing on the 1h, 15m and 5m candles**
+struct MultiTimeframeStrategy {
+    using Timeframes = TimeframeList<Interval::H1, Interval::M15, Interval::M5>;
+    using Indicators = IndicatorSet<BollingerIndicator, RsiIndicator, MacdIndicator>;
+
+    // **Buy condition on one timeframe: price below the lower band, oversold and MACD turning up**
+    template <typename Values>
+    static bool buy(const Values& ind, double tickerPrice, const StrategyParameters& strategy) {
+        return tickerPrice < indicator<BollingerIndicator>(ind).lower && indicator<RsiIndicator>(ind) < strategy.rsiBuy
+            && indicator<MacdIndicator>(ind).hist > 0;
+    }
+
+    // **Sell condition on one timeframe: price above the upper band, overbought and MACD turning down**
+    template <typename Values>
+    static bool sell(const Values& ind, double tickerPrice, const StrategyParameters& strategy) {
+        return tickerPrice > indicator<BollingerIndicator>(ind).upper && indicator<RsiIndicator>(ind) > strategy.rsiSell
+            && indicator<MacdIndicator>(ind).hist < 0;
+    }
+};
+
+template <typename Condition, Interval... Intervals>
+inline bool allTimeframes(Condition& condition, TimeframeList<Intervals...>) {
+    return (condition(Intervals) && ...);
+}
+
+// **True if a condition holds on every timeframe of a strategy, stops at the first one that fails**
+// The condition is called with each Interval of Strategy::Timeframes in order, unrolled at compile time.
+template <typename Strategy, typename Condition>
+inline bool allTimeframes(Condition&& condition) {
+    return allTimeframes(condition, typename Strategy::Timeframes());
+}
+
+#endif // !STRATEGY_H
@@ -0,0 +1,226 @@
+#include "TradeLog.h"
+#include "Platform.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static const char kTradeLogMagic[8] = { 'C', 'B', 'T', 'R', 'A', 'D', 'E', 'S' };
+
+// Queued records that wake the writer before its flush interval
+static const size_t kFlushRecords = 64;
+
+// Longest time a record waits in the queue before it is written
+static const long long kFlushMillis = 200;
+
+// **Background thread draining the queues of all trade logs**
+// The consumer side of every queue only runs while holding registryMutex, either on this thread or in
+// TradeLog::flush and the destructor, so each queue keeps a single consumer at a time.
+class TradeLogWriter {
+public:
+    static TradeLogWriter& instance() {
+        static TradeLogWriter writer;
+        return writer;
+    }
+
+    void add(TradeLog* log) {
+        lock_guard<mutex> guard(registryMutex);
+        logs.push_back(log);
+    }
+
+    // **Stop draining a log and write what it still has queued**
+    void remove(TradeLog* log) {
+        lock_guard<mutex> guard(registryMutex);
+        logs.erase(std::remove(logs.begin(), logs.end(), log), logs.end());
+        log->drain();
+        log->writePending();
+    }
+
+    // **Drain and write one log now**
+    void flush(TradeLog* log) {
+        lock_guard<mutex> guard(registryMutex);
+        log->drain();
+        log->writePending();
+    }
+
+    // **Wake the writer before its flush interval**
+    void wake() {
+        {
+            lock_guard<mutex> guard(wakeMutex);
+            woken = true;
+        }
+        wakeUp.notify_one();
+    }
+
+private:
+    mutex registryMutex;
+    vector<TradeLog*> logs;
+    mutex wakeMutex;
+    condition_variable wakeUp;
+    bool woken = false;
+    bool stopping = false;
+    thread worker;
+
+    TradeLogWriter() : worker(&TradeLogWriter::run, this) {}
+
+    ~TradeLogWriter() {
+        {
+            lock_guard<mutex> guard(wakeMutex);
+            stopping = true;
+        }
+        wakeUp.notify_one();
+        worker.join();
+    }
+
+    void run() {
+        while (true) {
+            bool stop;
+            {
+                unique_lock<mutex> guard(wakeMutex);
+                wakeUp.wait_for(guard, chrono::milliseconds(kFlushMillis), [this] { return woken || stopping; });
+                woken = false;
+                stop = stopping;
+            }
+            lock_guard<mutex> guard(registryMutex);
+            for (TradeLog* log : logs) {
+                log->drain();
+                log->writePending();
+            }
+            if (stop) return;
+        }
+    }
+};
+
+TradeLog::TradeLog(const string& tradeLogFile, const string& profitLogFile, TradeLogFormat logFormat)
+    : tradeFile(logFormat == TradeLogFormat::Binary ? tradeLogFile + ".bin" : tradeLogFile),
+    profitFile(profitLogFile), format(logFormat) {
+    TradeLogWriter::instance().add(this);
+}
+
+TradeLog::~TradeLog() {
+    TradeLogWriter::instance().remove(this);
+}
+
+// **Queue a buy or sell for the trade log**
+void TradeLog::logTrade(const TradeRecord& record) {
+    enqueue(record);
+}
+
+// **Queue a new total profit/loss for the profit/loss file**
+void TradeLog::saveTotalProfitLoss(double total) {
+    TradeRecord record;
+    record.kind = TradeRecord::Total;
+    record.totalProfitLoss = total;
+    enqueue(record);
+}
+
+// **Write everything queued so far and wait until it is handed to the OS**
+// The files are not synced to disk, the position that has to survive a crash is kept by StateStore.
+void TradeLog::flush() {
+    TradeLogWriter::instance().flush(this);
+}
+
+// **File the trades are written to**
+const string& TradeLog::fileName() const {
+    return tradeFile;
+}
+
+// **Queue a record, waking the writer when a batch is ready or waiting for it when the queue is full**
+void TradeLog::enqueue(const TradeRecord& record) {
+    while (!queue.tryPush(record)) {
+        // Never drop a trade, the writer frees the queue within a flush
+        TradeLogWriter::instance().wake();
+        this_thread::yield();
+    }
+    if (queue.size() == kFlushRecords) TradeLogWriter::instance().wake();
+}
+
+// **Move queued records into the write buffers, consumer side only**
+void TradeLog::drain() {
+    TradeRecord record;
+    ostringstream line;
+    while (queue.tryPop(record)) {
+        if (record.kind == TradeRecord::Total) {
+            totalPending = true;
+            pendingTotal = record.totalProfitLoss;
+            continue;
+        }
+        if (format == TradeLogFormat::Binary) {
+            TradeLogEntry entry = {};
+            entry.timeMs = record.timeMs;
+            entry.side = record.kind == TradeRecord::Sell ? 1 : 0;
+            entry.simulation = record.simulation ? 1 : 0;
+            entry.amount = record.amount;
+            entry.price = record.price;
+            entry.profitLoss = record.profitLoss;
+            entry.totalProfitLoss = record.totalProfitLoss;
+            pendingBinary.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+            continue;
+        }
+        time_t time = static_cast<time_t>(record.timeMs / 1000);
+        char buf[80];
+        tm localTime;
+        localtime_s(&localTime, &time);
+        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &localTime);
+        line.str("");
+        line << (record.simulation ? "[SIMULATION]" : "[REAL]") << " [" << buf << "] "
+            << (record.kind == TradeRecord::Sell ? "SELL" : "BUY")
+            << " | Amount: " << record.amount
+            << " | Price: " << record.price;
+        if (record.kind == TradeRecord::Sell) {
+            line << " | Profit/Loss: " << record.profitLoss
+                << " | Total Profit/Loss: " << record.totalProfitLoss;
+        }
+        line << "\n";
+        pendingText += line.str();
+    }
+}
+
+// **Write the buffered trades and the latest total to their files, consumer side only**
+void TradeLog::writePending() {
+    const string& pending = format == TradeLogFormat::Binary ? pendingBinary : pendingText;
+    if (!pending.empty()) {
+        if (!tradeStream.is_open()) {
+            bool newFile = !filesystem::exists(tradeFile);
+            tradeStream.open(tradeFile, format == TradeLogFormat::Binary ? ios::app | ios::binary : ios::app);
+            if (tradeStream.is_open() && format == TradeLogFormat::Binary && newFile) {
+                TradeLogHeader header = {};
+                memcpy(header.magic, kTradeLogMagic, sizeof(kTradeLogMagic));
+                header.version = kTradeLogVersion;
+                header.recordSize = sizeof(TradeLogEntry);
+                tradeStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            }
+        }
+        if (tradeStream.is_open()) {
+            tradeStream.write(pending.data(), pending.size());
+            tradeStream.flush();
+        }
+        else {
+            cerr << "Unable to open " << tradeFile << " for writing." << endl;
+        }
+        pendingText.clear();
+        pendingBinary.clear();
+    }
+    if (totalPending) {
+        // Written next to the file and renamed over it, so a crash never leaves it truncated
+        const string tempFile = profitFile + ".tmp";
+        ofstream file(tempFile, ios::trunc);
+        if (file.is_open()) {
+            file << pendingTotal;
+            file.close();
+            error_code error;
+            if (file) filesystem::rename(tempFile, profitFile, error);
+            if (!file || error) cerr << "Unable to write " << profitFile << "." << endl;
+        }
+        totalPending = false;
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef TRADELOG_H
+#define TRADELOG_H
+
+#include "SpscQueue.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// **Format of the trade log, text lines or fixed size binary records**
+enum class TradeLogFormat { Text, Binary };
+
+// **One trade, or a new total profit/loss when kind is Total**
+struct TradeRecord {
+    enum Kind : uint8_t { Buy, Sell, Total };
+    Kind kind = Buy;
+    bool simulation = false;
+    long long timeMs = 0;          // Trade time in milliseconds since the epoch
+    double amount = 0.0;
+    double price = 0.0;
+    double profitLoss = 0.0;       // Of a sell
+    double totalProfitLoss = 0.0;  // After the trade
+};
+
+// **One trade of a binary trade log, stored as a fixed 48 byte record**
+struct TradeLogEntry {
+    int64_t timeMs;          // Trade time in milliseconds since the epoch
+    uint32_t side;           // 0 buy, 1 sell
+    uint32_t simulation;     // 1 for simulated trades
+    double amount;
+    double price;
+    double profitLoss;
+    double totalProfitLoss;
+};
+static_assert(sizeof(TradeLogEntry) == 48, "TradeLogEntry must be packed to 48 bytes");
+
+// **Header at the start of every binary trade log, followed by the trades in time order**
+struct TradeLogHeader {
+    char magic[8];          // "CBTRADES"
+    uint32_t version;       // kTradeLogVersion
+    uint32_t recordSize;    // sizeof(TradeLogEntry)
+    int64_t reserved[2];
+};
+static_assert(sizeof(TradeLogHeader) == 32, "TradeLogHeader must be 32 bytes");
+
+const uint32_t kTradeLogVersion = 1;
+
+// **Trade and profit/loss log of one bot, written by a background thread**
+// logTrade and saveTotalProfitLoss only enqueue a record on a lock-free queue. A writer thread shared by all
+// logs drains the queues, appends the trades to the trade log in batches and rewrites the profit/loss file with
+// the latest total, when enough records are queued or a flush interval has passed. The text format writes the
+// same lines as before; the binary format appends TradeLogEntry records to <trade log>.bin instead.
+class TradeLog {
+public:
+    TradeLog(const std::string& tradeLogFile, const std::string& profitLogFile, TradeLogFormat format);
+    ~TradeLog();
+    TradeLog(const TradeLog&) = delete;
+    TradeLog& operator=(const TradeLog&) = delete;
+
+    // **Queue a buy or sell for the trade log**
+    void logTrade(const TradeRecord& record);
+
+    // **Queue a new total profit/loss for the profit/loss file**
+    void saveTotalProfitLoss(double total);
+
+    // **Write everything queued so far and wait until it is handed to the OS**
+    // The files are not synced to disk, the position that has to survive a crash is kept by StateStore.
+    void flush();
+
+    // **File the trades are written to**
+    const std::string& fileName() const;
+
+private:
+    friend class TradeLogWriter;
+    static const size_t kQueueCapacity = 1024;
+
+    // **Queue a record, waking the writer when a batch is ready or waiting for it when the queue is full**
+    void enqueue(const TradeRecord& record);
+
+    // **Move queued records into the write buffers, consumer side only**
+    void drain();
+
+    // **Write the buffered trades and the latest total to their files, consumer side only**
+    void writePending();
+
+    SpscQueue<TradeRecord, kQueueCapacity> queue;
+    std::string tradeFile;
+    std::string profitFile;
+    TradeLogFormat format;
+    std::ofstream tradeStream;  // Kept open by the writer
+    std::string pendingText;    // Text lines not written yet
+    std::string pendingBinary;  // Binary records not written yet
+    bool totalPending = false;
+    double pendingTotal = 0.0;
+};
+
+#endif // !TRADELOG_H
@@ -0,0 +1,970 @@
+#include "TradingBot.h"
+#include "config.h"
+#include "Metrics.h"
+#include "Platform.h"
+#include "RateLimiter.h"
+#include "ResponseParsers.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+
+// Largest number of candles the candles endpoint returns per request
+static const int kMaxCandlesPerRequest = 1440;
+
+// **Parser that reads a candles response into a reused vector**
+static ResponseParser candlesParser(vector<CandleRecord>& candles) {
+    return [&candles](const char* data, size_t size) {
+        return parseCandlesResponse(data, size, candles) != ParseStatus::Malformed;
+    };
+}
+
+// **Parser that reads the price of a ticker/price response**
+static ResponseParser tickerPriceParser(double& price) {
+    return [&price](const char* data, size_t size) {
+        return parseTickerPriceResponse(data, size, price) != ParseStatus::Malformed;
+    };
+}
+
+// One in this many indicator updates of a live bot is timed for the metrics
+static const size_t kIndicatorTimingSample = 16;
+
+// **Load total profit/loss from file**
+double CryptoTradingBot::loadTotalProfitLoss() {
+    double profit = 0.0;
+    ifstream file(profitLogFile);
+    if (file.is_open()) {
+        file >> profit;
+        file.close();
+    }
+    return profit;
+}
+
+// **Queue the total profit/loss for the profit/loss file**
+void CryptoTradingBot::saveTotalProfitLoss(double profit) {
+    tradeLog->saveTotalProfitLoss(profit);
+}
+
+// **Queue a trade for the trade log**
+// Formatting and file I/O happen on the trade log's writer thread.
+void CryptoTradingBot::logTrade(const string& tradeType, double amount, double price, double profitLoss) {
+    TradeRecord record;
+    record.kind = tradeType == "SELL" ? TradeRecord::Sell : TradeRecord::Buy;
+    record.simulation = isSimulation;
+    record.timeMs = nowMs();
+    record.amount = amount;
+    record.price = price;
+    record.profitLoss = profitLoss;
+    record.totalProfitLoss = totalProfitLoss;
+    tradeLog->logTrade(record);
+    tradeCount++;
+}
+
+// **Calculate indicators for a given interval**
+// Only the candles appended since the previous call are fed to the streaming engine. A live bot copies the engine
+// before the last candle, so a replaced last candle is fed again from there; without a copy the interval is
+// rebuilt. A live bot times one in kIndicatorTimingSample calls for the metrics; backtests are not timed.
+void CryptoTradingBot::calculateIndicators(Interval interval) {
+    const size_t idx = intervalIndex(interval);
+    const CandleSeries& candles = candlesByInterval[idx];
+    if (candles.empty()) return;
+    const bool live = simulatedTimeMs < 0;
+    const bool timed = live && indicatorUpdates++ % kIndicatorTimingSample == 0;
+    chrono::steady_clock::time_point startedAt;
+    if (timed) startedAt = chrono::steady_clock::now();
+
+    RingColumn<Strategy::Indicators::Values>& indicators = indicatorsByInterval[idx];
+    Strategy::Indicators& engine = enginesByInterval[idx];
+
+    // The signal line of earlier candles only appears once the warmup is reached, so rebuild until then
+    size_t pending = candles.appended() - processedCandles[idx];
+    const bool revised = candles.revisions() != processedRevisions[idx];
+    const bool restorable = enginesBeforeLast[idx].count() + 1 == engine.count();
+    if (engine.count() < engine.signalWarmup() || pending + (revised ? 1 : 0) > candles.size() || (revised && !restorable)) {
+        engine.reset();
+        indicators.clear();
+        pending = candles.size();
+    }
+    else if (revised) {
+        // Only the last candle can be replaced, so the last one fed is fed again
+        engine = enginesBeforeLast[idx];
+        indicators.pop_back();
+        pending++;
+    }
+    const size_t start = candles.size() - pending;
+    if (engine.count() == 0) {
+        // A rebuild of the whole history goes through the batch kernels
+        vector<Strategy::Indicators::Values> rebuilt(pending);
+        engine.updateBatch(candles.high.data() + start, candles.low.data() + start, candles.close.data() + start,
+            pending - 1, rebuilt.data());
+        enginesBeforeLast[idx] = engine;
+        rebuilt.back() = engine.update(candles.high.back(), candles.low.back(), candles.close.back());
+        for (const Strategy::Indicators::Values& ind : rebuilt) indicators.push_back(ind);
+    }
+    else {
+        for (size_t i = start; i < candles.size(); i++) {
+            if (live && i + 1 == candles.size()) enginesBeforeLast[idx] = engine;
+            indicators.push_back(engine.update(candles.high[i], candles.low[i], candles.close[i]));
+        }
+    }
+    processedCandles[idx] = candles.appended();
+    processedRevisions[idx] = candles.revisions();
+    if (candles.size() < engine.signalWarmup()) {
+        for (size_t i = 0; i < indicators.size(); i++) {
+            MacdIndicator::Value& macd = indicators[i].get<MacdIndicator>();
+            macd.signal = 0.0;
+            macd.hist = 0.0;
+        }
+    }
+    if (timed) {
+        Metrics::instance().record(LatencyMetric::IndicatorCompute,
+            chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - startedAt).count());
+    }
+}
+
+// **Current time in milliseconds: the simulated clock of a backtest, otherwise the wall clock**
+long long CryptoTradingBot::nowMs() const {
+    if (simulatedTimeMs >= 0) return simulatedTimeMs;
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// **Constructor**
+CryptoTradingBot::CryptoTradingBot(const string& selectedMarket, bool simulationMode, const string& logPrefix)
+    : market(selectedMarket), entryPrice(0.0), isSimulation(simulationMode), replayingJournal(apiReplay() != nullptr) {
+    size_t pos = market.find("-");
+    if (pos != string::npos) {
+        cryptoAsset = market.substr(0, pos);
+        fiatAsset = market.substr(pos + 1);
+    }
+    if (isSimulation) {
+        simFiatBalance = 1000.0;
+        simCryptoBalance = 0.0;
+        fillSimulator = make_unique<FillSimulator>(SIM_TAKER_FEE, SIM_LATENCY_MS);
+        tradeLogFile = logPrefix + "sim_trades.log";
+        profitLogFile = logPrefix + "sim_log.txt";
+        stateFile = market + "_sim_state.bin";
+    }
+    else {
+        tradeLogFile = logPrefix + "trades.log";
+        profitLogFile = logPrefix + "log.txt";
+        stateFile = market + "_state.bin";
+        orderEntry = make_unique<OrderEntry>(market);
+    }
+    totalProfitLoss = loadTotalProfitLoss();
+    tradeLog = make_unique<TradeLog>(tradeLogFile, profitLogFile,
+        TRADE_LOG_BINARY ? TradeLogFormat::Binary : TradeLogFormat::Text);
+    for (Interval interval : kAllIntervals) {
+        candlesByInterval[intervalIndex(interval)].setCapacity(CANDLE_RETENTION[intervalIndex(interval)]);
+        indicatorsByInterval[intervalIndex(interval)].setCapacity(CANDLE_RETENTION[intervalIndex(interval)]);
+    }
+}
+
+CryptoTradingBot::~CryptoTradingBot() {
+    // The parsers and onDone of the poll in flight write into the bot
+    waitForPoll();
+}
+
+// **Fetch candles for all intervals in one concurrent batch**
+void CryptoTradingBot::fetchAllCandles(int limit) {
+    vector<ApiRequest> batch;
+    vector<ResponseParser> parsers;
+    for (Interval interval : kAllIntervals) {
+        batch.push_back(pollCandlesRequest(interval, limit));
+        parsers.push_back(candlesParser(receivedCandles[intervalIndex(interval)]));
+    }
+    vector<bool> parsed = apiRequestBatchParsed(batch, parsers);
+    for (Interval interval : kAllIntervals) {
+        if (!parsed[intervalIndex(interval)]) receivedCandles[intervalIndex(interval)].clear();
+        storeCandles(interval, receivedCandles[intervalIndex(interval)]);
+        calculateIndicators(interval);
+    }
+}
+
+// **Fetch candles for a specific interval**
+bool CryptoTradingBot::fetchCandles(Interval interval, int limit) {
+    vector<CandleRecord>& received = receivedCandles[intervalIndex(interval)];
+    if (!apiRequestParsed(pollCandlesRequest(interval, limit), candlesParser(received))) received.clear();
+    return storeCandles(interval, received);
+}
+
+// **Load the archived tail of every interval, then fetch only the candles missing since the archive ends**
+// An interval whose archive is missing, or ends too long ago to join up with the candles kept in memory,
+// is fetched from the API as before.
+void CryptoTradingBot::warmStart() {
+    const long long now = nowMs();
+    vector<ApiRequest> batch;
+    vector<Interval> batchIntervals;
+    for (Interval interval : kAllIntervals) {
+        const size_t idx = intervalIndex(interval);
+        const long long millis = intervalMillis(interval);
+        const size_t retention = CANDLE_RETENTION[idx];
+        CandleArchive archive;
+        long long fetchFrom = 0;
+        // Only the candles closed by now, so a replayed session warms up from the archive as it was back then
+        const CandleRecord* archiveEnd = archive.open(candleArchiveName(market, interval))
+            ? archive.lowerBound(now - millis + 1) : nullptr;
+        if (archiveEnd && archiveEnd != archive.begin()) {
+            long long lastArchived = archiveEnd[-1].timestamp;
+            size_t missing = now > lastArchived ? static_cast<size_t>((now - lastArchived) / millis) : 0;
+            if (missing < retention) {
+                size_t tail = min(static_cast<size_t>(archiveEnd - archive.begin()), retention);
+                CandleSeries& candles = candlesByInterval[idx];
+                for (const CandleRecord* record = archiveEnd - tail; record != archiveEnd; record++) {
+                    candles.append(record->timestamp, record->open, record->high, record->low, record->close, record->volume);
+                }
+                lastTimestamps[idx] = lastSavedTimestamps[idx] = lastArchived;
+                fetchFrom = lastArchived + millis;
+                cout << "Loaded " << tail << " archived candles for " << market << " (" << intervalName(interval) << ")" << endl;
+            }
+        }
+        if (fetchFrom == 0) {
+            batch.push_back({ candlesEndpoint(interval, static_cast<int>(min<size_t>(retention, kMaxCandlesPerRequest))) });
+            batchIntervals.push_back(interval);
+            continue;
+        }
+        // Fetch the gap oldest page first, each page holding at most kMaxCandlesPerRequest candles
+        for (long long pageStart = fetchFrom; pageStart <= now; pageStart += kMaxCandlesPerRequest * millis) {
+            long long pageEnd = min(pageStart + (kMaxCandlesPerRequest - 1) * millis, now);
+            batch.push_back({ candlesEndpoint(interval, kMaxCandlesPerRequest, pageStart, pageEnd) });
+            batchIntervals.push_back(interval);
+        }
+    }
+    vector<vector<CandleRecord>> pages(batch.size());
+    vector<ResponseParser> parsers;
+    for (vector<CandleRecord>& page : pages) parsers.push_back(candlesParser(page));
+    vector<bool> parsed = apiRequestBatchParsed(batch, parsers);
+    for (size_t n = 0; n < pages.size(); n++) {
+        if (!parsed[n]) pages[n].clear();
+        storeCandles(batchIntervals[n], pages[n]);
+    }
+    for (Interval interval : kAllIntervals) {
+        calculateIndicators(interval);
+    }
+    cout << "Warm start for " << market << " done with " << batch.size() << " candle requests" << endl;
+}
+
+// **Candles endpoint for an interval, optionally limited to open times from start to end in milliseconds**
+string CryptoTradingBot::candlesEndpoint(Interval interval, int limit, long long start, long long end) const {
+    string endpoint = market + "/candles?interval=" + intervalName(interval) + "&limit=" + to_string(limit);
+    if (start > 0) endpoint += "&start=" + to_string(start);
+    if (end > 0) endpoint += "&end=" + to_string(end);
+    return endpoint;
+}
+
+// **Candles request of a poll, dropped when its retries would take longer than CANDLE_DEADLINE_MS**
+ApiRequest CryptoTradingBot::pollCandlesRequest(Interval interval, int limit) const {
+    ApiRequest request{ candlesEndpoint(interval, limit) };
+    request.deadlineMs = CANDLE_DEADLINE_MS;
+    return request;
+}
+
+// **Ticker price request, sent and retried ahead of the candles and dropped after TICKER_DEADLINE_MS**
+ApiRequest CryptoTradingBot::tickerRequest() const {
+    ApiRequest request{ "ticker/price?market=" + market };
+    request.priority = RequestPriority::Ticker;
+    request.deadlineMs = TICKER_DEADLINE_MS;
+    return request;
+}
+
+// **Append the new candles of a candles response, given in response order**
+bool CryptoTradingBot::storeCandles(Interval interval, const vector<CandleRecord>& response) {
+    if (response.empty()) {
+        cerr << "Failed to fetch candles or invalid response format for interval " << intervalName(interval) << endl;
+        return false;
+    }
+    // Bitvavo returns the newest candle first, store them oldest to newest
+    bool newestFirst = response.front().timestamp > response.back().timestamp;
+    CandleSeries& existingCandles = candlesByInterval[intervalIndex(interval)];
+    for (size_t n = 0; n < response.size(); n++) {
+        const CandleRecord& candle = response[newestFirst ? response.size() - 1 - n : n];
+        if (!existingCandles.append(candle.timestamp, candle.open, candle.high, candle.low, candle.close, candle.volume)) {
+            existingCandles.replaceLast(candle.timestamp, candle.open, candle.high, candle.low, candle.close, candle.volume);
+        }
+    }
+    lastTimestamps[intervalIndex(interval)] = existingCandles.lastTimestamp();
+    cout << "Fetched " << response.size() << " candles for " << market << " (" << intervalName(interval) << "), "
+        << "stored " << existingCandles.size() << " total" << endl;
+    return true;
+}
+
+// **Append the closed candles that are not archived yet to the binary candle archive**
+// The newest candle is still forming until its interval has passed, and it can still be replaced until a newer
+// one is stored, so it is archived on a later save.
+void CryptoTradingBot::saveCandlesToArchive(Interval interval) {
+    const CandleSeries& candles = candlesByInterval[intervalIndex(interval)];
+    if (!candles.empty()) {
+        long long now = chrono::duration_cast<chrono::milliseconds>(
+            chrono::system_clock::now().time_since_epoch()).count();
+        long long lastSaved = lastSavedTimestamps[intervalIndex(interval)];
+        vector<CandleRecord> records;
+        for (size_t i = 0; i < candles.size(); i++) {
+            long long timestamp = candles.timestamp[i];
+            if (timestamp > lastSaved && timestamp + intervalMillis(interval) <= now && i + 1 < candles.size()) {
+                records.push_back({ timestamp, candles.open[i], candles.high[i], candles.low[i],
+                    candles.close[i], candles.volume[i] });
+            }
+        }
+        if (records.empty()) return;
+        string filename = candleArchiveName(market, interval);
+        size_t appended = 0;
+        if (appendToCandleArchive(filename, interval, records, appended)) {
+            lastSavedTimestamps[intervalIndex(interval)] = records.back().timestamp;
+            cout << "Appended " << appended << " new candles for " << intervalName(interval) << " to " << filename << endl;
+        }
+    }
+}
+
+// **Display candle data with indicators**
+void CryptoTradingBot::displayCandleData(Interval interval, int count) {
+    const CandleSeries& candles = candlesByInterval[intervalIndex(interval)];
+    const RingColumn<Strategy::Indicators::Values>& indicators = indicatorsByInterval[intervalIndex(interval)];
+    if (!candles.empty() && indicators.size() == candles.size()) {
+        int numToShow = count;
+        if (numToShow > static_cast<int>(candles.size())) numToShow = candles.size();
+        cout << "\n--- Last " << numToShow << " Candles for " << market << " (" << intervalName(interval) << ") ---" << endl;
+        cout << "Timestamp\t\tClose\t\tRSI\t\tMACD\t\tBB Lower\tBB Upper" << endl;
+        for (int i = candles.size() - numToShow; i < candles.size(); i++) {
+            const auto& ind = indicators[i];
+            time_t timestamp = candles.timestamp[i] / 1000;
+            tm timeInfo;
+            char buffer[25];
+            gmtime_s(&timeInfo, &timestamp); // Fixed typo from previous versions
+            strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeInfo);
+            cout << fixed << setprecision(2);
+            cout << buffer << "\t"
+                << candles.close[i] << "\t\t"
+                << indicator<RsiIndicator>(ind) << "\t\t"
+                << indicator<MacdIndicator>(ind).macd << "\t\t"
+                << indicator<BollingerIndicator>(ind).lower << "\t\t"
+                << indicator<BollingerIndicator>(ind).upper << endl;
+        }
+    }
+    else {
+        cout << "No candle data available for " << intervalName(interval) << "." << endl;
+    }
+
+}
+
+// **Get current ticker price**
+double CryptoTradingBot::getTickerPrice() {
+    double price = 0.0;
+    if (!apiRequestParsed(tickerRequest(), tickerPriceParser(price))) return 0.0;
+    return price;
+}
+
+// **Get fiat balance**
+double CryptoTradingBot::getFiatBalance() {
+    if (isSimulation) {
+        return simFiatBalance;
+    }
+    balances->refreshIfStale();
+    return balances->available(fiatAsset);
+}
+
+// **Get crypto balance**
+double CryptoTradingBot::getCryptoBalance() {
+    if (isSimulation) {
+        return simCryptoBalance;
+    }
+    balances->refreshIfStale();
+    return balances->available(cryptoAsset);
+}
+
+// **Fetch candles, ticker price and balances in one concurrent batch**
+TickData CryptoTradingBot::fetchTickData(int candleLimit) {
+    requestTickData(candleLimit, false);
+    return receiveTickData();
+}
+
+// **Send the candles, ticker price and balance requests of a tick, in the background or before returning**
+// Balances are only requested when the snapshot is stale, a bot sharing them leaves that to the snapshot's owner.
+// In the background the parsers fill the received members on the retry thread, the bot reads them once
+// receiveTickData returns.
+void CryptoTradingBot::requestTickData(int candleLimit, bool background, function<void()> onDone) {
+    vector<ApiRequest> batch;
+    vector<ResponseParser> parsers;
+    for (Interval interval : kAllIntervals) {
+        batch.push_back(pollCandlesRequest(interval, candleLimit));
+        parsers.push_back(candlesParser(receivedCandles[intervalIndex(interval)]));
+    }
+    batch.push_back(tickerRequest());
+    parsers.push_back(tickerPriceParser(receivedTickerPrice));
+    tickFetchesBalances = !isSimulation && balances == &ownBalances && ownBalances.isStale();
+    tickBalanceGeneration = ownBalances.generation();
+    receivedBalanceStatus = ParseStatus::Malformed;
+    if (tickFetchesBalances) {
+        batch.push_back({ "balance" });
+        parsers.push_back([this](const char* data, size_t size) {
+            receivedBalanceStatus = parseBalanceResponse(data, size, receivedBalances);
+            return receivedBalanceStatus != ParseStatus::Malformed;
+        });
+    }
+    if (background) {
+        pendingTick = apiRequestBatchAsync(batch, parsers, move(onDone));
+        return;
+    }
+    promise<vector<bool>> sent;
+    sent.set_value(apiRequestBatchParsed(batch, parsers));
+    pendingTick = sent.get_future();
+}
+
+// **Wait for the requests of requestTickData and apply the candles and balances they returned**
+TickData CryptoTradingBot::receiveTickData() {
+    vector<bool> parsed = pendingTick.get();
+    for (Interval interval : kAllIntervals) {
+        if (!parsed[intervalIndex(interval)]) receivedCandles[intervalIndex(interval)].clear();
+        storeCandles(interval, receivedCandles[intervalIndex(interval)]);
+        calculateIndicators(interval);
+    }
+    TickData result;
+    const size_t tickerIndex = kIntervalCount;
+    const size_t balanceIndex = tickerIndex + 1;
+    result.tickerPrice = parsed[tickerIndex] ? receivedTickerPrice : 0.0;
+    if (isSimulation) {
+        result.fiatBalance = simFiatBalance;
+        result.cryptoBalance = simCryptoBalance;
+    }
+    else {
+        if (tickFetchesBalances && parsed[balanceIndex] && receivedBalanceStatus == ParseStatus::Ok) {
+            ownBalances.update(receivedBalances, tickBalanceGeneration);
+        }
+        result.fiatBalance = balances->available(fiatAsset);
+        result.cryptoBalance = balances->available(cryptoAsset);
+    }
+    return result;
+}
+
+// **Refresh the balances of the current tick after one of our orders filled**
+// Markets sharing the snapshot read the refreshed balances too, so they do not fetch them again.
+void CryptoTradingBot::refreshBalances() {
+    balances->invalidate();
+    balances->refreshIfStale();
+    tick.fiatBalance = balances->available(fiatAsset);
+    tick.cryptoBalance = balances->available(cryptoAsset);
+}
+
+// **Read balances from a snapshot shared with other markets instead of the bot's own**
+void CryptoTradingBot::setSharedBalances(BalanceSnapshot* sharedBalances) {
+    balances = sharedBalances ? sharedBalances : &ownBalances;
+}
+
+// **Market traded by this bot**
+const string& CryptoTradingBot::getMarket() const {
+    return market;
+}
+
+// **Set risk parameters**
+void CryptoTradingBot::setRiskParameters(double maxPos) {
+    maxPositionSize = maxPos;
+    cout << "Risk parameters set, Max Position: " << maxPos * 100 << "%" << endl;
+}
+
+// **Keep the position in a crash-safe state store, restoring the position an earlier run left open**
+// The recovered total profit/loss replaces the one read from the profit/loss file, which is written off the
+// trading thread and can lag behind a crash.
+void CryptoTradingBot::recoverState() {
+    auto startedAt = chrono::steady_clock::now();
+    stateStore = make_unique<StateStore>(stateFile, isSimulation);
+    PositionState state;
+    if (!stateStore->recover(state)) {
+        cout << "No saved state in " << stateFile << ", " << market << " starts without a position." << endl;
+        // Earlier versions kept the state of a single market without its name
+        const string unkeyed = isSimulation ? "sim_state.bin" : "state.bin";
+        error_code ec;
+        if (filesystem::exists(unkeyed, ec)) {
+            cout << unkeyed << " does not say which market it belongs to and is not recovered. Rename it to "
+                << stateFile << " if it holds the position of " << market << "." << endl;
+        }
+        return;
+    }
+    entryPrice = state.entryPrice;
+    boughtCryptoAmount = state.boughtCryptoAmount;
+    totalProfitLoss = state.totalProfitLoss;
+    if (isSimulation) {
+        simFiatBalance = state.simFiatBalance;
+        simCryptoBalance = state.simCryptoBalance;
+    }
+    cout << "Recovered the " << market << " state in "
+        << chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startedAt).count() << " us"
+        << " | Entry Price: " << entryPrice << " | Position: " << boughtCryptoAmount << " " << cryptoAsset
+        << " | Total Profit/Loss: " << totalProfitLoss << " " << fiatAsset << endl;
+    if (!isSimulation) reconcileState();
+}
+
+// **Reconcile a recovered position with the exchange balances of a live bot**
+// The exchange decides: a position whose crypto is gone was sold while the bot was down, and a balance short of
+// the position beyond fees and rounding means part of it was. Crypto held without a recorded entry price is only
+// reported, the sell signal needs an entry price.
+void CryptoTradingBot::reconcileState() {
+    if (!balances->refreshIfStale()) {
+        cerr << "Failed to fetch balances, the recovered " << market << " position is not reconciled." << endl;
+        return;
+    }
+    const double held = balances->available(cryptoAsset);
+    if (entryPrice > 0 && held <= 1e-8) {
+        cout << "The recovered " << market << " position is no longer held on the exchange, closing it." << endl;
+        entryPrice = 0.0;
+        boughtCryptoAmount = 0.0;
+        saveState();
+    }
+    else if (entryPrice > 0 && held < boughtCryptoAmount * 0.99) {
+        cout << "Only " << held << " " << cryptoAsset << " of the recovered " << market
+            << " position is held on the exchange, reducing it." << endl;
+        boughtCryptoAmount = held;
+        saveState();
+    }
+    else if (entryPrice == 0.0 && held > 0.00001) {
+        cout << held << " " << cryptoAsset << " is held without a recorded entry price, the bot does not sell it." << endl;
+    }
+}
+
+// **Record the position in the state store after a fill**
+void CryptoTradingBot::saveState() {
+    if (!stateStore) return;
+    PositionState state;
+    state.entryPrice = entryPrice;
+    state.boughtCryptoAmount = boughtCryptoAmount;
+    state.totalProfitLoss = totalProfitLoss;
+    if (isSimulation) {
+        state.simFiatBalance = simFiatBalance;
+        state.simCryptoBalance = simCryptoBalance;
+    }
+    if (stateStore->record(state, nowMs())) {
+        Metrics::instance().record(LatencyMetric::StateWrite, stateStore->lastRecordNanos());
+    }
+}
+
+// **Use a simulated clock instead of the wall clock**
+// Trades are logged at the simulated time, and simulated orders fill at the last ticker price without network
+// calls unless a replayed book is set or the bot replays an API journal.
+void CryptoTradingBot::setSimulatedClock(long long timeMs) {
+    simulatedTimeMs = timeMs;
+}
+
+// **Send the simulated orders of a backtest through the fill simulator, against a replayed book**
+void CryptoTradingBot::setReplayBook(const OrderBook* book) {
+    replayBook = book;
+}
+
+// **Time the pending simulated order reaches the book in milliseconds, -1 if there is none**
+long long CryptoTradingBot::simulatedOrderDue() const {
+    return simulatedOrderDueMs.load(memory_order_relaxed);
+}
+
+// **Fill the pending simulated order once its latency has passed, against book or at the last price if it is null**
+bool CryptoTradingBot::settleSimulatedOrder(const OrderBook* book) {
+    if (!fillSimulator || !fillSimulator->hasPending() || fillSimulator->dueMs() > nowMs()) return false;
+    applySimulatedFill(fillSimulator->fill(book, tick.tickerPrice));
+    simulatedOrderDueMs.store(-1, memory_order_relaxed);
+    return true;
+}
+
+// **Fill the pending simulated order once its latency has passed, against the book streamed by the feed**
+// Until the feed has the book in sync, the order fills at the last price.
+bool CryptoTradingBot::settleSimulatedOrder(MarketDataFeed& feed) {
+    if (!fillSimulator || !fillSimulator->hasPending() || fillSimulator->dueMs() > nowMs()) return false;
+    bool settled = false;
+    feed.withBook(market, [&](const OrderBook& book) { settled = settleSimulatedOrder(&book); });
+    return settled || settleSimulatedOrder(nullptr);
+}
+
+// **Apply a simulated fill to the simulated balances and log the trade**
+// The entry price includes the fee of the buy, so the profit/loss of the sell is net of both fees.
+void CryptoTradingBot::applySimulatedFill(const SimulatedFill& fill) {
+    const char* side = fill.buy ? "buy" : "sell";
+    if (fill.baseAmount <= 0.0) {
+        cout << "Simulated " << side << " order found no liquidity and was not filled." << endl;
+        return;
+    }
+    if (fill.buy) {
+        simFiatBalance -= fill.quoteAmount;
+        simCryptoBalance += fill.baseAmount;
+        entryPrice = fill.quoteAmount / fill.baseAmount;
+        boughtCryptoAmount = fill.baseAmount;
+        logTrade("BUY", fill.baseAmount, fill.averagePrice);
+    }
+    else {
+        simCryptoBalance -= fill.baseAmount;
+        simFiatBalance += fill.quoteAmount;
+        double profitLoss = fill.quoteAmount - entryPrice * fill.baseAmount;
+        totalProfitLoss += profitLoss;
+        logTrade("SELL", fill.baseAmount, fill.averagePrice, profitLoss);
+        saveTotalProfitLoss(totalProfitLoss);
+        if (simCryptoBalance <= 1e-8) {
+            entryPrice = 0.0;
+            boughtCryptoAmount = 0.0;
+        }
+    }
+    saveState();
+    if (simulatedTimeMs < 0) {
+        double slippage = fill.signalPrice > 0.0 ? (fill.averagePrice / fill.signalPrice - 1.0) * 100 : 0.0;
+        cout << "Simulated " << side << " filled: " << fill.baseAmount << " " << cryptoAsset << " at " << fill.averagePrice
+            << " over " << fill.levels << " level(s) | Fee: " << fill.fee << " " << fiatAsset
+            << " | Slippage: " << slippage << "%" << (fill.complete ? "" : " | Partial fill, the book ran out") << endl;
+    }
+}
+
+// **Total profit/loss of the closed trades**
+double CryptoTradingBot::getTotalProfitLoss() const {
+    return totalProfitLoss;
+}
+
+// **Number of trades logged since the bot was created**
+size_t CryptoTradingBot::getTradeCount() const {
+    return tradeCount;
+}
+
+// **Simulated fiat plus crypto balance valued at a price**
+double CryptoTradingBot::getSimulationValue(double tickerPrice) const {
+    return simFiatBalance + simCryptoBalance * tickerPrice;
+}
+
+// **Set the signal thresholds and indicator periods, recomputing the indicators**
+void CryptoTradingBot::setStrategyParameters(const StrategyParameters& parameters) {
+    strategy = parameters;
+    for (Interval interval : kAllIntervals) {
+        enginesByInterval[intervalIndex(interval)] = Strategy::Indicators(strategy.indicators);
+        indicatorsByInterval[intervalIndex(interval)].clear();
+        processedCandles[intervalIndex(interval)] = 0;
+        calculateIndicators(interval);
+    }
+}
+
+// **Place market order**
+// A simulation queues the order on the fill simulator, which fills it once its latency has passed; a backtest
+// without a replayed book fills it at the candle close right away.
+bool CryptoTradingBot::placeMarketOrder(const string& side, double amount) {
+    if (isSimulation && (simulatedTimeMs < 0 || replayBook || replayingJournal)) {
+        const bool buy = side == "buy";
+        if (buy ? simFiatBalance < amount : simCryptoBalance < amount) {
+            cout << "Insufficient simulated " << (buy ? "fiat" : "crypto") << " balance for " << side << " order." << endl;
+            return false;
+        }
+        if (!fillSimulator->submit(buy, amount, tick.tickerPrice, nowMs())) return false;
+        simulatedOrderDueMs.store(fillSimulator->dueMs(), memory_order_relaxed);
+        return true;
+    }
+    if (isSimulation) {
+        double tickerPrice = tick.tickerPrice;
+        if (tickerPrice == 0.0) {
+            cerr << "Failed to fetch ticker price for simulation." << endl;
+            return false;
+        }
+        if (side == "buy") {
+            if (simFiatBalance >= amount) {
+                double cryptoBought = amount / tickerPrice;
+                simFiatBalance -= amount;
+                simCryptoBalance += cryptoBought;
+                entryPrice = tickerPrice;
+                boughtCryptoAmount = cryptoBought;
+                logTrade("BUY", cryptoBought, tickerPrice);
+                saveState();
+                return true;
+            }
+            else {
+                cout << "Insufficient simulated fiat balance for buy order." << endl;
+                return false;
+            }
+        }
+        else if (side == "sell") {
+            if (simCryptoBalance >= amount) {
+                double fiatReceived = amount * tickerPrice;
+                simCryptoBalance -= amount;
+                simFiatBalance += fiatReceived;
+                double profitLoss = (tickerPrice - entryPrice) * amount;
+                totalProfitLoss += profitLoss;
+                logTrade("SELL", amount, tickerPrice, profitLoss);
+                saveTotalProfitLoss(totalProfitLoss);
+                entryPrice = 0.0;
+                boughtCryptoAmount = 0.0;
+                saveState();
+                return true;
+            }
+            else {
+                cout << "Insufficient simulated crypto balance for sell order." << endl;
+                return false;
+            }
+        }
+        return false;
+    }
+    else {
+        json response = orderEntry->placeMarketOrder(side == "buy", amount);
+        if (!response.empty()) {
+            cout << "Order placed: " << response.dump() << " | Signal to send: "
+                << orderEntry->lastSignalToSendNanos() << " ns" << endl;
+            return true;
+        }
+        return false;
+    }
+}
+
+// **Evaluate the multi-timeframe signals and place orders, returns true if an order was placed**
+bool CryptoTradingBot::evaluateSignals(double tickerPrice, double fiatBalance, double cryptoBalance, bool verbose) {
+    // Latest indicator values of each timeframe the strategy trades on
+    auto ready = [this](Interval interval) { return !indicatorsByInterval[intervalIndex(interval)].empty(); };
+    if (!allTimeframes<Strategy>(ready)) return false;
+    auto latest = [this](Interval interval) -> const Strategy::Indicators::Values& {
+        return indicatorsByInterval[intervalIndex(interval)].back();
+    };
+
+    // Buy and sell signals are true if all timeframes agree
+    bool buySignal = allTimeframes<Strategy>([&](Interval interval) {
+        return Strategy::buy(latest(interval), tickerPrice, strategy);
+    });
+    bool sellSignal = allTimeframes<Strategy>([&](Interval interval) {
+        return Strategy::sell(latest(interval), tickerPrice, strategy);
+    });
+
+    // For debugging, display a snapshot of indicator values from each timeframe
+    if (verbose) {
+        allTimeframes<Strategy>([&](Interval interval) {
+            const Strategy::Indicators::Values& ind = latest(interval);
+            cout << intervalName(interval) << " -> RSI:" << indicator<RsiIndicator>(ind) << " MACD Hist:"
+                << indicator<MacdIndicator>(ind).hist << " BB Lower:" << indicator<BollingerIndicator>(ind).lower
+                << " BB Upper:" << indicator<BollingerIndicator>(ind).upper << endl;
+            return true;
+        });
+    }
+
+    // Execute orders based on the multi-timeframe signals, one simulated order at a time
+    if (fillSimulator && fillSimulator->hasPending()) return false;
+    if (cryptoBalance < 1e-8 && fiatBalance > 50 && buySignal) {
+        double positionSize = maxPositionSize * fiatBalance;
+        cout << "Buy signal detected on all timeframes!" << endl;
+        if (placeMarketOrder("buy", positionSize)) {
+            if (!isSimulation) {
+                entryPrice = tickerPrice;
+                boughtCryptoAmount = positionSize / tickerPrice;
+                logTrade("BUY", boughtCryptoAmount, tickerPrice);
+                saveState();
+            }
+            return true;
+        }
+    }
+    else if (cryptoBalance > 0.00001 && entryPrice > 0 && sellSignal) {
+        cout << "Sell signal detected on all timeframes!" << endl;
+        if (placeMarketOrder("sell", cryptoBalance)) {
+            if (!isSimulation) {
+                double profitLoss = (tickerPrice - entryPrice) * boughtCryptoAmount;
+                totalProfitLoss += profitLoss;
+                logTrade("SELL", cryptoBalance, tickerPrice, profitLoss);
+                saveTotalProfitLoss(totalProfitLoss);
+                entryPrice = 0.0;
+                boughtCryptoAmount = 0.0;
+                saveState();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// **Enhanced trading logic with indicators**
+// Signals are evaluated on every websocket update. A REST poll resyncs candles and balances and prints the
+// status every 60 seconds while the feed is connected, and every 10 seconds while it is not.
+void CryptoTradingBot::enhancedTradeLogic() {
+    MarketDataFeed feed({ market }, isSimulation);
+    warmStart();
+    feed.start();
+    auto lastPoll = chrono::steady_clock::time_point();
+    vector<MarketUpdate> updates;
+    try {
+        while (true) {
+            auto pollInterval = feed.isConnected() ? chrono::seconds(60) : chrono::seconds(10);
+            auto now = chrono::steady_clock::now();
+            if (pollReady()) {
+                if (!finishPoll(feed, pollInterval)) {
+                    cout << "Failed to fetch ticker price. Retrying in 5 seconds..." << endl;
+                    lastPoll = now - pollInterval + chrono::seconds(5);
+                }
+                continue;
+            }
+            if (!pollInFlight() && now - lastPoll >= pollInterval) {
+                lastPoll = now;
+                startPoll([&feed] { feed.wake(); });
+                continue;
+            }
+
+            // Wake up for the poll's responses, or a simulated order whose latency passes before the next poll
+            updates.clear();
+            auto timeout = pollInFlight() ? chrono::milliseconds(pollInterval)
+                : chrono::duration_cast<chrono::milliseconds>(lastPoll + pollInterval - now);
+            if (simulatedOrderDue() >= 0) {
+                timeout = min(timeout, chrono::milliseconds(max(simulatedOrderDue() - nowMs(), 0LL)));
+            }
+            if (feed.waitForUpdates(updates, timeout)) applyUpdates(updates, feed);
+            settleSimulatedOrder(feed);
+        }
+    }
+    catch (...) {
+        // The poll's onDone wakes the feed, which goes out of scope here
+        waitForPoll();
+        throw;
+    }
+}
+
+// **Append a candle, or replace the last one with the same open time, and update the indicators of its interval**
+// Returns false if the candle is older than the last one.
+bool CryptoTradingBot::addCandle(Interval interval, long long timestamp, double open, double high, double low,
+    double close, double volume) {
+    CandleSeries& candles = candlesByInterval[intervalIndex(interval)];
+    if (!candles.append(timestamp, open, high, low, close, volume)
+        && !candles.replaceLast(timestamp, open, high, low, close, volume)) return false;
+    lastTimestamps[intervalIndex(interval)] = timestamp;
+    calculateIndicators(interval);
+    return true;
+}
+
+// **Evaluate the signals at a new ticker price, returns true if an order was placed**
+bool CryptoTradingBot::onTickerPrice(double tickerPrice) {
+    tick.tickerPrice = tickerPrice;
+    if (tickerPrice == 0.0) return false;
+    if (isSimulation) {
+        tick.fiatBalance = simFiatBalance;
+        tick.cryptoBalance = simCryptoBalance;
+    }
+    bool ordered = evaluateSignals(tickerPrice, tick.fiatBalance, tick.cryptoBalance, false);
+    if (ordered && !isSimulation) refreshBalances();
+    return ordered;
+}
+
+// **Apply websocket updates to the candles and ticker price, then evaluate the signals**
+void CryptoTradingBot::applyUpdates(const vector<MarketUpdate>& updates, MarketDataFeed& feed) {
+    if (updates.empty()) return;
+    double tickerPrice = tick.tickerPrice;
+    for (const auto& update : updates) {
+        if (update.type == MarketUpdate::Type::Ticker) {
+            tickerPrice = update.price;
+        }
+        else {
+            addCandle(update.interval, update.timestamp, update.open, update.high, update.low, update.close, update.volume);
+        }
+    }
+    if (tickerPrice == 0.0) return;
+    tick.tickerPrice = tickerPrice;
+    settleSimulatedOrder(feed);
+    onTickerPrice(tickerPrice);
+    settleSimulatedOrder(feed);
+    feed.recordDecision(updates.front().receivedAt);
+}
+
+// **Poll candles, ticker and balances over REST, evaluate the signals and print the status**
+bool CryptoTradingBot::pollTick(MarketDataFeed& feed, chrono::seconds nextPoll) {
+    pollStartedAt = chrono::steady_clock::now();
+    requestTickData(50, false);
+    return finishPoll(feed, nextPoll);
+}
+
+// **Send the requests of a REST poll in the background, onDone is called on the retry thread once they completed**
+void CryptoTradingBot::startPoll(function<void()> onDone) {
+    pollStartedAt = chrono::steady_clock::now();
+    pollResponded = false;
+    requestTickData(50, true, [this, onDone = move(onDone)] {
+        pollResponded = true;
+        if (onDone) onDone();
+    });
+}
+
+// **True from startPoll until finishPoll**
+bool CryptoTradingBot::pollInFlight() const {
+    return pendingTick.valid();
+}
+
+// **True once the requests of the poll in flight completed, so finishPoll does not wait**
+// Set before the poll's onDone is called, so a caller woken by onDone sees it.
+bool CryptoTradingBot::pollReady() const {
+    return pendingTick.valid() && pollResponded;
+}
+
+// **Wait until the poll in flight completed and its onDone returned**
+void CryptoTradingBot::waitForPoll() {
+    if (pendingTick.valid()) pendingTick.wait();
+}
+
+// **Apply the candles and balances of the poll in flight, evaluate the signals and print the status**
+bool CryptoTradingBot::finishPoll(MarketDataFeed& feed, chrono::seconds nextPoll) {
+    cout << "*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#*#" << endl;
+    tick = receiveTickData();
+    double tickerPrice = tick.tickerPrice;
+    if (tickerPrice == 0.0) return false;
+    double fiatBalance = tick.fiatBalance;
+    double cryptoBalance = tick.cryptoBalance;
+    cout << "Current Market: " << market
+        << " | Ticker Price: " << tickerPrice
+        << " | Fiat Balance (" << fiatAsset << "): " << fiatBalance
+        << " | Crypto Balance (" << cryptoAsset << "): " << cryptoBalance << endl;
+    displayCandleData(Interval::H1, 3);
+    displayPotentialProfit(tickerPrice, cryptoBalance);
+
+    if (settleSimulatedOrder(feed)) {
+        fiatBalance = simFiatBalance;
+        cryptoBalance = simCryptoBalance;
+    }
+    evaluateSignals(tickerPrice, fiatBalance, cryptoBalance, true);
+    settleSimulatedOrder(feed);
+    // The order connection is otherwise only used by orders, keep it open so the next order skips the handshake
+    if (orderEntry) orderEntry->keepWarm();
+
+    auto now = chrono::steady_clock::now();
+    if (chrono::duration_cast<chrono::minutes>(now - lastSaveTime).count() >= saveIntervalMinutes) {
+        for (Interval interval : kAllIntervals) {
+            saveCandlesToArchive(interval);
+        }
+        lastSaveTime = now;
+    }
+    if (g_rateLimitRemaining != -1 && g_rateLimitResetAt != -1) {
+        time_t resetAt = static_cast<time_t>(g_rateLimitResetAt / 1000);
+        tm resetTime;
+        char resetAtStr[30] = "Invalid timestamp";
+        if (gmtime_s(&resetTime, &resetAt) == 0) {
+            strftime(resetAtStr, sizeof(resetAtStr), "%Y-%m-%d %H:%M:%S UTC", &resetTime);
+        }
+        cout << "Rate Limit Remaining: " << g_rateLimitRemaining
+            << " | Reset At: " << resetAtStr << endl;
+    }
+    RateLimitStats limits = RateLimiter::instance().stats();
+    cout << "Rate Limiter Budget: " << limits.available << "/" << limits.budget
+        << " | Throttled Requests: " << limits.throttled << " | HTTP 429: " << limits.tooManyRequests << endl;
+    ConnectionStats connStats = getConnectionStats();
+    cout << "API Requests: " << connStats.requests << " | Handshakes: " << connStats.handshakes
+        << " | Latency p50: " << connStats.p50Ms << " ms | p99: " << connStats.p99Ms << " ms"
+        << " | Balance Fetches: " << balances->fetchCount() << endl;
+    double decisionP50 = 0.0, decisionP99 = 0.0;
+    feed.decisionLatency(decisionP50, decisionP99);
+    cout << "Websocket: " << (feed.isConnected() ? "connected" : "disconnected")
+        << " | Update-to-decision p50: " << decisionP50 << " us | p99: " << decisionP99 << " us" << endl;
+    cout << "Total Profit/Loss: " << totalProfitLoss << " " << fiatAsset << endl;
+    if (isSimulation) {
+        double initialBalance = 1000.0;
+        double currentTotal = simFiatBalance + (simCryptoBalance * tickerPrice);
+        double performancePercent = ((currentTotal / initialBalance) - 1.0) * 100;
+        cout << "Simulation Performance: " << performancePercent << "% | "
+            << "Current Total Value: " << currentTotal << " " << fiatAsset << endl;
+    }
+    time_t nowTime = time(nullptr);
+    tm timeInfo;
+    char timeBuffer[80];
+    localtime_s(&timeInfo, &nowTime);
+    strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%d %H:%M:%S", &timeInfo);
+    cout << "Last update: " << timeBuffer << " | Next poll in " << nextPoll.count() << " seconds..." << endl;
+    Metrics::instance().record(LatencyMetric::PollTick,
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - pollStartedAt).count());
+    return true;
+}
+
+// **Display potential profit**
+void CryptoTradingBot::displayPotentialProfit(double tickerPrice, double cryptoBalance) {
+    if (cryptoBalance > 1e-8 && entryPrice > 0) {
+        double potentialProfitEuro = (tickerPrice - entryPrice) * cryptoBalance;
+        double potentialProfitPercent = ((tickerPrice - entryPrice) / entryPrice) * 100;
+        cout << fixed << setprecision(2);
+        cout << "Potential Profit/Loss if sold now: " << potentialProfitEuro << " " << fiatAsset
+            << " (" << potentialProfitPercent << "%)" << endl;
+    }
+    else {
+        cout << "No open position." << endl;
+    }
+}
@@ -0,0 +1,256 @@
+#ifndef TRADINGBOT_H
+#define TRADINGBOT_H
+
+#include "API_Handling.h"
+#include "ApiJournal.h"
+#include "Balances.h"
+#include "CandleArchive.h"
+#include "CandleStore.h"
+#include "FillSimulator.h"
+#include "Indicators.h"
+#include "MarketData.h"
+#include "OrderEntry.h"
+#include "StateStore.h"
+#include "Strategy.h"
+#include "TradeLog.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// **Market data and balances of one tick**
+struct TickData {
+    double tickerPrice = 0.0;
+    double fiatBalance = 0.0;
+    double cryptoBalance = 0.0;
+};
+
+// **CryptoTradingBot class definition**
+class CryptoTradingBot {
+private:
+    std::string market;
+    std::string cryptoAsset;
+    std::string fiatAsset;
+    double entryPrice;
+    double totalProfitLoss = 0.0;
+    double boughtCryptoAmount = 0.0;
+    std::array<CandleSeries, kIntervalCount> candlesByInterval;        // Index: interval, Value: candles
+    std::array<long long, kIntervalCount> lastTimestamps = {};         // Index: interval, Value: last fetched timestamp
+    std::array<long long, kIntervalCount> lastSavedTimestamps = {};    // Index: interval, Value: last saved timestamp
+    double maxPositionSize = 0.25;
+    StrategyParameters strategy;
+    bool isSimulation;
+    bool replayingJournal;                     // Created while an API journal is replayed
+    double simFiatBalance;
+    double simCryptoBalance;
+    std::string tradeLogFile;
+    std::string profitLogFile;
+    std::string stateFile;                     // Named after the market, so no bot recovers another market's position
+    std::chrono::steady_clock::time_point lastSaveTime = std::chrono::steady_clock::now();
+    int saveIntervalMinutes = 10; // Save every 10 minutes
+    TickData tick;                             // Latest ticker price and balances
+    BalanceSnapshot ownBalances;               // Balances of a bot that does not share them
+    BalanceSnapshot* balances = &ownBalances;  // Balances read by the accessors, shared with other markets if set
+    long long simulatedTimeMs = -1;            // Simulated clock of a backtest, -1 for the wall clock
+    size_t tradeCount = 0;                     // Trades logged since the bot was created
+    size_t indicatorUpdates = 0;               // calculateIndicators calls, to sample their timing
+    std::unique_ptr<OrderEntry> orderEntry;    // Low-latency order path of a live bot
+    std::unique_ptr<TradeLog> tradeLog;        // Trade and profit/loss log written off the trading thread
+    std::unique_ptr<FillSimulator> fillSimulator;     // Simulated market orders of a simulation
+    std::unique_ptr<StateStore> stateStore;           // Crash-safe position state of a trading session, null otherwise
+    const OrderBook* replayBook = nullptr;            // Book a backtest replays, null to fill at the candle close
+    std::atomic<long long> simulatedOrderDueMs{ -1 }; // Due time of the pending simulated order, read by the market engine
+
+    // Strategy the bot trades, only the indicators its conditions read are computed and kept
+    using Strategy = MultiTimeframeStrategy;
+    std::array<RingColumn<Strategy::Indicators::Values>, kIntervalCount> indicatorsByInterval; // Index: interval, Value: indicators
+    std::array<Strategy::Indicators, kIntervalCount> enginesByInterval;        // Index: interval, Value: running indicator state
+    std::array<Strategy::Indicators, kIntervalCount> enginesBeforeLast;        // Index: interval, Value: engine state before the last candle
+    std::array<size_t, kIntervalCount> processedCandles = {};                  // Index: interval, Value: candles fed to the engine
+    std::array<size_t, kIntervalCount> processedRevisions = {};                // Index: interval, Value: last candle revisions fed to the engine
+    std::array<std::vector<CandleRecord>, kIntervalCount> receivedCandles;     // Index: interval, Value: candles of the last response
+    std::vector<AssetBalance> receivedBalances;                                // Balances of the last balance response
+    ParseStatus receivedBalanceStatus = ParseStatus::Malformed;                // Status of the last balance response
+    double receivedTickerPrice = 0.0;                                          // Price of the last ticker response
+    bool tickFetchesBalances = false;                                          // The tick in flight requests the balances
+    uint64_t tickBalanceGeneration = 0;                                        // Balance generation the tick was requested at
+    std::future<std::vector<bool>> pendingTick;                                // Requests of the tick in flight, invalid if none
+    std::chrono::steady_clock::time_point pollStartedAt;                       // Time the poll in flight was started
+    std::atomic<bool> pollResponded{ false };                                  // The requests of the poll in flight completed
+
+    // **Load total profit/loss from file**
+    double loadTotalProfitLoss();
+
+    // **Queue the total profit/loss for the profit/loss file**
+    void saveTotalProfitLoss(double profit);
+
+    // **Queue a trade for the trade log**
+    void logTrade(const std::string& tradeType, double amount, double price, double profitLoss = 0.0);
+
+    // **Calculate indicators for a given interval**
+    void calculateIndicators(Interval interval);
+
+    // **Current time in milliseconds: the simulated clock of a backtest, otherwise the wall clock**
+    long long nowMs() const;
+
+    // **Apply a simulated fill to the simulated balances and log the trade**
+    void applySimulatedFill(const SimulatedFill& fill);
+
+    // **Record the position in the state store after a fill**
+    void saveState();
+
+    // **Reconcile a recovered position with the exchange balances of a live bot**
+    void reconcileState();
+
+    // **Send the candles, ticker price and balance requests of a tick, in the background or before returning**
+    void requestTickData(int candleLimit, bool background, std::function<void()> onDone = nullptr);
+
+    // **Wait for the requests of requestTickData and apply the candles and balances they returned**
+    TickData receiveTickData();
+
+public:
+    // **Constructor**
+    // logPrefix is prepended to the trade and profit log file names, so markets sharing a process keep separate logs.
+    CryptoTradingBot(const std::string& selectedMarket, bool simulationMode, const std::string& logPrefix = "");
+
+    // **Destructor, waits for the requests of a poll in flight since their parsers write into the bot**
+    ~CryptoTradingBot();
+
+    // **Fetch candles for all intervals in one concurrent batch**
+    void fetchAllCandles(int limit = 100);
+
+    // **Fetch candles for a specific interval**
+    bool fetchCandles(Interval interval, int limit = 100);
+
+    // **Load the archived tail of every interval, then fetch only the candles missing since the archive ends**
+    void warmStart();
+
+    // **Candles endpoint for an interval, optionally limited to open times from start to end in milliseconds**
+    std::string candlesEndpoint(Interval interval, int limit, long long start = 0, long long end = 0) const;
+
+    // **Candles request of a poll, dropped when its retries would take longer than CANDLE_DEADLINE_MS**
+    ApiRequest pollCandlesRequest(Interval interval, int limit) const;
+
+    // **Ticker price request, sent and retried ahead of the candles and dropped after TICKER_DEADLINE_MS**
+    ApiRequest tickerRequest() const;
+
+    // **Append the new candles of a candles response, given in response order**
+    bool storeCandles(Interval interval, const std::vector<CandleRecord>& response);
+
+    // **Append the closed candles that are not archived yet to the binary candle archive**
+    void saveCandlesToArchive(Interval interval);
+
+    // **Display candle data with indicators**
+    void displayCandleData(Interval interval, int count = 5);
+
+    // **Get current ticker price**
+    double getTickerPrice();
+
+    // **Get fiat balance**
+    double getFiatBalance();
+
+    // **Get crypto balance**
+    double getCryptoBalance();
+
+    // **Fetch candles, ticker price and balances in one concurrent batch**
+    TickData fetchTickData(int candleLimit);
+
+    // **Refresh the balances of the current tick after one of our orders filled**
+    void refreshBalances();
+
+    // **Read balances from a snapshot shared with other markets instead of the bot's own**
+    void setSharedBalances(BalanceSnapshot* sharedBalances);
+
+    // **Market traded by this bot**
+    const std::string& getMarket() const;
+
+    // **Set risk parameters**
+    void setRiskParameters(double maxPos);
+
+    // **Keep the position in a crash-safe state store, restoring the position an earlier run left open**
+    // Backtests and replays do not call this, so they always start without a position. The state file is named after
+    // the market.
+    void recoverState();
+
+    // **Use a simulated clock instead of the wall clock**
+    // Trades are logged at the simulated time, and simulated orders fill at the last ticker price without network
+    // calls unless a replayed book is set or the bot replays an API journal.
+    void setSimulatedClock(long long timeMs);
+
+    // **Send the simulated orders of a backtest through the fill simulator, against a replayed book**
+    // The backtest keeps the book up to date and settles each order once its latency has passed.
+    void setReplayBook(const OrderBook* book);
+
+    // **Time the pending simulated order reaches the book in milliseconds, -1 if there is none**
+    long long simulatedOrderDue() const;
+
+    // **Fill the pending simulated order once its latency has passed, against book or at the last price if it is null**
+    bool settleSimulatedOrder(const OrderBook* book);
+
+    // **Fill the pending simulated order once its latency has passed, against the book streamed by the feed**
+    bool settleSimulatedOrder(MarketDataFeed& feed);
+
+    // **Total profit/loss of the closed trades**
+    double getTotalProfitLoss() const;
+
+    // **Number of trades logged since the bot was created**
+    size_t getTradeCount() const;
+
+    // **Simulated fiat plus crypto balance valued at a price**
+    double getSimulationValue(double tickerPrice) const;
+
+    // **Set the signal thresholds and indicator periods, recomputing the indicators**
+    void setStrategyParameters(const StrategyParameters& parameters);
+
+    // **Place market order**
+    bool placeMarketOrder(const std::string& side, double amount);
+
+    // **Evaluate the multi-timeframe signals and place orders, returns true if an order was placed**
+    bool evaluateSignals(double tickerPrice, double fiatBalance, double cryptoBalance, bool verbose);
+
+    // **Enhanced trading logic with indicators**
+    // Signals are evaluated on every websocket update. A REST poll resyncs candles and balances and prints the
+    // status every 60 seconds while the feed is connected, and every 10 seconds while it is not. The poll's
+    // requests and their retries run in the background, websocket updates are traded on until they completed.
+    void enhancedTradeLogic();
+
+    // **Append a candle, or replace the last one with the same open time, and update the indicators of its interval**
+    // Returns false if the candle is older than the last one.
+    bool addCandle(Interval interval, long long timestamp, double open, double high, double low, double close, double volume);
+
+    // **Evaluate the signals at a new ticker price, returns true if an order was placed**
+    bool onTickerPrice(double tickerPrice);
+
+    // **Apply websocket updates to the candles and ticker price, then evaluate the signals**
+    void applyUpdates(const std::vector<MarketUpdate>& updates, MarketDataFeed& feed);
+
+    // **Poll candles, ticker and balances over REST, evaluate the signals and print the status**
+    // Sends the requests on the calling thread, startPoll and finishPoll split it for callers that trade on meanwhile.
+    bool pollTick(MarketDataFeed& feed, std::chrono::seconds nextPoll);
+
+    // **Send the requests of a REST poll in the background, onDone is called on the retry thread once they completed**
+    void startPoll(std::function<void()> onDone = nullptr);
+
+    // **True from startPoll until finishPoll**
+    bool pollInFlight() const;
+
+    // **True once the requests of the poll in flight completed, so finishPoll does not wait**
+    // Set before the poll's onDone is called, so a caller woken by onDone sees it.
+    bool pollReady() const;
+
+    // **Wait until the poll in flight completed and its onDone returned**
+    void waitForPoll();
+
+    // **Apply the candles and balances of the poll in flight, evaluate the signals and print the status**
+    // Returns false if the poll got no ticker price.
+    bool finishPoll(MarketDataFeed& feed, std::chrono::seconds nextPoll);
+
+    // **Display potential profit**
+    void displayPotentialProfit(double tickerPrice, double cryptoBalance);
+};
+
+#endif // !TRADINGBOT_H
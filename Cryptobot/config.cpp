@@ -5,8 +5,132 @@
 
 const std::string API_KEY = get_env("API_KEY");
 const std::string API_SECRET = get_env("API_SECRET");
-const std::string BASE_URL = "https://api.bitvavo.com/v2/";
+// Overridable in .env to point the bot at a local stand-in server
+const std::string BASE_URL = get_env("BASE_URL").empty() ? "https://api.bitvavo.com/v2/" : get_env("BASE_URL");
+const std::string WS_URL = get_env("WS_URL").empty() ? "wss://ws.bitvavo.com/v2/" : get_env("WS_URL");
+
+// Enough for the longest indicator warmup (MACD 26 + 9) and a full 100 candle fetch,
+// and more than the 10 minutes of 1m candles between two archive saves
+const size_t MIN_CANDLE_RETENTION = 100;
+
+// **Read a retention from the .env file, falling back to the default**
+static size_t retentionFromEnv(const std::string& key, size_t fallback) {
+    std::string value = get_env(key);
+    size_t retention = fallback;
+    if (!value.empty()) {
+        try {
+            retention = std::stoul(value);
+        }
+        catch (const std::exception&) {
+        }
+    }
+    return retention < MIN_CANDLE_RETENTION ? MIN_CANDLE_RETENTION : retention;
+}
+
+const size_t CANDLE_RETENTION[4] = {
+    retentionFromEnv("CANDLE_RETENTION_1M", 2000),
+    retentionFromEnv("CANDLE_RETENTION_5M", 1000),
+    retentionFromEnv("CANDLE_RETENTION_15M", 1000),
+    retentionFromEnv("CANDLE_RETENTION_1H", 500),
+};
+
+// **Read the rate limit budget from the .env file, falling back to Bitvavo's default of 1000 per minute**
+static long long rateLimitBudgetFromEnv() {
+    std::string value = get_env("RATE_LIMIT_BUDGET");
+    long long budget = 1000;
+    if (!value.empty()) {
+        try {
+            budget = std::stoll(value);
+        }
+        catch (const std::exception&) {
+        }
+    }
+    return budget > 0 ? budget : 1000;
+}
+
+const long long RATE_LIMIT_BUDGET = rateLimitBudgetFromEnv();
+
+const bool TRADE_LOG_BINARY = get_env("TRADE_LOG_FORMAT") == "binary";
+
+// **Read a positive number from the .env file, falling back to the default**
+static int positiveFromEnv(const std::string& key, int fallback) {
+    std::string value = get_env(key);
+    int number = fallback;
+    if (!value.empty()) {
+        try {
+            number = std::stoi(value);
+        }
+        catch (const std::exception&) {
+        }
+    }
+    return number > 0 ? number : fallback;
+}
+
+const int METRICS_PORT = positiveFromEnv("METRICS_PORT", 0);
+const std::string METRICS_ADDRESS = get_env("METRICS_ADDRESS").empty() ? "127.0.0.1" : get_env("METRICS_ADDRESS");
+const std::string METRICS_DUMP_FILE = get_env("METRICS_DUMP_FILE");
+const int METRICS_DUMP_SECONDS = positiveFromEnv("METRICS_DUMP_SECONDS", 60);
+
+// **Read a rate from 0 up to 1, such as a fee of 0.0025, from the .env file, falling back to the default**
+static double rateFromEnv(const std::string& key, double fallback) {
+    std::string value = get_env(key);
+    double fee = fallback;
+    if (!value.empty()) {
+        try {
+            fee = std::stod(value);
+        }
+        catch (const std::exception&) {
+        }
+    }
+    return fee >= 0.0 && fee < 1.0 ? fee : fallback;
+}
+
+// **Read a number of milliseconds from the .env file, 0 allowed, falling back to the default**
+static int millisFromEnv(const std::string& key, int fallback) {
+    std::string value = get_env(key);
+    int millis = fallback;
+    if (!value.empty()) {
+        try {
+            millis = std::stoi(value);
+        }
+        catch (const std::exception&) {
+        }
+    }
+    return millis >= 0 ? millis : fallback;
+}
+
+const double SIM_TAKER_FEE = rateFromEnv("SIM_TAKER_FEE", 0.0025);
+const int SIM_LATENCY_MS = millisFromEnv("SIM_LATENCY_MS", 50);
+const bool BOOK_RECORDING = get_env("BOOK_RECORDING") == "1";
+
+const std::string API_JOURNAL = get_env("API_JOURNAL");
+
+const int CANDLE_DEADLINE_MS = millisFromEnv("CANDLE_DEADLINE_MS", 5000);
+const int TICKER_DEADLINE_MS = millisFromEnv("TICKER_DEADLINE_MS", 3000);
+
+// **Read a positive amount from the .env file, falling back to the default**
+static double amountFromEnv(const std::string& key, double fallback) {
+    std::string value = get_env(key);
+    double amount = fallback;
+    if (!value.empty()) {
+        try {
+            amount = std::stod(value);
+        }
+        catch (const std::exception&) {
+        }
+    }
+    return amount > 0.0 ? amount : fallback;
+}
+
+const std::string API_TRANSPORT = get_env("API_TRANSPORT");
+const int MOCK_LATENCY_MS = millisFromEnv("MOCK_LATENCY_MS", 20);
+const int MOCK_JITTER_MS = millisFromEnv("MOCK_JITTER_MS", 10);
+const double MOCK_429_RATE = rateFromEnv("MOCK_429_RATE", 0.0);
+const long long MOCK_RATE_LIMIT = static_cast<long long>(
+    amountFromEnv("MOCK_RATE_LIMIT", static_cast<double>(RATE_LIMIT_BUDGET)));
+const int MOCK_WINDOW_MS = positiveFromEnv("MOCK_WINDOW_MS", 60000);
+const double MOCK_FIAT_BALANCE = amountFromEnv("MOCK_FIAT_BALANCE", 1000.0);
 
 // Rate limit globals, if they are meant to be accessed only within this file
-long long g_rateLimitRemaining = -1;
-long long g_rateLimitResetAt = -1;
\ No newline at end of file
+std::atomic<long long> g_rateLimitRemaining{ -1 };
+std::atomic<long long> g_rateLimitResetAt{ -1 };
\ No newline at end of file
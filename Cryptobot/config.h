@@ -1,13 +1,64 @@
 #ifndef config_h
 #define config_h
 
+#include <atomic>
 #include <string>
 
 extern const std::string API_KEY;
 extern const std::string API_SECRET;
 extern const std::string BASE_URL;
+extern const std::string WS_URL;
 
-extern long long g_rateLimitRemaining;
-extern long long g_rateLimitResetAt;
+// Candles kept in memory per interval (1m, 5m, 15m, 1h), older candles only live in the candle archive.
+// Overridable in .env with CANDLE_RETENTION_1M, CANDLE_RETENTION_5M, CANDLE_RETENTION_15M and CANDLE_RETENTION_1H.
+extern const size_t MIN_CANDLE_RETENTION;
+extern const size_t CANDLE_RETENTION[4];
+
+// Request weight the exchange allows per rate limit window, overridable in .env with RATE_LIMIT_BUDGET.
+extern const long long RATE_LIMIT_BUDGET;
+
+// Time a poll's candle request may take including its retries before it is dropped, so a failing candles endpoint
+// does not hold up the ticker price and the orders. Overridable in .env with CANDLE_DEADLINE_MS, 0 for no deadline.
+extern const int CANDLE_DEADLINE_MS;
+
+// Time a ticker price request may take including its retries before it is dropped and the poll is retried 5 seconds
+// later with a fresh price. Overridable in .env with TICKER_DEADLINE_MS, 0 for no deadline.
+extern const int TICKER_DEADLINE_MS;
+
+// Write trades as binary records to <trade log>.bin instead of text lines, set TRADE_LOG_FORMAT=binary in .env.
+extern const bool TRADE_LOG_BINARY;
+
+// Prometheus metrics endpoint: METRICS_PORT in .env enables GET /metrics on METRICS_ADDRESS (default 127.0.0.1).
+// METRICS_DUMP_FILE appends a binary snapshot every METRICS_DUMP_SECONDS (default 60) seconds.
+extern const int METRICS_PORT;
+extern const std::string METRICS_ADDRESS;
+extern const std::string METRICS_DUMP_FILE;
+extern const int METRICS_DUMP_SECONDS;
+
+// Simulated fills: SIM_TAKER_FEE is the fee rate of a market order (default 0.0025, Bitvavo's lowest volume tier)
+// and SIM_LATENCY_MS the time an order takes to reach the book (default 50). BOOK_RECORDING=1 in .env appends the
+// order books streamed in simulation mode to <market>_book.bin for backtests.
+extern const double SIM_TAKER_FEE;
+extern const int SIM_LATENCY_MS;
+extern const bool BOOK_RECORDING;
+
+// API_JOURNAL=<file> in .env appends every REST transfer and websocket message to a compressed journal, which
+// Cryptobot --replay re-runs offline.
+extern const std::string API_JOURNAL;
+
+// API_TRANSPORT=mock in .env sends the REST API to an in-process mock exchange instead of BASE_URL. Its responses
+// take MOCK_LATENCY_MS (default 20) plus up to MOCK_JITTER_MS (default 10), MOCK_429_RATE is the share of requests
+// it answers with HTTP 429 (default 0), and it allows MOCK_RATE_LIMIT weight (default RATE_LIMIT_BUDGET) per
+// MOCK_WINDOW_MS (default 60000). Its accounts start with MOCK_FIAT_BALANCE EUR (default 1000).
+extern const std::string API_TRANSPORT;
+extern const int MOCK_LATENCY_MS;
+extern const int MOCK_JITTER_MS;
+extern const double MOCK_429_RATE;
+extern const long long MOCK_RATE_LIMIT;
+extern const int MOCK_WINDOW_MS;
+extern const double MOCK_FIAT_BALANCE;
+
+extern std::atomic<long long> g_rateLimitRemaining;
+extern std::atomic<long long> g_rateLimitResetAt;
 
 #endif // !config_h